@@ -0,0 +1,97 @@
+/**
+ * @file BatchEvaluator.c
+ * @author: Zhang Hai
+ */
+
+/*
+ * Copyright (C) 2014 Zhang Hai
+ *
+ * This file is part of calc.
+ *
+ * calc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * calc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with calc.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "Evaluator.h"
+
+#include <pthread.h>
+
+#include "zhclib/ThreadPool.h"
+
+
+/*
+ * Expressions are cheap to evaluate, so hand them out in chunks large
+ * enough to make stealing rare but small enough to balance the load.
+ */
+static const size_t BATCH_GRAIN_SIZE = 256;
+
+
+static ThreadPool *batchPool = null;
+
+/* Guards batchPool, which is shared by all the callers. */
+static pthread_mutex_t batchMutex = PTHREAD_MUTEX_INITIALIZER;
+
+
+typedef struct {
+    const string *expressions;
+    Operand *values;
+    EvaluationResult *results;
+} Batch;
+
+
+static void evaluateBatchRange(void *data, size_t start, size_t end) {
+
+    Batch *batch = data;
+    size_t i;
+
+    for (i = start; i < end; ++i) {
+        batch->results[i] = evaluateExpression(batch->expressions[i],
+                &batch->values[i]);
+    }
+}
+
+/**
+ * Evaluate many independent expressions in parallel.
+ * @note The value and result of each expression are stored at its own
+ *       index, so the output does not depend on the number of threads.
+ *       Like {@link evaluateExpression}, a value is left untouched
+ *       when its evaluation fails.
+ * @param values The values of the expressions, with count elements.
+ * @param results The results of the expressions, with count elements.
+ * @param threads The number of threads to use, or 0 or less for the
+ *        number of processors.
+ */
+void evaluateBatch(const string *expressions, size_t count,
+        Operand *values, EvaluationResult *results, int threads) {
+
+    Batch batch = {expressions, values, results};
+    size_t threadCount = threads > 0 ? (size_t)threads
+            : ThreadPool_getProcessorCount();
+
+    if (threadCount == 1 || count <= BATCH_GRAIN_SIZE) {
+        evaluateBatchRange(&batch, 0, count);
+        return;
+    }
+
+    pthread_mutex_lock(&batchMutex);
+    if (batchPool == null || batchPool->threadCount < threadCount) {
+        if (batchPool != null) {
+            ThreadPool_delete(batchPool);
+        }
+        batchPool = ThreadPool_new(threadCount);
+    }
+    ThreadPool_run(batchPool, threadCount, count, BATCH_GRAIN_SIZE,
+            evaluateBatchRange, &batch);
+    pthread_mutex_unlock(&batchMutex);
+}
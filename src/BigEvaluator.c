@@ -0,0 +1,362 @@
+/**
+ * @file BigEvaluator.c
+ * @author: Zhang Hai
+ */
+
+/*
+ * Copyright (C) 2014 Zhang Hai
+ *
+ * This file is part of calc.
+ *
+ * calc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * calc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with calc.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Evaluator.h"
+
+#include "CompiledExpression.h"
+#include "Operator.h"
+#include "Statistics.h"
+
+
+/**
+ * Load a constant of a program at a precision.
+ * @note The constant is parsed again from its text when the program
+ *       kept it, so that a literal like 0.1 is exact instead of the
+ *       nearest double.
+ */
+static EvaluationResult loadConstant(CompiledExpression *program,
+        size_t index, Operand constant, size_t precision,
+        BigFloat *value) {
+
+    string literal = index < program->literalCount
+            ? program->literals[index] : null;
+
+    if (literal != null) {
+        if (string_isEqualIgnoreCase(literal, "e")) {
+            BigFloat_getE(value, precision);
+            return EVALUATION_SUCCESS;
+        } else if (string_isEqualIgnoreCase(literal, "pi")) {
+            BigFloat_getPi(value, precision);
+            return EVALUATION_SUCCESS;
+        } else if (BigFloat_parse(value, literal, string_length(literal),
+                precision)) {
+            return EVALUATION_SUCCESS;
+        }
+    }
+
+    /* Other forms of numbers, like hexadecimal, are exact as doubles. */
+    return BigFloat_setDouble(value, constant, precision)
+            ? EVALUATION_SUCCESS : EVALUATION_ERROR_INVALID_OPERATION;
+}
+
+/**
+ * Get sqrt(1 - x^2) of an operand, as sqrt((1 - x) (1 + x)) so that it
+ * keeps its precision near 1.
+ * @return Whether the operand is in [-1, 1].
+ */
+static bool getCosineOfArcsine(BigFloat *result, BigFloat *operand,
+        size_t precision) {
+
+    bool success;
+    BigFloat one, difference, sum;
+
+    BigFloat_initialize(&one);
+    BigFloat_initialize(&difference);
+    BigFloat_initialize(&sum);
+    BigFloat_setInteger(&one, 1);
+    BigFloat_subtract(&difference, &one, operand, BIG_FLOAT_EXACT);
+    BigFloat_add(&sum, &one, operand, BIG_FLOAT_EXACT);
+    BigFloat_multiply(&difference, &difference, &sum, precision + 1);
+    success = BigFloat_sqrt(result, &difference, precision);
+    BigFloat_finalize(&sum);
+    BigFloat_finalize(&difference);
+    BigFloat_finalize(&one);
+    return success;
+}
+
+/**
+ * Apply a hyperbolic function to an operand in place, from e^x and
+ * e^-x.
+ * @note Small operands get extra precision for the cancellation in
+ *       e^x - e^-x.
+ * @return Whether e^x is in range.
+ */
+static bool evaluateHyperbolic(Operator operator, BigFloat *operand,
+        size_t precision) {
+
+    long top = operand->exponent + (long)operand->length;
+    size_t workingPrecision = precision + 2 + (top < 0 ? -top : 0);
+    BigFloat power, inverse, one;
+
+    BigFloat_initialize(&power);
+    BigFloat_initialize(&inverse);
+    BigFloat_initialize(&one);
+    if (!BigFloat_exp(&power, operand, workingPrecision)) {
+        BigFloat_finalize(&one);
+        BigFloat_finalize(&inverse);
+        BigFloat_finalize(&power);
+        return false;
+    }
+    BigFloat_setInteger(&one, 1);
+    BigFloat_divide(&inverse, &one, &power, workingPrecision);
+
+    switch (operator) {
+    case OPERATOR_SINH:
+        BigFloat_subtract(operand, &power, &inverse, workingPrecision);
+        BigFloat_divideSmall(operand, operand, 2, precision);
+        break;
+    case OPERATOR_COSH:
+        BigFloat_add(operand, &power, &inverse, workingPrecision);
+        BigFloat_divideSmall(operand, operand, 2, precision);
+        break;
+    default:
+        BigFloat_subtract(operand, &power, &inverse, workingPrecision);
+        BigFloat_add(&power, &power, &inverse, workingPrecision);
+        BigFloat_divide(operand, operand, &power, precision);
+        break;
+    }
+
+    BigFloat_finalize(&one);
+    BigFloat_finalize(&inverse);
+    BigFloat_finalize(&power);
+    return true;
+}
+
+/**
+ * Apply an operator to the operands on top of the stack, leaving the
+ * result in the first of them.
+ * @note Operations that give an infinity or NaN as doubles, like
+ *       division by zero, fail instead.
+ * @note A registered function only has a double form, so it fails
+ *       rather than silently losing the requested digits.
+ */
+static EvaluationResult evaluateOperator(Operator operator,
+        BigFloat *operands, size_t precision) {
+
+    bool success = true;
+    BigFloat one, cosine;
+
+    switch (operator) {
+    case OPERATOR_ADDITION:
+        BigFloat_add(&operands[0], &operands[0], &operands[1], precision);
+        break;
+    case OPERATOR_SUBTRACTION:
+        BigFloat_subtract(&operands[0], &operands[0], &operands[1],
+                precision);
+        break;
+    case OPERATOR_MULPLICATION:
+        BigFloat_multiply(&operands[0], &operands[0], &operands[1],
+                precision);
+        break;
+    case OPERATOR_DIVISION:
+        success = BigFloat_divide(&operands[0], &operands[0],
+                &operands[1], precision);
+        break;
+    case OPERATOR_NEGATIVE:
+        BigFloat_negate(&operands[0], &operands[0]);
+        break;
+    case OPERATOR_POWER:
+    case OPERATOR_POW:
+        success = BigFloat_pow(&operands[0], &operands[0], &operands[1],
+                precision);
+        break;
+    case OPERATOR_FACTORIAL:
+        success = BigFloat_factorial(&operands[0], &operands[0],
+                precision);
+        break;
+    case OPERATOR_SIN:
+        BigFloat_sin(&operands[0], &operands[0], precision);
+        break;
+    case OPERATOR_COS:
+        BigFloat_cos(&operands[0], &operands[0], precision);
+        break;
+    case OPERATOR_TAN:
+        success = BigFloat_tan(&operands[0], &operands[0], precision);
+        break;
+    case OPERATOR_LOG:
+        if (operands[0].sign <= 0 || operands[1].sign <= 0) {
+            return EVALUATION_ERROR_INVALID_OPERATION;
+        }
+        BigFloat_log(&operands[0], &operands[0], precision + 1);
+        BigFloat_log(&operands[1], &operands[1], precision + 1);
+        /* The logarithm of a base of 1 is exactly zero. */
+        success = BigFloat_divide(&operands[0], &operands[1],
+                &operands[0], precision);
+        break;
+    case OPERATOR_EXP:
+        success = BigFloat_exp(&operands[0], &operands[0], precision);
+        break;
+    case OPERATOR_LN:
+        success = BigFloat_log(&operands[0], &operands[0], precision);
+        break;
+    case OPERATOR_SQRT:
+        success = BigFloat_sqrt(&operands[0], &operands[0], precision);
+        break;
+    case OPERATOR_ABS:
+        if (operands[0].sign < 0) {
+            BigFloat_negate(&operands[0], &operands[0]);
+        }
+        break;
+    case OPERATOR_ASIN:
+    case OPERATOR_ACOS:
+        BigFloat_initialize(&cosine);
+        success = getCosineOfArcsine(&cosine, &operands[0],
+                precision + 1);
+        if (success && operator == OPERATOR_ASIN) {
+            BigFloat_atan2(&operands[0], &operands[0], &cosine,
+                    precision);
+        } else if (success) {
+            BigFloat_atan2(&operands[0], &cosine, &operands[0],
+                    precision);
+        }
+        BigFloat_finalize(&cosine);
+        break;
+    case OPERATOR_ATAN:
+        BigFloat_initialize(&one);
+        BigFloat_setInteger(&one, 1);
+        BigFloat_atan2(&operands[0], &operands[0], &one, precision);
+        BigFloat_finalize(&one);
+        break;
+    case OPERATOR_ATAN2:
+        BigFloat_atan2(&operands[0], &operands[0], &operands[1],
+                precision);
+        break;
+    case OPERATOR_SINH:
+    case OPERATOR_COSH:
+    case OPERATOR_TANH:
+        success = evaluateHyperbolic(operator, &operands[0], precision);
+        break;
+    case OPERATOR_FLOOR:
+        BigFloat_floor(&operands[0], &operands[0]);
+        break;
+    case OPERATOR_CEIL:
+        BigFloat_ceil(&operands[0], &operands[0]);
+        break;
+    case OPERATOR_MIN:
+        if (BigFloat_compare(&operands[1], &operands[0]) < 0) {
+            BigFloat_set(&operands[0], &operands[1]);
+        }
+        break;
+    case OPERATOR_MAX:
+        if (BigFloat_compare(&operands[1], &operands[0]) > 0) {
+            BigFloat_set(&operands[0], &operands[1]);
+        }
+        break;
+    default:
+        if (operator >= OPERATOR_FIRST_USER_FUNCTION) {
+            return EVALUATION_ERROR_INVALID_OPERATION;
+        }
+        return EVALUATION_ERROR_INTERNAL_FAILURE;
+    }
+
+    return success ? EVALUATION_SUCCESS
+            : EVALUATION_ERROR_INVALID_OPERATION;
+}
+
+/**
+ * Evaluate a compiled program with arbitrary precision.
+ * @note Intermediate results carry a guard limb beyond the requested
+ *       digits.
+ * @param program The program returned by {@link compileExpression}.
+ * @param variableValues The values of the variables, indexed by their
+ *        slots.
+ * @param digits The number of significant decimal digits.
+ * @param value The value of the expression, with at least the digits
+ *        correct.
+ */
+EvaluationResult evaluateCompiledBig(CompiledExpression *program,
+        BigFloat *variableValues, size_t digits, BigFloat *value) {
+
+    size_t precision = BigFloat_getPrecisionForDigits(digits),
+            frameSize = program->stackDepth + program->temporaryCount,
+            constantIndex = 0, i;
+    BigFloat *stack = Memory_allocate(MAX(frameSize, 1) * sizeof(BigFloat)),
+            *top = stack, *temporaries = stack + program->stackDepth;
+    Instruction *instruction = program->instructions,
+            *end = instruction + program->instructionCount;
+    EvaluationResult result = EVALUATION_SUCCESS;
+    STATISTICS_DECLARE_TIME(start);
+    STATISTICS_DECLARE_TIME(operatorStart);
+
+    STATISTICS_START(start);
+    for (; instruction != end; ++instruction) {
+        switch (instruction->type) {
+        case INSTRUCTION_CONSTANT:
+            result = loadConstant(program, constantIndex++,
+                    instruction->argument.constant, precision, top++);
+            break;
+        case INSTRUCTION_VARIABLE:
+            BigFloat_round(top++,
+                    &variableValues[instruction->argument.variable],
+                    precision);
+            break;
+        case INSTRUCTION_OPERATOR:
+            top -= Operator_getOperandCount(instruction->operator);
+            STATISTICS_START(operatorStart);
+            result = evaluateOperator(instruction->operator, top,
+                    precision);
+            STATISTICS_ADD_OPERATOR(instruction->operator, 1,
+                    operatorStart);
+            ++top;
+            break;
+        case INSTRUCTION_STORE:
+            BigFloat_set(&temporaries[instruction->argument.temporary],
+                    top - 1);
+            break;
+        case INSTRUCTION_LOAD:
+            BigFloat_set(top++,
+                    &temporaries[instruction->argument.temporary]);
+            break;
+        }
+        if (result != EVALUATION_SUCCESS) {
+            break;
+        }
+    }
+
+    if (result == EVALUATION_SUCCESS) {
+        BigFloat_round(value, stack, precision);
+    }
+
+    for (i = 0; i < frameSize; ++i) {
+        BigFloat_finalize(&stack[i]);
+    }
+    Memory_free(stack);
+    STATISTICS_ADD_PHASE(STATISTICS_PHASE_EVALUATE, start);
+    return result;
+}
+
+/**
+ * Evaluate an expression with arbitrary precision.
+ * @see evaluateCompiledBig
+ */
+EvaluationResult evaluateExpressionBig(string expression, size_t digits,
+        BigFloat *value) {
+
+    CompiledExpression *program;
+    EvaluationResult result = compileExpression(expression, &program);
+
+    if (result != EVALUATION_SUCCESS) {
+        return result;
+    }
+
+    /* A standalone expression has no variables to bind. */
+    if (program->variableCount != 0) {
+        result = EVALUATION_ERROR_PARSING_FAILED;
+    } else {
+        result = evaluateCompiledBig(program, null, digits, value);
+    }
+
+    CompiledExpression_delete(program);
+    return result;
+}
@@ -24,8 +24,13 @@
 
 #include "zhclib/Common.h"
 #include "zhclib/Console.h"
+#include "zhclib/OutputBuffer.h"
+
+#include <unistd.h>
 
 #include "Evaluator.h"
+#include "ExpressionCache.h"
+#include "Statistics.h"
 
 
 string EVALUATION_RESULTS[] = {
@@ -36,9 +41,19 @@ string EVALUATION_RESULTS[] = {
     "EVALUATION_ERROR_PARSING_FAILED",
     "EVALUATION_ERROR_FINALIZATION_FAILED",
     "EVALUATION_ERROR_INVALID_OPERATION",
-    "EVALUATION_ERROR_INTERNAL_FAILURE"
+    "EVALUATION_ERROR_INTERNAL_FAILURE",
+    "EVALUATION_ERROR_CIRCULAR_REFERENCE",
+    "EVALUATION_ERROR_READ_FAILED",
+    "EVALUATION_ERROR_MALFORMED_DEFINITION",
+    "EVALUATION_ERROR_DUPLICATE_DEFINITION"
 };
 
+static const size_t CACHE_MAXIMUM_ENTRY_COUNT = 65536;
+
+static const size_t CACHE_MAXIMUM_BYTE_COUNT = 64 * 1024 * 1024;
+
+static const size_t OUTPUT_BUFFER_SIZE = 1024 * 1024;
+
 
 void welcome() {
     Console_print(
@@ -55,25 +70,139 @@ void welcome() {
             "\n");
 }
 
-int main() {
+/**
+ * Evaluate an expression with arbitrary precision and print it with
+ * the requested number of significant digits.
+ */
+EvaluationResult printBig(OutputBuffer *output, EvaluatorContext *context,
+        string expression, size_t digits) {
+
+    BigFloat value;
+    EvaluationResult result;
+    string text;
+
+    BigFloat_initialize(&value);
+    result = EvaluatorContext_evaluateBig(context, expression,
+            string_length(expression), &value);
+    if (result == EVALUATION_SUCCESS) {
+        text = BigFloat_toString(&value, digits);
+        OutputBuffer_write(output, text, string_length(text));
+        OutputBuffer_endLine(output);
+        Memory_free(text);
+    }
+    BigFloat_finalize(&value);
+
+    return result;
+}
+
+void printCacheStatistics(ExpressionCache *cache) {
+    Console_printErrorLine("Cache: %zu hits, %zu misses, %zu evictions,"
+            " %zu entries, %zu bytes", cache->hitCount, cache->missCount,
+            cache->evictionCount, cache->entryCount, cache->byteCount);
+}
+
+void printCounter(string name, StatisticsCounter *counter) {
+    if (counter->count != 0) {
+        Console_printErrorLine("  %-10s %12llu times %12.3f ms %10.1f ns",
+                name, (unsigned long long)counter->count,
+                counter->time / 1e6,
+                (double)counter->time / counter->count);
+    }
+}
+
+void printStatistics() {
+
+    Statistics statistics;
+    size_t i;
+
+    if (!Statistics_isEnabled()) {
+        Console_printErrorLine("Statistics: not built in, define"
+                " EVALUATOR_STATISTICS to collect them");
+        return;
+    }
+
+    Statistics_get(&statistics);
+    Console_printErrorLine("Phases:");
+    for (i = 0; i < STATISTICS_PHASE_COUNT; ++i) {
+        printCounter(Statistics_getPhaseName(i), &statistics.phases[i]);
+    }
+    Console_printErrorLine("Operators:");
+    for (i = 0; i < OPERATOR_COUNT; ++i) {
+        printCounter(Operator_getString(i), &statistics.operators[i]);
+    }
+    printCounter("functions", &statistics.operators[OPERATOR_COUNT]);
+}
+
+int main(int argc, string argv[]) {
 
     string line;
     double value;
     EvaluationResult result;
+    ExpressionCache *cache = null;
+    EvaluatorContext *context = EvaluatorContext_new();
+    OutputBuffer *output;
+    bool printsStatistics = false;
+    int i, digits = 0;
+
+    for (i = 1; i < argc; ++i) {
+        if (string_isEqual(argv[i], "--cache")) {
+            cache = ExpressionCache_new(CACHE_MAXIMUM_ENTRY_COUNT,
+                    CACHE_MAXIMUM_BYTE_COUNT);
+            EvaluatorContext_setCache(context, cache);
+        } else if (string_isEqual(argv[i], "--stats")) {
+            printsStatistics = true;
+        } else if (string_isEqual(argv[i], "--degrees")) {
+            EvaluatorContext_setAngleMode(context, ANGLE_MODE_DEGREES);
+        } else if (string_isEqual(argv[i], "--digits") && i + 1 < argc
+                && string_parseInt(argv[i + 1], &digits)
+                        == string_length(argv[i + 1]) && digits > 0) {
+            EvaluatorContext_setDigits(context, digits);
+            ++i;
+        } else {
+            Console_printErrorLine("Unknown option: %s", argv[i]);
+            return 1;
+        }
+    }
 
     welcome();
 
+    /*
+     * Results are written in large blocks, unless someone is waiting
+     * for each of them.
+     */
+    output = OutputBuffer_new(stdout, OUTPUT_BUFFER_SIZE);
+    output->lineBuffered |= isatty(STDIN_FILENO);
+
     while (!string_isEmpty(line = Console_readLine("> "))) {
-        result = evaluateExpression(line, &value);
-        Memory_free(line);
-        if (result == EVALUATION_SUCCESS) {
-            Console_printLine("%.10g", value);
+        if (digits != 0) {
+            result = printBig(output, context, line, digits);
         } else {
+            result = EvaluatorContext_evaluate(context, line,
+                    string_length(line), &value);
+            if (result == EVALUATION_SUCCESS) {
+                OutputBuffer_writeDouble(output, value);
+                OutputBuffer_endLine(output);
+            }
+        }
+        Memory_free(line);
+        if (result != EVALUATION_SUCCESS) {
+            /* Keep errors in order with the results before them. */
+            OutputBuffer_flush(output);
             Console_printErrorLine("Error %d: %s", result,
                     EVALUATION_RESULTS[result]);
         }
     }
     Memory_free(line);
+    OutputBuffer_delete(output);
+    EvaluatorContext_delete(context);
+
+    if (cache != null) {
+        printCacheStatistics(cache);
+        ExpressionCache_delete(cache);
+    }
+    if (printsStatistics) {
+        printStatistics();
+    }
 
     return 0;
 }
@@ -0,0 +1,251 @@
+/**
+ * @file ColumnEvaluator.c
+ * @author: Zhang Hai
+ */
+
+/*
+ * Copyright (C) 2014 Zhang Hai
+ *
+ * This file is part of calc.
+ *
+ * calc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * calc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with calc.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Evaluator.h"
+
+#include "CompiledExpression.h"
+#include "Operator.h"
+#include "Statistics.h"
+
+#include <math.h>
+#include <string.h>
+
+
+/*
+ * Rows are evaluated a block at a time, one instruction over the whole
+ * block, so that the arithmetic runs as tight loops the compiler turns
+ * into vector instructions. The block size is a constant multiple of
+ * the widest vector so that those loops need no remainder handling.
+ */
+#define COLUMN_BLOCK_SIZE 256
+
+/*
+ * Build the block kernel for AVX-512 and AVX2 as well as the baseline,
+ * which is SSE2 on x86-64, and pick one at load time.
+ */
+#if defined(__GNUC__) && defined(__x86_64__)
+#define COLUMN_KERNEL \
+    __attribute__((target_clones("avx512f", "avx2", "default")))
+#else
+#define COLUMN_KERNEL
+#endif
+
+
+/**
+ * Apply an operator lane by lane, for the operators that have no
+ * vector form or can fail.
+ * @note A failing lane keeps the first error it had.
+ * @param operandBlocks The block of each operand, one after another.
+ */
+static void evaluateLanes(Operator operator, Operand *operandBlocks,
+        EvaluationResult *results) {
+
+    Operand operands[OPERATOR_MAXIMUM_OPERAND_COUNT];
+    EvaluationResult result;
+    size_t operandCount = Operator_getOperandCount(operator), i, j;
+
+    for (i = 0; i < COLUMN_BLOCK_SIZE; ++i) {
+        for (j = 0; j < operandCount; ++j) {
+            operands[j] = operandBlocks[j * COLUMN_BLOCK_SIZE + i];
+        }
+        result = Operator_evaluate(operator, operands,
+                &operandBlocks[i]);
+        if (result != EVALUATION_SUCCESS
+                && results[i] == EVALUATION_SUCCESS) {
+            results[i] = result;
+        }
+    }
+}
+
+/**
+ * Evaluate a program over a block of rows.
+ * @note Lanes past laneCount are padded with zero and their results
+ *       are ignored.
+ * @param stack Room for the operand stack and the temporaries, with
+ *        stackDepth + temporaryCount blocks.
+ * @param results The result of each lane.
+ */
+COLUMN_KERNEL
+static void evaluateBlock(CompiledExpression *program,
+        Operand **variableColumns, size_t start, size_t laneCount,
+        Operand *stack, EvaluationResult *results) {
+
+    Instruction *instruction = program->instructions,
+            *end = instruction + program->instructionCount;
+    Operand *top = stack, *operands1, *operands2, *column, constant,
+            *temporaries = stack + program->stackDepth * COLUMN_BLOCK_SIZE;
+    size_t i;
+    STATISTICS_DECLARE_TIME(operatorStart);
+
+    for (i = 0; i < COLUMN_BLOCK_SIZE; ++i) {
+        results[i] = EVALUATION_SUCCESS;
+    }
+
+    for (; instruction != end; ++instruction) {
+        switch (instruction->type) {
+        case INSTRUCTION_CONSTANT:
+            constant = instruction->argument.constant;
+            for (i = 0; i < COLUMN_BLOCK_SIZE; ++i) {
+                top[i] = constant;
+            }
+            top += COLUMN_BLOCK_SIZE;
+            break;
+        case INSTRUCTION_VARIABLE:
+            column = variableColumns[instruction->argument.variable]
+                    + start;
+            for (i = 0; i < laneCount; ++i) {
+                top[i] = column[i];
+            }
+            for (; i < COLUMN_BLOCK_SIZE; ++i) {
+                top[i] = 0;
+            }
+            top += COLUMN_BLOCK_SIZE;
+            break;
+        case INSTRUCTION_OPERATOR:
+            top -= Operator_getOperandCount(instruction->operator)
+                    * COLUMN_BLOCK_SIZE;
+            operands1 = top;
+            operands2 = top + COLUMN_BLOCK_SIZE;
+            STATISTICS_START(operatorStart);
+            switch (instruction->operator) {
+            case OPERATOR_ADDITION:
+                for (i = 0; i < COLUMN_BLOCK_SIZE; ++i) {
+                    operands1[i] += operands2[i];
+                }
+                break;
+            case OPERATOR_SUBTRACTION:
+                for (i = 0; i < COLUMN_BLOCK_SIZE; ++i) {
+                    operands1[i] -= operands2[i];
+                }
+                break;
+            case OPERATOR_MULPLICATION:
+                for (i = 0; i < COLUMN_BLOCK_SIZE; ++i) {
+                    operands1[i] *= operands2[i];
+                }
+                break;
+            case OPERATOR_DIVISION:
+                for (i = 0; i < COLUMN_BLOCK_SIZE; ++i) {
+                    operands1[i] /= operands2[i];
+                }
+                break;
+            case OPERATOR_NEGATIVE:
+                for (i = 0; i < COLUMN_BLOCK_SIZE; ++i) {
+                    operands1[i] = -operands1[i];
+                }
+                break;
+            case OPERATOR_ABS:
+                for (i = 0; i < COLUMN_BLOCK_SIZE; ++i) {
+                    operands1[i] = fabs(operands1[i]);
+                }
+                break;
+            case OPERATOR_FLOOR:
+                for (i = 0; i < COLUMN_BLOCK_SIZE; ++i) {
+                    operands1[i] = floor(operands1[i]);
+                }
+                break;
+            case OPERATOR_CEIL:
+                for (i = 0; i < COLUMN_BLOCK_SIZE; ++i) {
+                    operands1[i] = ceil(operands1[i]);
+                }
+                break;
+            case OPERATOR_FACTORIAL:
+                Operator_evaluateFactorials(operands1, COLUMN_BLOCK_SIZE,
+                        results);
+                break;
+            default:
+                evaluateLanes(instruction->operator, operands1, results);
+                top += COLUMN_BLOCK_SIZE;
+                /* Counted lane by lane, by Operator_evaluate. */
+                continue;
+            }
+            STATISTICS_ADD_OPERATOR(instruction->operator,
+                    COLUMN_BLOCK_SIZE, operatorStart);
+            top += COLUMN_BLOCK_SIZE;
+            break;
+        case INSTRUCTION_STORE:
+            memcpy(temporaries + instruction->argument.temporary
+                    * COLUMN_BLOCK_SIZE, top - COLUMN_BLOCK_SIZE,
+                    COLUMN_BLOCK_SIZE * sizeof(Operand));
+            break;
+        case INSTRUCTION_LOAD:
+            memcpy(top, temporaries + instruction->argument.temporary
+                    * COLUMN_BLOCK_SIZE, COLUMN_BLOCK_SIZE * sizeof(Operand));
+            top += COLUMN_BLOCK_SIZE;
+            break;
+        }
+    }
+}
+
+/**
+ * Evaluate a compiled program over many rows of variable values,
+ * given as one column per variable.
+ * @note Arithmetic is done on whole blocks of rows with vector
+ *       instructions. A row that fails does not stop the others; its
+ *       result is set and its value is left untouched.
+ * @note Rows are evaluated with doubles. Exact integer and rational
+ *       results only come from {@link evaluateCompiled}, so rows can
+ *       differ from it by far more than the last place: 2^62 + 1 - 2^62
+ *       is 1 there and 0 here.
+ * @param program The program returned by {@link compileExpression}.
+ * @param variableColumns The column of values of each variable,
+ *        indexed by their slots, each with count elements.
+ * @param count The number of rows.
+ * @param values The value of each row.
+ * @param results The result of each row, which is the error mask of
+ *        the evaluation.
+ * @return The number of rows that failed.
+ */
+size_t evaluateColumns(CompiledExpression *program,
+        Operand **variableColumns, size_t count, Operand *values,
+        EvaluationResult *results) {
+
+    EvaluationResult blockResults[COLUMN_BLOCK_SIZE];
+    Operand *stack;
+    size_t start, laneCount, i, failedCount = 0;
+    STATISTICS_DECLARE_TIME(startTime);
+
+    STATISTICS_START(startTime);
+
+    stack = reserveScratchStack(SCRATCH_STACK_COLUMNS,
+            (program->stackDepth + program->temporaryCount)
+                    * COLUMN_BLOCK_SIZE);
+
+    for (start = 0; start < count; start += COLUMN_BLOCK_SIZE) {
+        laneCount = MIN(COLUMN_BLOCK_SIZE, count - start);
+        evaluateBlock(program, variableColumns, start, laneCount,
+                stack, blockResults);
+        for (i = 0; i < laneCount; ++i) {
+            results[start + i] = blockResults[i];
+            if (blockResults[i] == EVALUATION_SUCCESS) {
+                values[start + i] = stack[i];
+            } else {
+                ++failedCount;
+            }
+        }
+    }
+
+    STATISTICS_ADD_PHASE(STATISTICS_PHASE_EVALUATE, startTime);
+
+    return failedCount;
+}
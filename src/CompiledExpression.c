@@ -0,0 +1,679 @@
+/**
+ * @file CompiledExpression.c
+ * @author: Zhang Hai
+ */
+
+/*
+ * Copyright (C) 2014 Zhang Hai
+ *
+ * This file is part of calc.
+ *
+ * calc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * calc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with calc.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "CompiledExpression.h"
+
+#include <string.h>
+
+
+static const size_t INITIAL_ALLOCATION_SIZE = 8;
+
+static const size_t NO_TEMPORARY = (size_t)-1;
+
+/*
+ * Terms of a chain in each chunk, which is also the fewest for a chain
+ * to be split. Chunks do not depend on the number of threads, so
+ * neither does the result.
+ */
+static const size_t CHAIN_CHUNK_TERM_COUNT = 4096;
+
+
+/**
+ * A node of the program as a DAG, where equal subexpressions are the
+ * same node.
+ */
+typedef struct {
+    Instruction instruction;
+    size_t operands[OPERATOR_MAXIMUM_OPERAND_COUNT];
+    size_t operandCount;
+    /* Text of a constant, not owned. */
+    string literal;
+    size_t hash;
+    size_t useCount;
+    size_t temporary;
+    bool emitted;
+} ExpressionNode;
+
+typedef struct {
+    size_t node;
+    bool expanded;
+} ExpressionNodeVisit;
+
+
+static void ExpressionChain_delete(ExpressionChain *chain) {
+
+    if (chain == null) {
+        return;
+    }
+
+    Memory_free(chain->termEnds);
+    Memory_free(chain->chunkStarts);
+    Memory_free(chain->sharedRanges);
+    Memory_free(chain->isShared);
+
+    Memory_free(chain);
+}
+
+CompiledExpression *CompiledExpression_new() {
+
+    /* Memory is allocated on the first instruction or variable. */
+    return Memory_allocateType(CompiledExpression);
+}
+
+void CompiledExpression_delete(CompiledExpression *program) {
+
+    string_array_free(program->variableNames, program->variableCount);
+    Memory_free(program->variableNames);
+
+    string_array_free(program->literals, program->literalCount);
+    Memory_free(program->literals);
+
+    Memory_free(program->instructions);
+
+    ExpressionChain_delete(program->chain);
+
+    Memory_free(program);
+}
+
+/**
+ * Clear a {@link CompiledExpression} for reuse, keeping the memory
+ * allocated for its instructions.
+ */
+void CompiledExpression_clear(CompiledExpression *program) {
+
+    string_array_free(program->variableNames, program->variableCount);
+    program->variableCount = 0;
+
+    string_array_free(program->literals, program->literalCount);
+    program->literalCount = 0;
+
+    program->instructionCount = 0;
+    program->stackDepth = 0;
+    program->temporaryCount = 0;
+    program->eliminatedOperatorCount = 0;
+    program->inexact = false;
+
+    ExpressionChain_delete(program->chain);
+    program->chain = null;
+}
+
+void CompiledExpression_addInstruction(CompiledExpression *program,
+        Instruction *instruction) {
+
+    Rational rational;
+
+    if (program->instructionCount
+            == program->allocatedInstructionCount) {
+        program->allocatedInstructionCount =
+                program->allocatedInstructionCount == 0
+                        ? INITIAL_ALLOCATION_SIZE
+                        : 2 * program->allocatedInstructionCount;
+        program->instructions = Memory_reallocate(
+                program->instructions,
+                program->allocatedInstructionCount
+                        * sizeof(Instruction));
+    }
+
+    switch (instruction->type) {
+    case INSTRUCTION_CONSTANT:
+        program->inexact |= !Rational_fromOperand(
+                instruction->argument.constant, &rational);
+        break;
+    case INSTRUCTION_OPERATOR:
+        program->inexact |= !Operator_isRational(instruction->operator);
+        break;
+    default:
+        break;
+    }
+
+    program->instructions[program->instructionCount] = *instruction;
+    ++program->instructionCount;
+}
+
+/**
+ * Add a variable to a {@link CompiledExpression} if it is not already
+ * there.
+ * @param name The name of the variable, not necessarily
+ *        null-terminated.
+ * @param length The length of the name.
+ * @return The slot of the variable.
+ */
+size_t CompiledExpression_addVariable(CompiledExpression *program,
+        string name, size_t length) {
+
+    size_t i;
+
+    for (i = 0; i < program->variableCount; ++i) {
+        if (string_length(program->variableNames[i]) == length
+                && strncmp(program->variableNames[i], name, length)
+                        == 0) {
+            return i;
+        }
+    }
+
+    if (program->variableCount == program->allocatedVariableCount) {
+        program->allocatedVariableCount =
+                program->allocatedVariableCount == 0
+                        ? INITIAL_ALLOCATION_SIZE
+                        : 2 * program->allocatedVariableCount;
+        program->variableNames = Memory_reallocate(
+                program->variableNames,
+                program->allocatedVariableCount * sizeof(string));
+    }
+
+    program->variableNames[program->variableCount] = string_subString(
+            name, 0, length);
+    return program->variableCount++;
+}
+
+/**
+ * Add the text of the next constant to a {@link CompiledExpression}.
+ * @param text The text of the constant, not necessarily
+ *        null-terminated.
+ * @param length The length of the text.
+ */
+void CompiledExpression_addLiteral(CompiledExpression *program,
+        string text, size_t length) {
+
+    if (program->literalCount == program->allocatedLiteralCount) {
+        program->allocatedLiteralCount =
+                program->allocatedLiteralCount == 0
+                        ? INITIAL_ALLOCATION_SIZE
+                        : 2 * program->allocatedLiteralCount;
+        program->literals = Memory_reallocate(program->literals,
+                program->allocatedLiteralCount * sizeof(string));
+    }
+
+    program->literals[program->literalCount++] = string_subString(
+            text, 0, length);
+}
+
+size_t CompiledExpression_getVariableCount(
+        CompiledExpression *program) {
+    return program->variableCount;
+}
+
+string CompiledExpression_getVariableName(CompiledExpression *program,
+        size_t index) {
+    return program->variableNames[index];
+}
+
+/**
+ * Get the slot of a variable in a {@link CompiledExpression}.
+ * @return The slot of the variable, or -1 if the expression does not
+ *         reference it.
+ */
+size_t CompiledExpression_indexOfVariable(CompiledExpression *program,
+        string name) {
+    return string_array_containsEqual(program->variableNames,
+            program->variableCount, name);
+}
+
+/**
+ * Put the operands of a commutative operator in a canonical order, so
+ * that a + b and b + a are the same node.
+ */
+static void ExpressionNode_sortOperands(ExpressionNode *node) {
+
+    size_t temporary;
+
+    if (node->instruction.type == INSTRUCTION_OPERATOR
+            && (node->instruction.operator == OPERATOR_ADDITION
+                    || node->instruction.operator
+                            == OPERATOR_MULPLICATION)
+            && node->operands[0] > node->operands[1]) {
+        SWAP(node->operands[0], node->operands[1], temporary);
+    }
+}
+
+static size_t ExpressionNode_hash(ExpressionNode *node) {
+
+    size_t hash = (size_t)node->instruction.type, i;
+
+    switch (node->instruction.type) {
+    case INSTRUCTION_CONSTANT:
+        /* Hash the bits, so that 0 and -0 stay apart. */
+        hash = hash * 31 + string_hashWithLength(
+                (string)&node->instruction.argument.constant,
+                sizeof(Operand));
+        break;
+    case INSTRUCTION_VARIABLE:
+        hash = hash * 31 + node->instruction.argument.variable;
+        break;
+    default:
+        hash = hash * 31 + (size_t)node->instruction.operator;
+        for (i = 0; i < node->operandCount; ++i) {
+            hash = hash * 31 + node->operands[i];
+        }
+    }
+
+    return hash * (size_t)11400714819323198485ULL;
+}
+
+static bool ExpressionNode_isEqual(ExpressionNode *node1,
+        ExpressionNode *node2) {
+
+    size_t i;
+
+    if (node1->hash != node2->hash
+            || node1->instruction.type != node2->instruction.type) {
+        return false;
+    }
+    switch (node1->instruction.type) {
+    case INSTRUCTION_CONSTANT:
+        /* Constants written differently stay apart for exact backends. */
+        return memcmp(&node1->instruction.argument.constant,
+                &node2->instruction.argument.constant, sizeof(Operand))
+                        == 0
+                && (node1->literal == node2->literal
+                        || (node1->literal != null && node2->literal != null
+                                && string_isEqual(node1->literal,
+                                        node2->literal)));
+    case INSTRUCTION_VARIABLE:
+        return node1->instruction.argument.variable
+                == node2->instruction.argument.variable;
+    default:
+        if (node1->instruction.operator != node2->instruction.operator) {
+            return false;
+        }
+        for (i = 0; i < node1->operandCount; ++i) {
+            if (node1->operands[i] != node2->operands[i]) {
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+/**
+ * Build the DAG of a program, merging equal subexpressions.
+ * @param nodes Room for one node per instruction.
+ * @return The number of nodes.
+ */
+static size_t CompiledExpression_buildNodes(CompiledExpression *program,
+        ExpressionNode *nodes, size_t *root) {
+
+    size_t bucketCount = 1, *buckets, *stack, stackSize = 0,
+            nodeCount = 0, literalIndex = 0, i, j, bucket;
+    Instruction *instruction;
+    ExpressionNode *node;
+
+    while (bucketCount < 2 * program->instructionCount) {
+        bucketCount *= 2;
+    }
+    buckets = Memory_allocate(bucketCount * sizeof(size_t));
+    for (i = 0; i < bucketCount; ++i) {
+        buckets[i] = (size_t)-1;
+    }
+    stack = Memory_allocate(program->instructionCount * sizeof(size_t));
+
+    for (i = 0; i < program->instructionCount; ++i) {
+        instruction = &program->instructions[i];
+        node = &nodes[nodeCount];
+        node->instruction = *instruction;
+        node->operandCount = instruction->type == INSTRUCTION_OPERATOR
+                ? Operator_getOperandCount(instruction->operator) : 0;
+        stackSize -= node->operandCount;
+        for (j = 0; j < node->operandCount; ++j) {
+            node->operands[j] = stack[stackSize + j];
+        }
+        ExpressionNode_sortOperands(node);
+        node->literal = instruction->type == INSTRUCTION_CONSTANT
+                && literalIndex < program->literalCount
+                ? program->literals[literalIndex++] : null;
+        node->hash = ExpressionNode_hash(node);
+        node->useCount = 0;
+        node->temporary = NO_TEMPORARY;
+        node->emitted = false;
+
+        /* Open addressing with linear probing. */
+        bucket = node->hash & (bucketCount - 1);
+        while (buckets[bucket] != (size_t)-1
+                && !ExpressionNode_isEqual(&nodes[buckets[bucket]],
+                        node)) {
+            bucket = (bucket + 1) & (bucketCount - 1);
+        }
+        if (buckets[bucket] == (size_t)-1) {
+            buckets[bucket] = nodeCount++;
+        }
+        stack[stackSize++] = buckets[bucket];
+    }
+
+    *root = stack[stackSize - 1];
+
+    Memory_free(stack);
+    Memory_free(buckets);
+
+    return nodeCount;
+}
+
+static size_t CompiledExpression_countOperators(
+        CompiledExpression *program) {
+
+    size_t count = 0, i;
+
+    for (i = 0; i < program->instructionCount; ++i) {
+        if (program->instructions[i].type == INSTRUCTION_OPERATOR) {
+            ++count;
+        }
+    }
+
+    return count;
+}
+
+static void CompiledExpression_emitNode(CompiledExpression *program,
+        ExpressionNode *node, size_t *depth) {
+
+    Instruction instruction;
+
+    if (node->emitted) {
+        instruction.type = INSTRUCTION_LOAD;
+        instruction.argument.temporary = node->temporary;
+        CompiledExpression_addInstruction(program, &instruction);
+        ++*depth;
+    } else {
+        CompiledExpression_addInstruction(program, &node->instruction);
+        if (node->literal != null) {
+            CompiledExpression_addLiteral(program, node->literal,
+                    string_length(node->literal));
+        }
+        *depth += 1 - node->operandCount;
+        if (node->temporary != NO_TEMPORARY) {
+            instruction.type = INSTRUCTION_STORE;
+            instruction.argument.temporary = node->temporary;
+            CompiledExpression_addInstruction(program, &instruction);
+            node->emitted = true;
+        }
+    }
+    program->stackDepth = MAX(program->stackDepth, *depth);
+}
+
+/**
+ * Evaluate each distinct subexpression of a {@link CompiledExpression}
+ * only once, keeping the value of one that is used again in a
+ * temporary.
+ * @note Operands of + and * are matched in either order. Constants are
+ *       matched by their bits and, when recorded, their text.
+ */
+void CompiledExpression_eliminateCommonSubexpressions(
+        CompiledExpression *program) {
+
+    ExpressionNode *nodes;
+    ExpressionNodeVisit *visits, visit;
+    size_t nodeCount, root, temporaryCount = 0, visitCount = 0,
+            operatorCount = 0, literalCount, depth = 0, i, j;
+    string *literals;
+
+    if (program->instructionCount == 0) {
+        return;
+    }
+
+    nodes = Memory_allocate(program->instructionCount
+            * sizeof(ExpressionNode));
+    nodeCount = CompiledExpression_buildNodes(program, nodes, &root);
+
+    ++nodes[root].useCount;
+    for (i = 0; i < nodeCount; ++i) {
+        for (j = 0; j < nodes[i].operandCount; ++j) {
+            ++nodes[nodes[i].operands[j]].useCount;
+        }
+    }
+    /* Leaves are as cheap to push again as a temporary. */
+    for (i = 0; i < nodeCount; ++i) {
+        if (nodes[i].instruction.type == INSTRUCTION_OPERATOR
+                && nodes[i].useCount > 1) {
+            nodes[i].temporary = temporaryCount++;
+        }
+    }
+    if (temporaryCount == 0) {
+        Memory_free(nodes);
+        return;
+    }
+
+    operatorCount = CompiledExpression_countOperators(program);
+
+    /* The nodes hold copies of the instructions and the old literals. */
+    literals = program->literals;
+    literalCount = program->literalCount;
+    program->literals = null;
+    program->literalCount = 0;
+    program->allocatedLiteralCount = 0;
+    program->instructionCount = 0;
+    program->stackDepth = 0;
+    program->inexact = false;
+
+    /*
+     * Emit in postorder without recursion. Each operator node is
+     * expanded once, pushing itself again and its operands.
+     */
+    visits = Memory_allocate(((OPERATOR_MAXIMUM_OPERAND_COUNT + 1)
+            * nodeCount + 1) * sizeof(ExpressionNodeVisit));
+    visits[visitCount].node = root;
+    visits[visitCount++].expanded = false;
+    while (visitCount != 0) {
+        visit = visits[--visitCount];
+        if (visit.expanded || nodes[visit.node].emitted) {
+            CompiledExpression_emitNode(program, &nodes[visit.node],
+                    &depth);
+            continue;
+        }
+        visits[visitCount].node = visit.node;
+        visits[visitCount++].expanded = true;
+        for (i = nodes[visit.node].operandCount; i > 0; --i) {
+            visits[visitCount].node = nodes[visit.node].operands[i - 1];
+            visits[visitCount++].expanded = false;
+        }
+    }
+
+    program->temporaryCount = temporaryCount;
+    program->eliminatedOperatorCount = operatorCount
+            - CompiledExpression_countOperators(program);
+
+    Memory_free(visits);
+    string_array_free(literals, literalCount);
+    Memory_free(literals);
+    Memory_free(nodes);
+}
+
+/**
+ * Mark the terms of a chain, walking the operands of the operator at
+ * the root backward; those that are the same operator and not shared
+ * belong to the chain, and any other one is a term.
+ * @return The number of terms.
+ */
+static size_t ExpressionChain_markTerms(ExpressionChain *chain,
+        CompiledExpression *program) {
+
+    Instruction *instruction;
+    bool *inChain, stored = false, isTerm, isLink;
+    size_t pendingCount = 0, termCount = 0, operandCount, i, j;
+
+    /* Whether each value yet to be seen belongs to the chain. */
+    inChain = Memory_allocate((program->stackDepth + 1) * sizeof(bool));
+    inChain[pendingCount++] = true;
+    for (i = program->instructionCount; i > 0; --i) {
+        instruction = &program->instructions[i - 1];
+        if (instruction->type == INSTRUCTION_STORE) {
+            stored = true;
+            continue;
+        }
+        operandCount = instruction->type == INSTRUCTION_OPERATOR
+                ? Operator_getOperandCount(instruction->operator) : 0;
+        isTerm = inChain[--pendingCount];
+        isLink = isTerm && !stored
+                && instruction->type == INSTRUCTION_OPERATOR
+                && instruction->operator == chain->operator;
+        if (isTerm && !isLink) {
+            j = stored ? i : i - 1;
+            chain->termEnds[j / 8] |= 1 << (j % 8);
+            ++termCount;
+        }
+        for (j = 0; j < operandCount; ++j) {
+            inChain[pendingCount++] = isLink;
+        }
+        stored = false;
+    }
+    Memory_free(inChain);
+
+    return termCount;
+}
+
+/**
+ * Split the terms of a chain into chunks, and find the temporaries
+ * shared by chunks along with the ranges of instructions computing
+ * them.
+ */
+static void ExpressionChain_split(ExpressionChain *chain,
+        CompiledExpression *program, size_t termCount) {
+
+    Instruction *instruction;
+    size_t *starts, *storeStarts, *storeChunks,
+            depth = 0, chunk = 0, rangeStart = (size_t)-1, temporary,
+            i;
+
+    chain->chunkCount = termCount / CHAIN_CHUNK_TERM_COUNT;
+    chain->chunkStarts = Memory_allocate(chain->chunkCount
+            * sizeof(size_t));
+    chain->isShared = Memory_allocate((program->temporaryCount + 1)
+            * sizeof(bool));
+    /* The first instruction of each value on the operand stack. */
+    starts = Memory_allocate((program->stackDepth + 1) * sizeof(size_t));
+    storeStarts = Memory_allocate((program->temporaryCount + 1)
+            * sizeof(size_t));
+    storeChunks = Memory_allocate((program->temporaryCount + 1)
+            * sizeof(size_t));
+
+    termCount = 0;
+    for (i = 0; i < program->instructionCount; ++i) {
+        instruction = &program->instructions[i];
+        switch (instruction->type) {
+        case INSTRUCTION_OPERATOR:
+            depth -= Operator_getOperandCount(instruction->operator);
+            ++depth;
+            break;
+        case INSTRUCTION_STORE:
+            temporary = instruction->argument.temporary;
+            storeStarts[temporary] = starts[depth - 1];
+            storeChunks[temporary] = chunk;
+            break;
+        case INSTRUCTION_LOAD:
+            temporary = instruction->argument.temporary;
+            if (storeChunks[temporary] != chunk) {
+                chain->isShared[temporary] = true;
+            }
+            /* Fall through. */
+        default:
+            starts[depth++] = i;
+        }
+        if (ExpressionChain_isTermEnd(chain, i)
+                && ++termCount % CHAIN_CHUNK_TERM_COUNT == 0
+                && termCount / CHAIN_CHUNK_TERM_COUNT
+                        < chain->chunkCount) {
+            chain->chunkStarts[++chunk] = i + 1;
+        }
+    }
+
+    /*
+     * Walk backward, so that a temporary loaded while computing a shared
+     * one is also shared before its own store is reached. A range inside
+     * another one is left to it.
+     */
+    chain->sharedRanges = Memory_allocate(2 * (program->temporaryCount
+            + 1) * sizeof(size_t));
+    for (i = program->instructionCount; i > 0; --i) {
+        instruction = &program->instructions[i - 1];
+        if (rangeStart != (size_t)-1 && i - 1 < rangeStart) {
+            rangeStart = (size_t)-1;
+        }
+        temporary = instruction->argument.temporary;
+        if (instruction->type == INSTRUCTION_LOAD
+                && rangeStart != (size_t)-1) {
+            chain->isShared[temporary] = true;
+        } else if (instruction->type == INSTRUCTION_STORE
+                && chain->isShared[temporary]
+                && rangeStart == (size_t)-1) {
+            rangeStart = storeStarts[temporary];
+            chain->sharedRanges[2 * chain->sharedRangeCount] = rangeStart;
+            chain->sharedRanges[2 * chain->sharedRangeCount + 1] = i;
+            ++chain->sharedRangeCount;
+        }
+    }
+    /* Ranges are run in order. */
+    for (i = 0; i < chain->sharedRangeCount / 2; ++i) {
+        SWAP(chain->sharedRanges[2 * i], chain->sharedRanges[2
+                * (chain->sharedRangeCount - 1 - i)], temporary);
+        SWAP(chain->sharedRanges[2 * i + 1], chain->sharedRanges[2
+                * (chain->sharedRangeCount - 1 - i) + 1], temporary);
+    }
+
+    Memory_free(storeChunks);
+    Memory_free(storeStarts);
+    Memory_free(starts);
+}
+
+/**
+ * Find a long chain of + or * at the top level of a program, so that
+ * its terms can be evaluated in chunks in parallel.
+ * @note Chunks have a fixed number of terms, so that the result does
+ *       not depend on the number of threads; a chain too short to make
+ *       at least two chunks is not kept.
+ */
+void CompiledExpression_findChain(CompiledExpression *program) {
+
+    Instruction *root;
+    ExpressionChain *chain;
+    size_t termCount;
+
+    if (program->instructionCount == 0) {
+        return;
+    }
+    root = &program->instructions[program->instructionCount - 1];
+    if (root->type != INSTRUCTION_OPERATOR
+            || (root->operator != OPERATOR_ADDITION
+                    && root->operator != OPERATOR_MULPLICATION)) {
+        return;
+    }
+
+    chain = Memory_allocateType(ExpressionChain);
+    chain->operator = root->operator;
+    chain->termEnds = Memory_allocate(
+            (program->instructionCount + 7) / 8);
+    termCount = ExpressionChain_markTerms(chain, program);
+    if (termCount < 2 * CHAIN_CHUNK_TERM_COUNT) {
+        ExpressionChain_delete(chain);
+        return;
+    }
+    ExpressionChain_split(chain, program, termCount);
+
+    program->chain = chain;
+}
+
+/**
+ * Get the number of operators that sharing subexpressions saves on each
+ * evaluation of a {@link CompiledExpression}.
+ */
+size_t CompiledExpression_getEliminatedOperatorCount(
+        CompiledExpression *program) {
+    return program->eliminatedOperatorCount;
+}
@@ -0,0 +1,154 @@
+/**
+ * @file CompiledExpression.h
+ * @author: Zhang Hai
+ */
+
+/*
+ * Copyright (C) 2014 Zhang Hai
+ *
+ * This file is part of calc.
+ *
+ * calc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * calc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with calc.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _COMPILED_EXPRESSION_H_
+#define _COMPILED_EXPRESSION_H_
+
+
+#include "zhclib/Common.h"
+
+#include "Evaluator.h"
+#include "Operator.h"
+
+
+typedef enum {
+    INSTRUCTION_CONSTANT,
+    INSTRUCTION_VARIABLE,
+    INSTRUCTION_OPERATOR,
+    INSTRUCTION_STORE,
+    INSTRUCTION_LOAD
+} InstructionType;
+
+/**
+ * An instruction of the postfix program, which pushes a constant or
+ * a variable onto the operand stack, or applies an operator to the
+ * operands on top of it.
+ * @note A subexpression that occurs more than once is evaluated once
+ *       and kept with a store, which copies the top of the operand
+ *       stack into a temporary, and later pushed again with a load.
+ */
+typedef struct {
+    InstructionType type;
+    Operator operator;
+    union {
+        Operand constant;
+        size_t variable;
+        size_t temporary;
+    } argument;
+} Instruction;
+
+/**
+ * A long chain of + or * at the top level of a program, like
+ * a1 + a2 + ... + an, whose terms can be evaluated in chunks in
+ * parallel.
+ * @note A temporary loaded by a chunk other than the one storing it is
+ *       shared; it is computed beforehand by running the ranges of
+ *       instructions that compute it, and the chunks skip storing it.
+ */
+typedef struct {
+    Operator operator;
+    /* A bit set at the last instruction of each term. */
+    unsigned char *termEnds;
+    /* The first instruction of each chunk. */
+    size_t *chunkStarts;
+    size_t chunkCount;
+    /* Start and end of each range computing the shared temporaries. */
+    size_t *sharedRanges;
+    size_t sharedRangeCount;
+    bool *isShared;
+} ExpressionChain;
+
+/**
+ * Operand stacks that the evaluators other than evaluateCompiled keep
+ * in the context of each thread, so that they are reused across calls
+ * and freed when the thread exits.
+ */
+typedef enum {
+    /* Blocks of the operand stack of evaluateColumns. */
+    SCRATCH_STACK_COLUMNS,
+    /* Values and tangents of the operand stack of evaluateGradient. */
+    SCRATCH_STACK_DUALS,
+    /* Values of the variables of a formula being evaluated. */
+    SCRATCH_STACK_VARIABLES,
+    SCRATCH_STACK_COUNT
+} ScratchStack;
+
+typedef struct tagCompiledExpression {
+    Instruction *instructions;
+    size_t instructionCount;
+    size_t allocatedInstructionCount;
+    string *variableNames;
+    size_t variableCount;
+    size_t allocatedVariableCount;
+    /*
+     * Text of each constant in order, for evaluating at a higher
+     * precision than a double; only kept by compileExpression.
+     */
+    string *literals;
+    size_t literalCount;
+    size_t allocatedLiteralCount;
+    /* Maximum depth of the operand stack during evaluation. */
+    size_t stackDepth;
+    /*
+     * Number of temporaries for shared subexpressions, which follow
+     * the operand stack in the memory for evaluation.
+     */
+    size_t temporaryCount;
+    /* Number of operators removed by sharing subexpressions. */
+    size_t eliminatedOperatorCount;
+    /*
+     * Whether a constant or an operator has no exact rational form, so
+     * that evaluation should go directly to doubles.
+     */
+    bool inexact;
+    /* The chain of + or * at the top level, if long enough, or null. */
+    ExpressionChain *chain;
+} CompiledExpression;
+
+
+CompiledExpression *CompiledExpression_new();
+
+void CompiledExpression_clear(CompiledExpression *program);
+
+void CompiledExpression_addInstruction(CompiledExpression *program,
+        Instruction *instruction);
+
+size_t CompiledExpression_addVariable(CompiledExpression *program,
+        string name, size_t length);
+
+void CompiledExpression_addLiteral(CompiledExpression *program,
+        string text, size_t length);
+
+void CompiledExpression_eliminateCommonSubexpressions(
+        CompiledExpression *program);
+
+void CompiledExpression_findChain(CompiledExpression *program);
+
+Operand *reserveScratchStack(ScratchStack stack, size_t size);
+
+#define ExpressionChain_isTermEnd(chain, index) \
+    (((chain)->termEnds[(index) / 8] >> ((index) % 8)) & 1)
+
+
+#endif /* _COMPILED_EXPRESSION_H_ */
@@ -24,448 +24,1437 @@
 
 #include "Evaluator.h"
 
+#include "zhclib/ArrayStack.h"
+#include "zhclib/NumberParser.h"
+#include "zhclib/ThreadPool.h"
+
+#include "CompiledExpression.h"
+#include "ExpressionCache.h"
+#include "FunctionRegistry.h"
+#include "Lexer.h"
+#include "Operator.h"
+#include "Statistics.h"
+
 #include <math.h>
+#include <pthread.h>
+#include <string.h>
+#include <strings.h>
+
+
+/* Operand stack size that evaluation can use without allocation. */
+#define EVALUATION_STACK_SIZE 64
 
-#include "zhclib/LinkedStack.h"
+/* Bytes read at a time by evaluateStream. */
+#define STREAM_CHUNK_SIZE 65536
 
+/* Significant digits of arbitrary precision evaluation in a context. */
+#define DEFAULT_BIG_DIGITS 32
 
-static double E = 2.71828182846;
 
-static double PI = 3.14159265359;
+ARRAY_STACK_DEFINE(Operator)
 
+ARRAY_STACK_DEFINE(Operand)
 
-double factorial(unsigned int operand) {
-    double result = 1;
-    if (operand == 0 || operand == 1) {
-        return 1;
+ARRAY_STACK_DEFINE(Rational)
+
+/**
+ * Partial result of a chunk of the terms of a chain.
+ */
+typedef struct {
+    Operand value;
+    /* Rounding error of a sum, which is not yet added to the value. */
+    Operand compensation;
+    EvaluationResult result;
+} ChainChunk;
+
+ARRAY_STACK_DEFINE(ChainChunk)
+
+/**
+ * State of compiling an expression into a postfix program with the
+ * operator precedence algorithm.
+ * @note Without a program, the expression is evaluated as it is
+ *       parsed instead, so that memory grows with its nesting depth
+ *       rather than its length.
+ */
+typedef struct {
+    Lexer lexer;
+    OperatorStack *operatorStack;
+    CompiledExpression *program;
+    /* Values of the operand stack, when evaluating while parsing. */
+    OperandStack *operandStack;
+    /* Exact values of the operand stack, kept while they are exact. */
+    RationalStack *rationalStack;
+    bool exact;
+    /* Unit of the operands of sin, cos and tan and of the results of
+     * their inverses. */
+    AngleMode angleMode;
+    /* First error of evaluating while parsing. */
+    EvaluationResult evaluationResult;
+    /* Depth of the operand stack when the program is run. */
+    size_t stackDepth;
+    /* Whether an operand is expected next, making a sign a prefix. */
+    bool expectOperand;
+    /* Whether at the start of the expression or of a parenthesis. */
+    bool atGroupStart;
+    /* Whether the signs read at the start of a group negate it. */
+    bool negateGroup;
+} Parser;
+
+/**
+ * Scratch memory reused across calls, so that evaluation stops
+ * allocating once it has grown large enough, together with the
+ * settings of evaluation.
+ */
+struct tagEvaluatorContext {
+    OperatorStack operatorStack;
+    OperandStack operandStack;
+    RationalStack rationalStack;
+    /* Temporaries and partial results of evaluating a chain. */
+    OperandStack chainTemporaries;
+    ChainChunkStack chainChunks;
+    /* Scratch of the other evaluators, indexed by ScratchStack. */
+    OperandStack scratchStacks[SCRATCH_STACK_COUNT];
+    /* Chunks read by evaluateStream. */
+    string streamBuffer;
+    size_t streamBufferSize;
+    AngleMode angleMode;
+    /* Significant digits of EvaluatorContext_evaluateBig. */
+    size_t digits;
+    ExpressionCache *cache;
+};
+
+
+/*
+ * Context of the functions that take none. It is per thread so that
+ * expressions can be evaluated concurrently; so is the operand stack
+ * of the chunks of a chain, which run on the threads of chainPool.
+ * It is used through getThreadContext, which has its memory freed
+ * through threadContextKey when the thread exits.
+ */
+static __thread EvaluatorContext threadContext;
+
+static __thread bool threadContextRegistered = false;
+
+static pthread_key_t threadContextKey;
+
+static pthread_once_t threadContextKeyOnce = PTHREAD_ONCE_INIT;
+
+static ThreadPool *chainPool = null;
+
+/* Guards chainPool; a caller finding it busy does without. */
+static pthread_mutex_t chainMutex = PTHREAD_MUTEX_INITIALIZER;
+
+
+/**
+ * Free the memory of an {@link EvaluatorContext}, leaving it empty.
+ * @note Its cache is not deleted, since it is not owned by it.
+ */
+static void finalizeContext(EvaluatorContext *context) {
+
+    size_t i;
+
+    OperatorStack_finalize(&context->operatorStack);
+    OperandStack_finalize(&context->operandStack);
+    RationalStack_finalize(&context->rationalStack);
+    OperandStack_finalize(&context->chainTemporaries);
+    ChainChunkStack_finalize(&context->chainChunks);
+    for (i = 0; i < SCRATCH_STACK_COUNT; ++i) {
+        OperandStack_finalize(&context->scratchStacks[i]);
     }
-    do {
-        result *= operand--;
-    } while (operand > 1);
-    return result;
+    Memory_free(context->streamBuffer);
+    context->streamBuffer = null;
+    context->streamBufferSize = 0;
 }
 
 /**
- * Evaluate the stack reversely, so the operator stack should be kept
- * in strict (for operators may not be commutative) ascending
- * precedence order.
- */
-
-typedef enum {
-    OPERATOR_ADDITION,
-    OPERATOR_SUBTRACTION,
-    OPERATOR_MULPLICATION,
-    OPERATOR_DIVISION,
-    OPERATOR_POWER,
-    OPERATOR_FACTORIAL,
-    OPERATOR_PARENTHESIS_LEFT,
-    OPERATOR_SIN,
-    OPERATOR_COS,
-    OPERATOR_TAN,
-    OPERATOR_POW,
-    OPERATOR_LOG,
-    OPERATOR_COMMA,
-    OPERATOR_PARENTHESIS_RIGHT
-} Operator;
-
-static int OPERATOR_PRECEDENCE[] = {
-    1,
-    1,
-    2,
-    2,
-    3,
-    4,
-    5,
-    5,
-    5,
-    5,
-    5,
-    5,
-    0,
-    0
-};
+ * Free the context of a thread as it exits.
+ */
+static void finalizeThreadContext(void *context) {
+    finalizeContext(context);
+    threadContextRegistered = false;
+}
 
-static string OPERATOR_STRINGS[] = {
-    "+",
-    "-",
-    "*",
-    "/",
-    "^",
-    "!",
-    "(",
-    "sin(",
-    "cos(",
-    "tan(",
-    "pow(",
-    "log(",
-    ",",
-    ")"
-};
+static void createThreadContextKey() {
+    pthread_key_create(&threadContextKey, finalizeThreadContext);
+}
 
-int Operator_comparePrecedence(Operator operator1,
-        Operator operator2) {
-    if (OPERATOR_PRECEDENCE[operator1]
-                    == OPERATOR_PRECEDENCE[OPERATOR_PARENTHESIS_LEFT]
-            || operator1 == OPERATOR_COMMA) {
-        /* Magic left parenthesis & comma! */
-        return -1;
-    } else if (operator1 == OPERATOR_PARENTHESIS_RIGHT) {
-        /* Magic right parenthesis */
-        return 1;
-    } else {
-        return OPERATOR_PRECEDENCE[operator1]
-                - OPERATOR_PRECEDENCE[operator2];
+/**
+ * Get the context of the calling thread, making sure that its memory
+ * is freed when the thread exits, as the threads of a pool do when it
+ * is deleted.
+ */
+static EvaluatorContext *getThreadContext() {
+    if (!threadContextRegistered) {
+        pthread_once(&threadContextKeyOnce, createThreadContextKey);
+        pthread_setspecific(threadContextKey, &threadContext);
+        threadContextRegistered = true;
     }
+    return &threadContext;
 }
 
-bool replaceExpressionStart(string *expression, string old,
-        string new) {
-    if (string_startsWith(*expression, old)) {
-        string_subsititute(expression,
-                string_replaceFirst(*expression, old, new));
+/**
+ * Read the operator for a token.
+ * @note A function call is an identifier immediately followed by a
+ *       left parenthesis, which is consumed together as one operator.
+ *       Function names are looked up in the hash table of the
+ *       registry, so that adding functions does not slow this down.
+ */
+bool readOperator(Token *token, Lexer *lexer, Operator *operator) {
+
+    Token nextToken;
+
+    switch (token->type) {
+    case TOKEN_OPERATOR:
+        switch (*Token_getText(token, lexer)) {
+        case '+':
+            *operator = OPERATOR_ADDITION;
+            return true;
+        case '-':
+            *operator = OPERATOR_SUBTRACTION;
+            return true;
+        case '*':
+            *operator = OPERATOR_MULPLICATION;
+            return true;
+        case '/':
+            *operator = OPERATOR_DIVISION;
+            return true;
+        case '^':
+            *operator = OPERATOR_POWER;
+            return true;
+        case '!':
+            *operator = OPERATOR_FACTORIAL;
+            return true;
+        default:
+            return false;
+        }
+    case TOKEN_PARENTHESIS_LEFT:
+        *operator = OPERATOR_PARENTHESIS_LEFT;
         return true;
-    } else {
+    case TOKEN_PARENTHESIS_RIGHT:
+        *operator = OPERATOR_PARENTHESIS_RIGHT;
+        return true;
+    case TOKEN_COMMA:
+        *operator = OPERATOR_COMMA;
+        return true;
+    case TOKEN_IDENTIFIER:
+        if (Lexer_peek(lexer, &nextToken) != TOKEN_PARENTHESIS_LEFT
+                || !FunctionRegistry_find(Token_getText(token, lexer),
+                        token->length, operator)) {
+            return false;
+        }
+        Lexer_next(lexer, &nextToken);
+        return true;
+    default:
         return false;
     }
 }
 
-bool replaceExpressionRecursive(string *expression, string old,
-        string new) {
-    string theExpression = string_replaceRecursiveReturnsNull(
-            *expression, old, new);
-    if (theExpression == null) {
-        return false;
-    } else {
-        Memory_free(*expression);
-        *expression = theExpression;
+bool readOperand(string start, string end, Operand *operand) {
+
+    size_t length = end - start;
+
+    if (length == 1 && (*start == 'e' || *start == 'E')) {
+        *operand = M_E;
+        return true;
+    } else if (length == 2 && strncasecmp(start, "pi", 2) == 0) {
+        *operand = M_PI;
         return true;
     }
+
+    return NumberParser_parseDouble(start, length, operand) == length;
 }
 
-void normalizeExpression(string *expression) {
+/**
+ * Apply an operator to rational operands, leaving the result in the
+ * first of them.
+ * @note Integer addition, subtraction and multiplication, which most
+ *       of the work is, are done here without a call.
+ */
+static inline bool applyRationalOperator(Operator operator,
+        Rational *operands) {
+
+    /* Addition, subtraction and multiplication come first. */
+    if (operator <= OPERATOR_MULPLICATION && operands[0].denominator == 1
+            && operands[1].denominator == 1) {
+        switch (operator) {
+        case OPERATOR_ADDITION:
+            return !__builtin_add_overflow(operands[0].numerator,
+                    operands[1].numerator, &operands[0].numerator);
+        case OPERATOR_SUBTRACTION:
+            return !__builtin_sub_overflow(operands[0].numerator,
+                    operands[1].numerator, &operands[0].numerator);
+        case OPERATOR_MULPLICATION:
+            return !__builtin_mul_overflow(operands[0].numerator,
+                    operands[1].numerator, &operands[0].numerator);
+        default:
+            break;
+        }
+    }
 
-    while (replaceExpressionRecursive(expression, "++", "+")
-            || replaceExpressionRecursive(expression, "+-", "-")
-            || replaceExpressionRecursive(expression, "-+", "-")
-            || replaceExpressionRecursive(expression, "--", "+"));
+    return Operator_evaluateRational(operator, operands, operands);
+}
 
-    replaceExpressionStart(expression, "+", "");
+static inline bool evaluateRationalOperator(Operator operator,
+        Rational *operands) {
 
-    replaceExpressionStart(expression, "-", "0-");
+    bool exact;
+    STATISTICS_DECLARE_TIME(start);
 
-    replaceExpressionRecursive(expression, "(+", "(");
+    STATISTICS_START(start);
+    exact = applyRationalOperator(operator, operands);
+    STATISTICS_ADD_OPERATOR(operator, 1, start);
 
-    replaceExpressionRecursive(expression, "(-", "(0-");
+    return exact;
 }
 
-bool readOperator(string start, Operator *operator,
-        string *operatorStart, string *operatorEnd) {
+/**
+ * Push a value onto the operand stacks of a parser that evaluates while
+ * parsing.
+ */
+static void pushValue(Parser *parser, Operand operand) {
 
-    size_t i, position, oldPosition = string_length(start);
-    bool found = false;
+    Rational rational;
 
-    for (i = 0; i < ARRAY_SIZE(OPERATOR_STRINGS); ++i) {
-        if ((position = string_indexOfIgnoreCase(start,
-                    OPERATOR_STRINGS[i])) != -1
-                && position < oldPosition) {
-            found = true;
-            oldPosition = position;
-            *operator = i;
-            *operatorStart = start + position;
-            *operatorEnd = *operatorStart
-                    + string_length(OPERATOR_STRINGS[i]);
-        }
+    OperandStack_push(parser->operandStack, operand);
+    if (parser->exact && Rational_fromOperand(operand, &rational)) {
+        RationalStack_push(parser->rationalStack, rational);
+    } else {
+        parser->exact = false;
     }
-
-    return found;
 }
 
-bool readOperand(string start, string end, Operand *operand) {
-    size_t operandLength = end - start;
-    /*
-     * @note Use a new string so that string_parseDouble will nor read
-     *       more than it should.
-     */
-    string operandString = string_subString(start, 0, operandLength);
-    Operand theOperand;
-    bool success = false;
+/**
+ * Apply an operator to the operand stacks of a parser that evaluates
+ * while parsing, like {@link evaluateCompiled} would.
+ * @note Doubles stop at the first error, which is reported only if the
+ *       rationals do not stay exact to the end.
+ */
+static void applyOperator(Parser *parser, Operator operator) {
+
+    size_t operandCount = Operator_getOperandCount(operator);
+    OperandStack *operandStack = parser->operandStack;
+    RationalStack *rationalStack = parser->rationalStack;
+    Operand *operands;
 
-    if (string_isEqualIgnoreCase(operandString, "e")) {
-        *operand = E;
-        success = true;
-    } else if (string_isEqualIgnoreCase(operandString, "pi")) {
-        *operand = PI;
-        success = true;
-    } else if (string_parseDouble(operandString, &theOperand)
-            == operandLength) {
-        *operand = theOperand;
-        success = true;
+    if (parser->evaluationResult == EVALUATION_SUCCESS) {
+        operandStack->size -= operandCount;
+        operands = operandStack->array + operandStack->size;
+        parser->evaluationResult = Operator_evaluate(operator, operands,
+                operands);
+        ++operandStack->size;
     }
 
-    Memory_free(operandString);
-    return success;
+    if (parser->exact) {
+        rationalStack->size -= operandCount;
+        parser->exact = Operator_isRational(operator)
+                && evaluateRationalOperator(operator,
+                        rationalStack->array + rationalStack->size);
+        ++rationalStack->size;
+    }
 }
 
-void pushOperator(Operator operator, LinkedStack *operatorStack) {
-    Operator *theOperator = Memory_allocateType(Operator);
-    *theOperator = operator;
-    $(operatorStack, push, theOperator);
+void emitOperand(Parser *parser, Operand operand, string text,
+        size_t length) {
+    Instruction instruction;
+    ++parser->stackDepth;
+    if (parser->program == null) {
+        pushValue(parser, operand);
+        return;
+    }
+    instruction.type = INSTRUCTION_CONSTANT;
+    instruction.argument.constant = operand;
+    CompiledExpression_addInstruction(parser->program, &instruction);
+    CompiledExpression_addLiteral(parser->program, text, length);
+    parser->program->stackDepth = MAX(parser->program->stackDepth,
+            parser->stackDepth);
 }
 
-void pushOperand(Operand operand, LinkedStack *operandStack) {
-    Operand *theOperand = Memory_allocateType(Operand);
-    *theOperand = operand;
-    $(operandStack, push, theOperand);
+void emitVariable(Parser *parser, size_t variable) {
+    Instruction instruction;
+    instruction.type = INSTRUCTION_VARIABLE;
+    instruction.argument.variable = variable;
+    CompiledExpression_addInstruction(parser->program, &instruction);
+    ++parser->stackDepth;
+    parser->program->stackDepth = MAX(parser->program->stackDepth,
+            parser->stackDepth);
 }
 
-EvaluationResult evaluteOperator(Operator operator,
-        LinkedStack *operatorStack, LinkedStack *operandStack) {
+/**
+ * Emit an operator to the program, or apply it when evaluating while
+ * parsing, checking that there will be enough operands on the stack
+ * for it.
+ */
+static EvaluationResult emitPlainOperator(Parser *parser,
+        Operator operator) {
+
+    Instruction instruction;
+    size_t operandCount = Operator_getOperandCount(operator);
+
+    if (parser->stackDepth < operandCount) {
+        return EVALUATION_ERROR_MALFORMED_EXPRESSION;
+    }
+    parser->stackDepth = parser->stackDepth - operandCount + 1;
+
+    if (parser->program == null) {
+        applyOperator(parser, operator);
+        return EVALUATION_SUCCESS;
+    }
+
+    instruction.type = INSTRUCTION_OPERATOR;
+    instruction.operator = operator;
+    CompiledExpression_addInstruction(parser->program, &instruction);
+
+    return EVALUATION_SUCCESS;
+}
+
+/**
+ * Emit a multiplication of the value on top of the stack by a factor
+ * of pi, as x * pi / divisor or x * multiplier / pi.
+ * @note The constants are emitted with their text, so that arbitrary
+ *       precision evaluation gets pi to its precision.
+ */
+static EvaluationResult emitPiScaling(Parser *parser, bool piAbove) {
+
+    EvaluationResult result;
+
+    if (piAbove) {
+        emitOperand(parser, M_PI, "pi", 2);
+    } else {
+        emitOperand(parser, 180, "180", 3);
+    }
+    result = emitPlainOperator(parser, OPERATOR_MULPLICATION);
+    if (result != EVALUATION_SUCCESS) {
+        return result;
+    }
+    if (piAbove) {
+        emitOperand(parser, 180, "180", 3);
+    } else {
+        emitOperand(parser, M_PI, "pi", 2);
+    }
+    return emitPlainOperator(parser, OPERATOR_DIVISION);
+}
+
+/**
+ * Emit an operator, converting angles to and from radians around the
+ * trigonometric functions when the parser works in degrees.
+ * @note The conversion is part of the program, so that every way of
+ *       evaluating it agrees on the unit.
+ * @see emitPlainOperator
+ */
+EvaluationResult emitOperator(Parser *parser, Operator operator) {
 
-    Operator *operator1;
-    Operand *operand1, *operand2;
     EvaluationResult result;
 
+    if (parser->angleMode != ANGLE_MODE_DEGREES) {
+        return emitPlainOperator(parser, operator);
+    }
+
     switch (operator) {
-    case OPERATOR_ADDITION:
-        operand2 = $(operandStack, pop);
-        operand1 = $(operandStack, pop);
-        if (operand1 == null || operand2 == null) {
-            return EVALUATION_ERROR_MALFORMED_EXPRESSION;
-        }
-        pushOperand(*operand1 + *operand2, operandStack);
-        Memory_free(operand1);
-        Memory_free(operand2);
-        break;
-    case OPERATOR_SUBTRACTION:
-        operand2 = $(operandStack, pop);
-        operand1 = $(operandStack, pop);
-        if (operand1 == null || operand2 == null) {
-            return EVALUATION_ERROR_MALFORMED_EXPRESSION;
-        }
-        pushOperand(*operand1 - *operand2, operandStack);
-        Memory_free(operand1);
-        Memory_free(operand2);
-        break;
-    case OPERATOR_MULPLICATION:
-        operand2 = $(operandStack, pop);
-        operand1 = $(operandStack, pop);
-        if (operand1 == null || operand2 == null) {
-            return EVALUATION_ERROR_MALFORMED_EXPRESSION;
-        }
-        pushOperand(*operand1 * *operand2, operandStack);
-        Memory_free(operand1);
-        Memory_free(operand2);
-        break;
-    case OPERATOR_DIVISION:
-        operand2 = $(operandStack, pop);
-        operand1 = $(operandStack, pop);
-        if (operand1 == null || operand2 == null) {
-            return EVALUATION_ERROR_MALFORMED_EXPRESSION;
-        }
-        pushOperand(*operand1 / *operand2, operandStack);
-        Memory_free(operand1);
-        Memory_free(operand2);
-        break;
-    case OPERATOR_POWER:
-    case OPERATOR_POW:
-        operand2 = $(operandStack, pop);
-        operand1 = $(operandStack, pop);
-        if (operand1 == null || operand2 == null) {
-            return EVALUATION_ERROR_MALFORMED_EXPRESSION;
-        }
-        pushOperand(pow(*operand1, *operand2), operandStack);
-        Memory_free(operand1);
-        Memory_free(operand2);
-        break;
-    case OPERATOR_PARENTHESIS_LEFT:
-        break;
-    case OPERATOR_FACTORIAL:
-        operand1 = $(operandStack, pop);
-        if (operand1 == null) {
-            return EVALUATION_ERROR_MALFORMED_EXPRESSION;
-        }
-        if (*operand1 < 0 || *operand1 != (unsigned int)*operand1) {
-            Memory_free(operand1);
-            return EVALUATION_ERROR_INVALID_OPERATION;
-        }
-        pushOperand(factorial((unsigned int)*operand1), operandStack);
-        Memory_free(operand1);
-        break;
     case OPERATOR_SIN:
-        operand1 = $(operandStack, pop);
-        if (operand1 == null) {
-            return EVALUATION_ERROR_MALFORMED_EXPRESSION;
-        }
-        pushOperand(sin(*operand1), operandStack);
-        Memory_free(operand1);
-        break;
     case OPERATOR_COS:
-        operand1 = $(operandStack, pop);
-        if (operand1 == null) {
-            return EVALUATION_ERROR_MALFORMED_EXPRESSION;
-        }
-        pushOperand(cos(*operand1), operandStack);
-        Memory_free(operand1);
-        break;
     case OPERATOR_TAN:
-        operand1 = $(operandStack, pop);
-        if (operand1 == null) {
-            return EVALUATION_ERROR_MALFORMED_EXPRESSION;
-        }
-        pushOperand(tan(*operand1), operandStack);
-        Memory_free(operand1);
-        break;
-    case OPERATOR_LOG:
-        operand2 = $(operandStack, pop);
-        operand1 = $(operandStack, pop);
-        if (operand1 == null || operand2 == null) {
-            return EVALUATION_ERROR_MALFORMED_EXPRESSION;
+        result = emitPiScaling(parser, true);
+        if (result != EVALUATION_SUCCESS) {
+            return result;
         }
-        if (*operand1 <= 0 || *operand1 == 1 || *operand2 <= 0) {
-            Memory_free(operand1);
-            Memory_free(operand2);
-            return EVALUATION_ERROR_INVALID_OPERATION;
+        return emitPlainOperator(parser, operator);
+    case OPERATOR_ASIN:
+    case OPERATOR_ACOS:
+    case OPERATOR_ATAN:
+    case OPERATOR_ATAN2:
+        result = emitPlainOperator(parser, operator);
+        if (result != EVALUATION_SUCCESS) {
+            return result;
         }
-        pushOperand(log(*operand2) / log(*operand1), operandStack);
-        Memory_free(operand1);
-        Memory_free(operand2);
+        return emitPiScaling(parser, false);
+    default:
+        return emitPlainOperator(parser, operator);
+    }
+}
+
+/**
+ * Reduce an operator popped from the operator stack, by emitting it
+ * to the program.
+ * @note A right parenthesis pops back to its left parenthesis or
+ *       function without recursion, so that nesting depth is bounded
+ *       only by the heap.
+ */
+EvaluationResult reduceOperator(Parser *parser, Operator operator) {
+
+    Operator operator1;
+
+    switch (operator) {
+    case OPERATOR_PARENTHESIS_LEFT:
         break;
     case OPERATOR_COMMA:
         /*
-         * Should have been handle by the evaluation of
+         * Should have been handle by the reduction of
          * OPERATOR_PARENTHESIS_RIGHT.
          */
         return EVALUATION_ERROR_COMMA_NOT_IN_FUNCTION;
-        break;
     case OPERATOR_PARENTHESIS_RIGHT:
-        while (*(operator1 = $(operatorStack, pop))
-                == OPERATOR_COMMA) {
-            Memory_free(operator1);
-        }
-        if (OPERATOR_PRECEDENCE[*operator1]
-                == OPERATOR_PRECEDENCE[OPERATOR_PARENTHESIS_LEFT]) {
-            result = evaluteOperator(*operator1, operatorStack,
-                    operandStack);
-            Memory_free(operator1);
-            if (result != EVALUATION_SUCCESS) {
-                return result;
+        do {
+            if (OperatorStack_isEmpty(parser->operatorStack)) {
+                return EVALUATION_ERROR_UNPAIRED_PARENTHESIS;
             }
+            operator1 = OperatorStack_pop(parser->operatorStack);
+        } while (operator1 == OPERATOR_COMMA);
+        if (operator1 == OPERATOR_PARENTHESIS_LEFT) {
+            break;
+        } else if (Operator_isFunction(operator1)) {
+            return emitOperator(parser, operator1);
         } else {
-            Memory_free(operator1);
             return EVALUATION_ERROR_UNPAIRED_PARENTHESIS;
         }
-        break;
     default:
-        return EVALUATION_ERROR_INTERNAL_FAILURE;
+        return emitOperator(parser, operator);
     }
 
     return EVALUATION_SUCCESS;
 }
 
-EvaluationResult processOperator(Operator operator,
-        LinkedStack *operatorStack, LinkedStack *operandStack) {
+EvaluationResult processOperator(Parser *parser, Operator operator) {
 
-    Operator *topOperator;
     EvaluationResult result;
 
-    while (_(operatorStack, size) != 0
+    while (!OperatorStack_isEmpty(parser->operatorStack)
             && Operator_comparePrecedence(
-                    *(Operator *)$(operatorStack, peek),
+                    *OperatorStack_peek(parser->operatorStack),
                     operator) >= 0) {
-        topOperator = $(operatorStack, pop);
-        result = evaluteOperator(*topOperator, operatorStack,
-                operandStack);
-        Memory_free(topOperator);
+        result = reduceOperator(parser,
+                OperatorStack_pop(parser->operatorStack));
         if (result != EVALUATION_SUCCESS) {
             return result;
         }
     }
 
-    pushOperator(operator, operatorStack);
+    OperatorStack_push(parser->operatorStack, operator);
 
     return EVALUATION_SUCCESS;
 }
 
-EvaluationResult doFinal(LinkedStack *operatorStack, LinkedStack *operandStack) {
+EvaluationResult doFinal(Parser *parser) {
 
-    Operator *operator;
     EvaluationResult result;
 
-    while (_(operatorStack, size) != 0) {
-        operator = $(operatorStack, pop);
-        result = evaluteOperator(*operator, operatorStack,
-                operandStack);
-        Memory_free(operator);
+    while (!OperatorStack_isEmpty(parser->operatorStack)) {
+        result = reduceOperator(parser,
+                OperatorStack_pop(parser->operatorStack));
         if (result != EVALUATION_SUCCESS) {
             return result;
         }
     }
 
-    if (_(operandStack, size) == 1) {
+    if (parser->stackDepth == 1) {
         return EVALUATION_SUCCESS;
     } else {
         return EVALUATION_ERROR_FINALIZATION_FAILED;
     }
 }
 
-void cleanUp(string expression, LinkedStack *operatorStack,
-        LinkedStack *operandStack) {
-    Memory_free(expression);
-    $(operatorStack, delete);
-    $(operandStack, delete);
+/**
+ * Process a sign read where an operand is expected.
+ * @note Signs at the start of a group are collected until the group
+ *       starts, elsewhere a minus sign is a prefix operator.
+ */
+void processPrefixSign(Parser *parser, Operator operator) {
+    if (operator == OPERATOR_ADDITION) {
+        return;
+    }
+    if (parser->atGroupStart) {
+        parser->negateGroup = !parser->negateGroup;
+    } else {
+        /* A prefix operator has no left operand to reduce. */
+        OperatorStack_push(parser->operatorStack, OPERATOR_NEGATIVE);
+    }
 }
 
-EvaluationResult evaluateExpression(string expression,
-        Operand *value) {
+/**
+ * Process the signs read at the start of a group, before its first
+ * operand or operator.
+ * @note A negated group is evaluated as subtracted from zero, so that
+ *       a leading minus binds as loosely as binary minus, as it always
+ *       did.
+ */
+EvaluationResult processGroupSign(Parser *parser) {
+
+    if (!parser->negateGroup) {
+        return EVALUATION_SUCCESS;
+    }
+
+    parser->negateGroup = false;
+    emitOperand(parser, 0, "0", 1);
+    return processOperator(parser, OPERATOR_SUBTRACTION);
+}
 
-    string start, end, operatorStart, operatorEnd;
-    LinkedStack *operatorStack = LinkedStack_new(),
-            *operandStack = LinkedStack_new();
+/**
+ * Parse the tokens of the lexer of a parser, leaving the parser ready
+ * for more tokens.
+ */
+static EvaluationResult parseTokens(Parser *parser) {
+
+    Lexer *lexer = &parser->lexer;
+    Token token;
+    bool isOperator;
     Operator operator;
     Operand operand;
     EvaluationResult result;
 
-    expression = string_replaceRecursive(expression, " ", "");
-    normalizeExpression(&expression);
-
-    start = expression;
-    end = expression + string_length(expression);
-
-    while (true) {
-        if (readOperator(start, &operator, &operatorStart,
-                &operatorEnd)) {
-            if (operatorStart != start) {
-                if (readOperand(start, operatorStart, &operand)) {
-                    pushOperand(operand, operandStack);
-                } else {
-                    cleanUp(expression, operatorStack, operandStack);
-                    return EVALUATION_ERROR_PARSING_FAILED;
-                }
-            }
-            start = operatorEnd;
-            result = processOperator(operator, operatorStack,
-                    operandStack);
+    while (Lexer_next(lexer, &token) != TOKEN_END) {
+
+        isOperator = readOperator(&token, lexer, &operator);
+        if (isOperator && parser->expectOperand
+                && (operator == OPERATOR_ADDITION
+                        || operator == OPERATOR_SUBTRACTION)) {
+            processPrefixSign(parser, operator);
+            continue;
+        }
+
+        result = processGroupSign(parser);
+        if (result != EVALUATION_SUCCESS) {
+            return result;
+        }
+
+        if (isOperator) {
+            result = processOperator(parser, operator);
             if (result != EVALUATION_SUCCESS) {
-                cleanUp(expression, operatorStack, operandStack);
                 return result;
             }
+            parser->expectOperand = operator != OPERATOR_FACTORIAL
+                    && operator != OPERATOR_PARENTHESIS_RIGHT;
+            parser->atGroupStart = operator == OPERATOR_PARENTHESIS_LEFT
+                    || Operator_isFunction(operator)
+                    || operator == OPERATOR_COMMA;
+            continue;
+        }
+
+        if ((token.type == TOKEN_NUMBER
+                        || token.type == TOKEN_IDENTIFIER)
+                && readOperand(Token_getText(&token, lexer),
+                        Token_getText(&token, lexer) + token.length,
+                        &operand)) {
+            emitOperand(parser, operand, Token_getText(&token, lexer),
+                    token.length);
+        } else if (token.type == TOKEN_IDENTIFIER
+                && parser->program != null) {
+            emitVariable(parser, CompiledExpression_addVariable(
+                    parser->program, Token_getText(&token, lexer),
+                    token.length));
+        } else {
+            return EVALUATION_ERROR_PARSING_FAILED;
+        }
+        parser->expectOperand = false;
+        parser->atGroupStart = false;
+    }
+
+    return EVALUATION_SUCCESS;
+}
+
+/**
+ * Finish parsing at the end of the expression.
+ */
+static EvaluationResult finishParsing(Parser *parser) {
+
+    EvaluationResult result = processGroupSign(parser);
+
+    if (result != EVALUATION_SUCCESS) {
+        return result;
+    }
+
+    return doFinal(parser);
+}
+
+static EvaluationResult parse(Parser *parser) {
+
+    EvaluationResult result;
+    STATISTICS_DECLARE_TIME(start);
+
+    STATISTICS_START(start);
+    result = parseTokens(parser);
+    if (result == EVALUATION_SUCCESS) {
+        result = finishParsing(parser);
+    }
+    STATISTICS_ADD_PHASE(STATISTICS_PHASE_PARSE, start);
+
+    return result;
+}
+
+static void initializeParser(Parser *parser, EvaluatorContext *context,
+        const char *text, size_t length, CompiledExpression *program) {
+    /* The lexer never writes to its text. */
+    Lexer_initialize(&parser->lexer, (string)text, length);
+    OperatorStack_clear(&context->operatorStack);
+    parser->operatorStack = &context->operatorStack;
+    parser->program = program;
+    parser->operandStack = null;
+    parser->rationalStack = null;
+    parser->exact = false;
+    parser->angleMode = context->angleMode;
+    parser->evaluationResult = EVALUATION_SUCCESS;
+    parser->stackDepth = 0;
+    parser->expectOperand = true;
+    parser->atGroupStart = true;
+    parser->negateGroup = false;
+}
+
+/**
+ * Initialize a parser that evaluates the expression as it is parsed,
+ * instead of compiling it into a program.
+ */
+static void initializeEvaluatingParser(Parser *parser,
+        EvaluatorContext *context, const char *text, size_t length) {
+    initializeParser(parser, context, text, length, null);
+    OperandStack_clear(&context->operandStack);
+    RationalStack_clear(&context->rationalStack);
+    parser->operandStack = &context->operandStack;
+    parser->rationalStack = &context->rationalStack;
+    parser->exact = true;
+}
+
+/**
+ * Get the value of an expression evaluated while parsing, like
+ * {@link evaluateCompiled} would give.
+ */
+static EvaluationResult getEvaluatedValue(Parser *parser,
+        Operand *value) {
+    if (parser->exact) {
+        *value = Rational_toOperand(parser->rationalStack->array);
+        return EVALUATION_SUCCESS;
+    } else if (parser->evaluationResult == EVALUATION_SUCCESS) {
+        *value = *parser->operandStack->array;
+    }
+    return parser->evaluationResult;
+}
+
+static EvaluationResult compile(EvaluatorContext *context,
+        const char *text, size_t length, CompiledExpression *program) {
+
+    Parser parser;
+
+    initializeParser(&parser, context, text, length, program);
+    return parse(&parser);
+}
+
+static EvaluationResult compileInContext(EvaluatorContext *context,
+        const char *text, size_t length, CompiledExpression **program) {
+
+    CompiledExpression *theProgram = CompiledExpression_new();
+    EvaluationResult result = compile(context, text, length, theProgram);
+
+    if (result == EVALUATION_SUCCESS) {
+        CompiledExpression_eliminateCommonSubexpressions(theProgram);
+        CompiledExpression_findChain(theProgram);
+        *program = theProgram;
+    } else {
+        CompiledExpression_delete(theProgram);
+    }
+    return result;
+}
+
+/**
+ * Compile an expression into a program that can be evaluated many
+ * times with {@link evaluateCompiled}.
+ * @note Identifiers other than functions and constants are variables,
+ *       whose slots can be queried with
+ *       {@link CompiledExpression_indexOfVariable}.
+ * @param expression The expression to compile.
+ * @param program The compiled program, to be deleted with
+ *        {@link CompiledExpression_delete}.
+ */
+EvaluationResult compileExpression(string expression,
+        CompiledExpression **program) {
+    return compileExpressionN(expression, string_length(expression),
+            program);
+}
+
+/**
+ * Compile an expression given by its text and length.
+ * @see compileExpression
+ */
+EvaluationResult compileExpressionN(const char *text, size_t length,
+        CompiledExpression **program) {
+    return compileInContext(getThreadContext(), text, length, program);
+}
+
+/**
+ * Evaluate a compiled program exactly, with rational numbers.
+ * @return Whether every value along the way was exact; if not, the
+ *         program should be evaluated with doubles, which also reports
+ *         any error.
+ */
+static bool evaluateRational(EvaluatorContext *context,
+        CompiledExpression *program, Operand *variableValues,
+        Operand *value) {
+
+    Rational stackBuffer[EVALUATION_STACK_SIZE], *stack, *top,
+            *temporaries;
+    Instruction *instruction = program->instructions,
+            *end = instruction + program->instructionCount;
+    size_t frameSize = program->stackDepth + program->temporaryCount;
+
+    if (frameSize <= EVALUATION_STACK_SIZE) {
+        stack = stackBuffer;
+    } else {
+        RationalStack_reserve(&context->rationalStack, frameSize);
+        stack = context->rationalStack.array;
+    }
+    top = stack;
+    temporaries = stack + program->stackDepth;
+
+    for (; instruction != end; ++instruction) {
+        switch (instruction->type) {
+        case INSTRUCTION_CONSTANT:
+            /* Constants of an exact program are all small integers. */
+            top->numerator = (int64_t)instruction->argument.constant;
+            top->denominator = 1;
+            ++top;
+            break;
+        case INSTRUCTION_VARIABLE:
+            if (!Rational_fromOperand(
+                    variableValues[instruction->argument.variable],
+                    top++)) {
+                return false;
+            }
+            break;
+        case INSTRUCTION_OPERATOR:
+            top -= Operator_getOperandCount(instruction->operator);
+            if (!evaluateRationalOperator(instruction->operator, top)) {
+                return false;
+            }
+            ++top;
+            break;
+        case INSTRUCTION_STORE:
+            temporaries[instruction->argument.temporary] = top[-1];
+            break;
+        case INSTRUCTION_LOAD:
+            *top++ = temporaries[instruction->argument.temporary];
+            break;
+        }
+    }
+
+    *value = Rational_toOperand(stack);
+    return true;
+}
+
+typedef struct {
+    CompiledExpression *program;
+    Operand *variableValues;
+    /* Temporaries of all the chunks, each storing its own ones. */
+    Operand *temporaries;
+    ChainChunk *chunks;
+} ChainEvaluation;
+
+/**
+ * Add to a sum while keeping its rounding error, with the Neumaier
+ * variant of Kahan summation.
+ */
+static void addCompensated(Operand *sum, Operand *compensation,
+        Operand value) {
+
+    Operand newSum = *sum + value;
+
+    if (fabs(*sum) >= fabs(value)) {
+        *compensation += (*sum - newSum) + value;
+    } else {
+        *compensation += (value - newSum) + *sum;
+    }
+    *sum = newSum;
+}
+
+/**
+ * Run a range of the instructions of a chain, folding each term into
+ * the partial result of a chunk.
+ * @note Between the terms the operand stack is empty, so the operators
+ *       of the chain itself are found there and skipped. Shared
+ *       temporaries are already computed and not stored again.
+ * @param chunk The partial result, or null for computing the shared
+ *        temporaries.
+ */
+static void evaluateChainRange(ChainEvaluation *evaluation, size_t start,
+        size_t end, ChainChunk *chunk) {
+
+    CompiledExpression *program = evaluation->program;
+    ExpressionChain *chain = program->chain;
+    EvaluatorContext *context;
+    Operand stackBuffer[EVALUATION_STACK_SIZE], *stack, *top;
+    Instruction *instruction;
+    bool isSum = chain->operator == OPERATOR_ADDITION;
+    EvaluationResult result;
+    size_t i;
+
+    if (program->stackDepth <= EVALUATION_STACK_SIZE) {
+        stack = stackBuffer;
+    } else {
+        context = getThreadContext();
+        OperandStack_reserve(&context->operandStack, program->stackDepth);
+        stack = context->operandStack.array;
+    }
+    top = stack;
+
+    for (i = start; i != end; ++i) {
+        instruction = &program->instructions[i];
+        switch (instruction->type) {
+        case INSTRUCTION_CONSTANT:
+            *top++ = instruction->argument.constant;
+            break;
+        case INSTRUCTION_VARIABLE:
+            *top++ = evaluation->variableValues[
+                    instruction->argument.variable];
+            break;
+        case INSTRUCTION_OPERATOR:
+            if (top == stack) {
+                continue;
+            }
+            top -= Operator_getOperandCount(instruction->operator);
+            result = Operator_evaluate(instruction->operator, top, top);
+            if (result != EVALUATION_SUCCESS) {
+                if (chunk != null) {
+                    chunk->result = result;
+                }
+                return;
+            }
+            ++top;
+            break;
+        case INSTRUCTION_STORE:
+            if (chunk == null
+                    || !chain->isShared[instruction->argument.temporary]) {
+                evaluation->temporaries[instruction->argument.temporary] =
+                        top[-1];
+            }
+            break;
+        case INSTRUCTION_LOAD:
+            *top++ = evaluation->temporaries[
+                    instruction->argument.temporary];
+            break;
+        }
+        if (chunk != null && ExpressionChain_isTermEnd(chain, i)) {
+            --top;
+            if (isSum) {
+                addCompensated(&chunk->value, &chunk->compensation, *top);
+            } else {
+                chunk->value *= *top;
+            }
+        }
+    }
+}
+
+static void evaluateChainChunks(void *data, size_t start, size_t end) {
+
+    ChainEvaluation *evaluation = data;
+    ExpressionChain *chain = evaluation->program->chain;
+    ChainChunk *chunk;
+
+    for (; start < end; ++start) {
+        chunk = &evaluation->chunks[start];
+        chunk->value = chain->operator == OPERATOR_ADDITION ? 0 : 1;
+        chunk->compensation = 0;
+        chunk->result = EVALUATION_SUCCESS;
+        evaluateChainRange(evaluation, chain->chunkStarts[start],
+                start + 1 < chain->chunkCount
+                        ? chain->chunkStarts[start + 1]
+                        : evaluation->program->instructionCount,
+                chunk);
+    }
+}
+
+/**
+ * Evaluate a program that is a long chain of + or * by evaluating its
+ * chunks in parallel and combining their partial results in order.
+ * @note Sums are compensated, within a chunk and across chunks. Since
+ *       chunks are fixed when the program is compiled, the result does
+ *       not depend on the number of threads, which is only fewer when
+ *       another caller is already using them.
+ * @note An error in computing a shared temporary is left to the chunk
+ *       storing it, which computes it again, so that the first error
+ *       in order is the one reported.
+ * @note The temporaries and partial results are kept in the context,
+ *       so that evaluating a program again does not allocate.
+ */
+static EvaluationResult evaluateChain(EvaluatorContext *context,
+        CompiledExpression *program, Operand *variableValues,
+        Operand *value) {
+
+    ExpressionChain *chain = program->chain;
+    ChainEvaluation evaluation = {program, variableValues, null, null};
+    Operand result, compensation = 0;
+    EvaluationResult error = EVALUATION_SUCCESS;
+    size_t i;
+
+    OperandStack_reserve(&context->chainTemporaries,
+            program->temporaryCount + 1);
+    evaluation.temporaries = context->chainTemporaries.array;
+    ChainChunkStack_reserve(&context->chainChunks, chain->chunkCount);
+    evaluation.chunks = context->chainChunks.array;
+
+    for (i = 0; i < chain->sharedRangeCount; ++i) {
+        evaluateChainRange(&evaluation, chain->sharedRanges[2 * i],
+                chain->sharedRanges[2 * i + 1], null);
+    }
+
+    if (pthread_mutex_trylock(&chainMutex) == 0) {
+        if (chainPool == null) {
+            chainPool = ThreadPool_new(0);
+        }
+        ThreadPool_run(chainPool, chainPool->threadCount,
+                chain->chunkCount, 1, evaluateChainChunks, &evaluation);
+        pthread_mutex_unlock(&chainMutex);
+    } else {
+        evaluateChainChunks(&evaluation, 0, chain->chunkCount);
+    }
+
+    result = evaluation.chunks[0].value;
+    for (i = 0; i < chain->chunkCount; ++i) {
+        if (evaluation.chunks[i].result != EVALUATION_SUCCESS) {
+            error = evaluation.chunks[i].result;
+            break;
+        }
+        if (i == 0) {
+            continue;
+        }
+        if (chain->operator == OPERATOR_ADDITION) {
+            addCompensated(&result, &compensation,
+                    evaluation.chunks[i].value);
         } else {
-            /* No more operator now. */
-            if (readOperand(start, end, &operand)) {
-                pushOperand(operand, operandStack);
-            } else if (start != end) {
-                cleanUp(expression, operatorStack, operandStack);
-                return EVALUATION_ERROR_PARSING_FAILED;
+            result *= evaluation.chunks[i].value;
+        }
+    }
+
+    if (error == EVALUATION_SUCCESS) {
+        if (chain->operator == OPERATOR_ADDITION) {
+            for (i = 0; i < chain->chunkCount; ++i) {
+                compensation += evaluation.chunks[i].compensation;
+            }
+            /* The compensation of an infinite sum is meaningless. */
+            if (isfinite(result)) {
+                result += compensation;
+            }
+        }
+        *value = result;
+    }
+
+    return error;
+}
+
+static EvaluationResult evaluateCompiledInContext(
+        EvaluatorContext *context, CompiledExpression *program,
+        Operand *variableValues, Operand *value) {
+
+    Operand stackBuffer[EVALUATION_STACK_SIZE], *stack, *top,
+            *temporaries;
+    Instruction *instruction = program->instructions,
+            *end = instruction + program->instructionCount;
+    size_t operandCount,
+            frameSize = program->stackDepth + program->temporaryCount;
+    EvaluationResult result = EVALUATION_SUCCESS;
+
+    if (!program->inexact && evaluateRational(context, program,
+            variableValues, value)) {
+        return EVALUATION_SUCCESS;
+    }
+
+    if (program->chain != null) {
+        return evaluateChain(context, program, variableValues, value);
+    }
+
+    if (frameSize <= EVALUATION_STACK_SIZE) {
+        stack = stackBuffer;
+    } else {
+        OperandStack_reserve(&context->operandStack, frameSize);
+        stack = context->operandStack.array;
+    }
+    top = stack;
+    temporaries = stack + program->stackDepth;
+
+    for (; instruction != end; ++instruction) {
+        switch (instruction->type) {
+        case INSTRUCTION_CONSTANT:
+            *top++ = instruction->argument.constant;
+            break;
+        case INSTRUCTION_VARIABLE:
+            *top++ = variableValues[instruction->argument.variable];
+            break;
+        case INSTRUCTION_OPERATOR:
+            operandCount = Operator_getOperandCount(
+                    instruction->operator);
+            top -= operandCount;
+            result = Operator_evaluate(instruction->operator, top, top);
+            ++top;
+            break;
+        case INSTRUCTION_STORE:
+            temporaries[instruction->argument.temporary] = top[-1];
+            break;
+        case INSTRUCTION_LOAD:
+            *top++ = temporaries[instruction->argument.temporary];
+            break;
+        }
+        if (result != EVALUATION_SUCCESS) {
+            break;
+        }
+    }
+
+    if (result == EVALUATION_SUCCESS) {
+        *value = *stack;
+    }
+
+    return result;
+}
+
+/**
+ * Evaluate a compiled program.
+ * @note Programs of integers and exact operators are evaluated with
+ *       overflow-checked integer and rational arithmetic first, giving
+ *       exact results; they fall back to doubles once a value is not
+ *       exact, like on overflow. Variables are only exact while their
+ *       values are integers, so x * 2^62 + 1 - x * 2^62 is 1 with x = 1
+ *       but 0 with x = 1.5. No other backend is exact.
+ * @note No parsing is done, and no memory is allocated unless the
+ *       program needs an unusually deep operand stack for the first
+ *       time.
+ * @note A program that is a long chain of + or *, like
+ *       a1 + a2 + ... + an, is evaluated in chunks on all processors,
+ *       with compensated summation. Only this function does so, so its
+ *       result can differ in the last places from that of
+ *       {@link evaluateExpression} on the same text.
+ * @param program The program returned by {@link compileExpression}.
+ * @param variableValues The values of the variables, indexed by their
+ *        slots.
+ * @param value The value of the expression.
+ */
+EvaluationResult evaluateCompiled(CompiledExpression *program,
+        Operand *variableValues, Operand *value) {
+    return EvaluatorContext_evaluateCompiled(getThreadContext(), program,
+            variableValues, value);
+}
+
+EvaluationResult evaluateExpression(string expression,
+        Operand *value) {
+    return evaluateExpressionN(expression, string_length(expression),
+            value);
+}
+
+static EvaluationResult evaluateInContext(EvaluatorContext *context,
+        const char *text, size_t length, Operand *value) {
+
+    Parser parser;
+    EvaluationResult result;
+
+    initializeEvaluatingParser(&parser, context, text, length);
+    result = parse(&parser);
+    if (result != EVALUATION_SUCCESS) {
+        return result;
+    }
+
+    return getEvaluatedValue(&parser, value);
+}
+
+/**
+ * Evaluate an expression given by its text and length.
+ * @note The text is never copied or modified and need not be
+ *       null-terminated, so that a slice of a larger buffer can be
+ *       evaluated in place.
+ * @note The expression is evaluated as it is parsed, with no program
+ *       in between and without recursion, so that memory grows with
+ *       its nesting depth rather than its length.
+ * @note The result is that of {@link evaluateCompiled}, except that a
+ *       long chain at the top level is summed or multiplied here from
+ *       left to right as it is read, while {@link evaluateCompiled}
+ *       splits it into chunks with compensated summation. The two can
+ *       then differ in the last places: 10000 terms of 0.1 give
+ *       1000.0000000001588 here and 1000 there.
+ * @param text The text of the expression.
+ * @param length The length of the text.
+ * @param value The value of the expression.
+ */
+EvaluationResult evaluateExpressionN(const char *text, size_t length,
+        Operand *value) {
+    return evaluateInContext(getThreadContext(), text, length, value);
+}
+
+/**
+ * Find where a chunk of an expression can be cut, so that no token and
+ * no function call spans the cut.
+ * @note The cut follows a character that never occurs inside a number
+ *       or a name; a sign does not, unless it may be the sign of an
+ *       exponent like in 1e-5.
+ * @return The length of the part before the cut, or 0 if there is no
+ *         such place.
+ */
+static size_t findChunkCut(const char *text, size_t length) {
+
+    size_t i;
+
+    for (i = length; i > 0; --i) {
+        switch (text[i - 1]) {
+        case '*':
+        case '/':
+        case '^':
+        case '!':
+        case '(':
+        case ')':
+        case ',':
+            return i;
+        case '+':
+        case '-':
+            if (i < 2 || (text[i - 2] != 'e' && text[i - 2] != 'E'
+                    && text[i - 2] != 'p' && text[i - 2] != 'P')) {
+                return i;
             }
             break;
+        default:
+            break;
         }
     }
 
-    result = doFinal(operatorStack, operandStack);
+    return 0;
+}
+
+static EvaluationResult evaluateStreamInContext(EvaluatorContext *context,
+        FILE *stream, Operand *value) {
+
+    size_t bufferSize, length = 0, cut;
+    string buffer;
+    Parser parser;
+    EvaluationResult result = EVALUATION_SUCCESS;
+    bool atEnd = false;
+    STATISTICS_DECLARE_TIME(start);
+
+    if (context->streamBuffer == null) {
+        context->streamBufferSize = STREAM_CHUNK_SIZE;
+        context->streamBuffer = Memory_allocate(STREAM_CHUNK_SIZE);
+    }
+    buffer = context->streamBuffer;
+    bufferSize = context->streamBufferSize;
+
+    initializeEvaluatingParser(&parser, context, buffer, 0);
+
+    while (!atEnd && result == EVALUATION_SUCCESS) {
+        length += fread(buffer + length, 1, bufferSize - length, stream);
+        atEnd = length < bufferSize;
+        if (atEnd && ferror(stream)) {
+            result = EVALUATION_ERROR_READ_FAILED;
+            break;
+        }
+        cut = atEnd ? length : findChunkCut(buffer, length);
+        if (cut == 0) {
+            if (atEnd) {
+                /* Nothing is left, as in an empty stream. */
+                break;
+            }
+            /* A single token longer than the buffer. */
+            bufferSize *= 2;
+            buffer = Memory_reallocate(buffer, bufferSize);
+            context->streamBuffer = buffer;
+            context->streamBufferSize = bufferSize;
+            continue;
+        }
+        Lexer_initialize(&parser.lexer, buffer, cut);
+        STATISTICS_START(start);
+        result = parseTokens(&parser);
+        STATISTICS_ADD_PHASE(STATISTICS_PHASE_PARSE, start);
+        memmove(buffer, buffer + cut, length - cut);
+        length -= cut;
+    }
+
+    if (result == EVALUATION_SUCCESS) {
+        STATISTICS_START(start);
+        result = finishParsing(&parser);
+        STATISTICS_ADD_PHASE(STATISTICS_PHASE_PARSE, start);
+    }
+    if (result != EVALUATION_SUCCESS) {
+        return result;
+    }
+
+    return getEvaluatedValue(&parser, value);
+}
+
+/**
+ * Evaluate an expression read from a stream until its end, such as a
+ * file too large to be held in memory.
+ * @note The stream is read in chunks of STREAM_CHUNK_SIZE, and each
+ *       chunk is evaluated as it is parsed up to the last place where
+ *       it can be cut; the rest is carried over to the next chunk. So
+ *       memory grows with the nesting depth of the expression rather
+ *       than its length. The result is the same as that of
+ *       {@link evaluateExpression} on the whole text.
+ * @param stream The stream to read, which is left at its end.
+ * @param value The value of the expression.
+ */
+EvaluationResult evaluateStream(FILE *stream, Operand *value) {
+    return evaluateStreamInContext(getThreadContext(), stream, value);
+}
+
+/**
+ * Reserve a scratch stack of the calling thread for an evaluator other
+ * than {@link evaluateCompiled}.
+ * @note The stack is kept in the context of the thread, so that it
+ *       stops allocating once it has grown large enough, and is freed
+ *       when the thread exits.
+ * @return The memory of the stack, with room for at least size
+ *         operands.
+ */
+Operand *reserveScratchStack(ScratchStack stack, size_t size) {
+
+    OperandStack *scratchStack =
+            &getThreadContext()->scratchStacks[stack];
+
+    OperandStack_reserve(scratchStack, size);
+    return scratchStack->array;
+}
+
+
+/**
+ * Create an {@link EvaluatorContext}, which owns the scratch memory and
+ * the settings of evaluation.
+ * @note A context must not be used by more than one thread at a time,
+ *       but contexts share no mutable state, so that each thread can
+ *       evaluate with its own one. The functions that take no context
+ *       use one of the calling thread, in radians.
+ */
+EvaluatorContext *EvaluatorContext_new() {
+
+    EvaluatorContext *context = Memory_allocateType(EvaluatorContext);
+
+    context->angleMode = ANGLE_MODE_RADIANS;
+    context->digits = DEFAULT_BIG_DIGITS;
+
+    return context;
+}
+
+/**
+ * Delete an {@link EvaluatorContext}.
+ * @note Its cache is not deleted, since it is not owned by it.
+ */
+void EvaluatorContext_delete(EvaluatorContext *context) {
+    finalizeContext(context);
+    Memory_free(context);
+}
+
+/**
+ * Set the unit of the operands of sin, cos and tan and of the results
+ * of asin, acos, atan and atan2.
+ * @note The unit is fixed into a program when it is compiled.
+ * @note The cache of the context is cleared if the unit changes, since
+ *       its results are in the old one.
+ */
+void EvaluatorContext_setAngleMode(EvaluatorContext *context,
+        AngleMode angleMode) {
+    if (angleMode != context->angleMode && context->cache != null) {
+        ExpressionCache_clear(context->cache);
+    }
+    context->angleMode = angleMode;
+}
+
+/**
+ * Set the number of significant decimal digits of
+ * {@link EvaluatorContext_evaluateBig}.
+ */
+void EvaluatorContext_setDigits(EvaluatorContext *context,
+        size_t digits) {
+    context->digits = digits;
+}
+
+/**
+ * Set the cache of {@link EvaluatorContext_evaluate}, or null for none.
+ * @note The cache is keyed by text only, so it must not be shared with
+ *       a context of another angle mode, nor with another thread. It is
+ *       cleared when {@link EvaluatorContext_setAngleMode} changes the
+ *       angle mode of this context.
+ */
+void EvaluatorContext_setCache(EvaluatorContext *context,
+        ExpressionCache *cache) {
+    context->cache = cache;
+}
+
+/**
+ * Evaluate an expression in a context, through its cache if it has
+ * one.
+ * @see evaluateExpressionN
+ */
+EvaluationResult EvaluatorContext_evaluate(EvaluatorContext *context,
+        const char *text, size_t length, Operand *value) {
+
+    EvaluationResult result;
+    Operand theValue = 0;
+
+    if (context->cache == null) {
+        return evaluateInContext(context, text, length, value);
+    }
+
+    if (!ExpressionCache_get(context->cache, text, length, &result,
+            &theValue)) {
+        result = evaluateInContext(context, text, length, &theValue);
+        ExpressionCache_put(context->cache, text, length, result,
+                theValue);
+    }
     if (result == EVALUATION_SUCCESS) {
-        *value = *(Operand *)$(operandStack, peek);
+        *value = theValue;
+    }
+    return result;
+}
+
+/**
+ * Evaluate an expression read from a stream in a context.
+ * @note The chunks are read into a buffer of the context, which is
+ *       reused by later calls.
+ * @see evaluateStream
+ */
+EvaluationResult EvaluatorContext_evaluateStream(EvaluatorContext *context,
+        FILE *stream, Operand *value) {
+    return evaluateStreamInContext(context, stream, value);
+}
+
+/**
+ * Compile an expression in a context, with its angle mode.
+ * @see compileExpressionN
+ */
+EvaluationResult EvaluatorContext_compile(EvaluatorContext *context,
+        const char *text, size_t length, CompiledExpression **program) {
+    return compileInContext(context, text, length, program);
+}
+
+/**
+ * Evaluate a compiled program in a context.
+ * @see evaluateCompiled
+ */
+EvaluationResult EvaluatorContext_evaluateCompiled(
+        EvaluatorContext *context, CompiledExpression *program,
+        Operand *variableValues, Operand *value) {
+
+    EvaluationResult result;
+    STATISTICS_DECLARE_TIME(start);
+
+    STATISTICS_START(start);
+    result = evaluateCompiledInContext(context, program, variableValues,
+            value);
+    STATISTICS_ADD_PHASE(STATISTICS_PHASE_EVALUATE, start);
+
+    return result;
+}
+
+/**
+ * Evaluate an expression in a context with arbitrary precision, to
+ * its number of digits.
+ * @see evaluateExpressionBig
+ */
+EvaluationResult EvaluatorContext_evaluateBig(EvaluatorContext *context,
+        const char *text, size_t length, BigFloat *value) {
+
+    CompiledExpression *program;
+    EvaluationResult result = compileInContext(context, text, length,
+            &program);
+
+    if (result != EVALUATION_SUCCESS) {
+        return result;
+    }
+
+    /* A standalone expression has no variables to bind. */
+    if (CompiledExpression_getVariableCount(program) != 0) {
+        result = EVALUATION_ERROR_PARSING_FAILED;
+    } else {
+        result = evaluateCompiledBig(program, null, context->digits,
+                value);
     }
 
-    cleanUp(expression, operatorStack, operandStack);
+    CompiledExpression_delete(program);
     return result;
 }
@@ -27,6 +27,7 @@
 
 
 #include "zhclib/Common.h"
+#include "zhclib/BigFloat.h"
 
 
 typedef enum {
@@ -37,14 +38,125 @@ typedef enum {
     EVALUATION_ERROR_PARSING_FAILED,
     EVALUATION_ERROR_FINALIZATION_FAILED,
     EVALUATION_ERROR_INVALID_OPERATION,
-    EVALUATION_ERROR_INTERNAL_FAILURE
+    EVALUATION_ERROR_INTERNAL_FAILURE,
+    EVALUATION_ERROR_CIRCULAR_REFERENCE,
+    EVALUATION_ERROR_READ_FAILED,
+    EVALUATION_ERROR_MALFORMED_DEFINITION,
+    EVALUATION_ERROR_DUPLICATE_DEFINITION
 } EvaluationResult;
 
+typedef enum {
+    ANGLE_MODE_RADIANS,
+    ANGLE_MODE_DEGREES
+} AngleMode;
+
 typedef double Operand;
 
+typedef struct tagCompiledExpression CompiledExpression;
+
+typedef struct tagNativeExpression NativeExpression;
+
+typedef Operand (*NativeFunction)(const Operand *variableValues);
+
+typedef Operand (*UserFunction)(const Operand *operands);
+
+typedef struct tagEvaluatorContext EvaluatorContext;
+
+typedef struct tagExpressionCache ExpressionCache;
+
+
+bool registerFunction(string name, size_t operandCount,
+        UserFunction function);
 
 EvaluationResult evaluateExpression(string expression,
         Operand *value);
 
+EvaluationResult evaluateExpressionN(const char *text, size_t length,
+        Operand *value);
+
+EvaluationResult evaluateStream(FILE *stream, Operand *value);
+
+EvaluationResult compileExpression(string expression,
+        CompiledExpression **program);
+
+EvaluationResult compileExpressionN(const char *text, size_t length,
+        CompiledExpression **program);
+
+EvaluationResult evaluateCompiled(CompiledExpression *program,
+        Operand *variableValues, Operand *value);
+
+EvaluationResult compileNative(CompiledExpression *program,
+        NativeExpression **native);
+
+void NativeExpression_delete(NativeExpression *native);
+
+NativeFunction NativeExpression_getFunction(NativeExpression *native);
+
+Operand NativeExpression_evaluate(NativeExpression *native,
+        const Operand *variableValues);
+
+EvaluationResult evaluateGradient(CompiledExpression *program,
+        Operand *variableValues, Operand *value, Operand *gradient);
+
+EvaluationResult evaluateDirectionalDerivative(
+        CompiledExpression *program, Operand *variableValues,
+        const Operand *direction, Operand *value, Operand *derivative);
+
+size_t evaluateColumns(CompiledExpression *program,
+        Operand **variableColumns, size_t count, Operand *values,
+        EvaluationResult *results);
+
+EvaluationResult evaluateExpressionBig(string expression, size_t digits,
+        BigFloat *value);
+
+EvaluationResult evaluateCompiledBig(CompiledExpression *program,
+        BigFloat *variableValues, size_t digits, BigFloat *value);
+
+void evaluateBatch(const string *expressions, size_t count,
+        Operand *values, EvaluationResult *results, int threads);
+
+void CompiledExpression_delete(CompiledExpression *program);
+
+size_t CompiledExpression_getVariableCount(
+        CompiledExpression *program);
+
+string CompiledExpression_getVariableName(CompiledExpression *program,
+        size_t index);
+
+size_t CompiledExpression_indexOfVariable(CompiledExpression *program,
+        string name);
+
+size_t CompiledExpression_getEliminatedOperatorCount(
+        CompiledExpression *program);
+
+EvaluatorContext *EvaluatorContext_new();
+
+void EvaluatorContext_delete(EvaluatorContext *context);
+
+void EvaluatorContext_setAngleMode(EvaluatorContext *context,
+        AngleMode angleMode);
+
+void EvaluatorContext_setDigits(EvaluatorContext *context,
+        size_t digits);
+
+void EvaluatorContext_setCache(EvaluatorContext *context,
+        ExpressionCache *cache);
+
+EvaluationResult EvaluatorContext_evaluate(EvaluatorContext *context,
+        const char *text, size_t length, Operand *value);
+
+EvaluationResult EvaluatorContext_evaluateStream(EvaluatorContext *context,
+        FILE *stream, Operand *value);
+
+EvaluationResult EvaluatorContext_compile(EvaluatorContext *context,
+        const char *text, size_t length, CompiledExpression **program);
+
+EvaluationResult EvaluatorContext_evaluateCompiled(
+        EvaluatorContext *context, CompiledExpression *program,
+        Operand *variableValues, Operand *value);
+
+EvaluationResult EvaluatorContext_evaluateBig(EvaluatorContext *context,
+        const char *text, size_t length, BigFloat *value);
+
 
 #endif /* _EVALUATOR_H_ */
@@ -0,0 +1,292 @@
+/**
+ * @file ExpressionCache.c
+ * @author: Zhang Hai
+ */
+
+/*
+ * Copyright (C) 2014 Zhang Hai
+ *
+ * This file is part of calc.
+ *
+ * calc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * calc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with calc.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ExpressionCache.h"
+
+#include <string.h>
+
+
+static const size_t INITIAL_BUCKET_COUNT = 16;
+
+
+typedef struct tagExpressionCacheEntry {
+    ExpressionCacheEntry *nextInBucket;
+    /* Neighbors in the recently used list. */
+    ExpressionCacheEntry *previous;
+    ExpressionCacheEntry *next;
+    size_t hash;
+    size_t length;
+    Operand value;
+    EvaluationResult result;
+    char text[];
+} ExpressionCacheEntry;
+
+
+static size_t ExpressionCacheEntry_getByteCount(size_t length) {
+    return sizeof(ExpressionCacheEntry) + length;
+}
+
+static ExpressionCacheEntry **ExpressionCache_findBucket(
+        ExpressionCache *cache, size_t hash) {
+    /* Bucket count is always a power of two. */
+    return &cache->buckets[hash & (cache->bucketCount - 1)];
+}
+
+static void ExpressionCache_unlink(ExpressionCache *cache,
+        ExpressionCacheEntry *entry) {
+    if (entry->previous == null) {
+        cache->head = entry->next;
+    } else {
+        entry->previous->next = entry->next;
+    }
+    if (entry->next == null) {
+        cache->tail = entry->previous;
+    } else {
+        entry->next->previous = entry->previous;
+    }
+}
+
+static void ExpressionCache_linkHead(ExpressionCache *cache,
+        ExpressionCacheEntry *entry) {
+    entry->previous = null;
+    entry->next = cache->head;
+    if (cache->head == null) {
+        cache->tail = entry;
+    } else {
+        cache->head->previous = entry;
+    }
+    cache->head = entry;
+}
+
+static void ExpressionCache_remove(ExpressionCache *cache,
+        ExpressionCacheEntry *entry) {
+
+    ExpressionCacheEntry **link = ExpressionCache_findBucket(cache,
+            entry->hash);
+
+    while (*link != entry) {
+        link = &(*link)->nextInBucket;
+    }
+    *link = entry->nextInBucket;
+
+    ExpressionCache_unlink(cache, entry);
+    --cache->entryCount;
+    cache->byteCount -= ExpressionCacheEntry_getByteCount(
+            entry->length);
+    Memory_free(entry);
+}
+
+static void ExpressionCache_rehash(ExpressionCache *cache,
+        size_t bucketCount) {
+
+    ExpressionCacheEntry *entry, **bucket;
+
+    Memory_free(cache->buckets);
+    cache->buckets = Memory_allocate(
+            bucketCount * sizeof(ExpressionCacheEntry *));
+    cache->bucketCount = bucketCount;
+
+    for (entry = cache->head; entry != null; entry = entry->next) {
+        bucket = ExpressionCache_findBucket(cache, entry->hash);
+        entry->nextInBucket = *bucket;
+        *bucket = entry;
+    }
+}
+
+static ExpressionCacheEntry *ExpressionCache_find(
+        ExpressionCache *cache, const char *text, size_t length,
+        size_t hash) {
+
+    ExpressionCacheEntry *entry = *ExpressionCache_findBucket(cache,
+            hash);
+
+    for (; entry != null; entry = entry->nextInBucket) {
+        if (entry->hash == hash && entry->length == length
+                && memcmp(entry->text, text, length) == 0) {
+            return entry;
+        }
+    }
+    return null;
+}
+
+static void ExpressionCache_add(ExpressionCache *cache,
+        const char *text, size_t length, size_t hash, Operand value,
+        EvaluationResult result) {
+
+    size_t byteCount = ExpressionCacheEntry_getByteCount(length);
+    ExpressionCacheEntry *entry, **bucket;
+
+    if (byteCount > cache->maximumByteCount
+            || cache->maximumEntryCount == 0) {
+        return;
+    }
+
+    while (cache->entryCount == cache->maximumEntryCount
+            || cache->byteCount + byteCount > cache->maximumByteCount) {
+        ExpressionCache_remove(cache, cache->tail);
+        ++cache->evictionCount;
+    }
+
+    if (cache->entryCount == cache->bucketCount) {
+        ExpressionCache_rehash(cache, 2 * cache->bucketCount);
+    }
+
+    entry = Memory_allocate(byteCount);
+    entry->hash = hash;
+    entry->length = length;
+    entry->value = value;
+    entry->result = result;
+    memcpy(entry->text, text, length);
+
+    bucket = ExpressionCache_findBucket(cache, hash);
+    entry->nextInBucket = *bucket;
+    *bucket = entry;
+    ExpressionCache_linkHead(cache, entry);
+    ++cache->entryCount;
+    cache->byteCount += byteCount;
+}
+
+/**
+ * Create an {@link ExpressionCache}.
+ * @param maximumEntryCount The maximum number of expressions to keep.
+ * @param maximumByteCount The maximum number of bytes to use for the
+ *        entries, including the text of the expressions.
+ */
+ExpressionCache *ExpressionCache_new(size_t maximumEntryCount,
+        size_t maximumByteCount) {
+
+    ExpressionCache *cache = Memory_allocateType(ExpressionCache);
+
+    cache->maximumEntryCount = maximumEntryCount;
+    cache->maximumByteCount = maximumByteCount;
+    ExpressionCache_rehash(cache, INITIAL_BUCKET_COUNT);
+
+    return cache;
+}
+
+void ExpressionCache_delete(ExpressionCache *cache) {
+
+    ExpressionCache_clear(cache);
+    Memory_free(cache->buckets);
+
+    Memory_free(cache);
+}
+
+/**
+ * Remove all the entries of an {@link ExpressionCache}.
+ * @note The counters are kept.
+ */
+void ExpressionCache_clear(ExpressionCache *cache) {
+
+    ExpressionCacheEntry *entry = cache->head, *next;
+
+    for (; entry != null; entry = next) {
+        next = entry->next;
+        Memory_free(entry);
+    }
+    cache->head = null;
+    cache->tail = null;
+    cache->entryCount = 0;
+    cache->byteCount = 0;
+
+    memset(cache->buckets, 0,
+            cache->bucketCount * sizeof(ExpressionCacheEntry *));
+}
+
+/**
+ * Get the result of an expression from an {@link ExpressionCache},
+ * marking it as recently used.
+ * @param result The result of evaluating the expression.
+ * @param value The value of the expression, if it was successful.
+ * @return Whether the expression was in the cache.
+ */
+bool ExpressionCache_get(ExpressionCache *cache, const char *text,
+        size_t length, EvaluationResult *result, Operand *value) {
+
+    ExpressionCacheEntry *entry = ExpressionCache_find(cache, text,
+            length, string_hashWithLength((string)text, length));
+
+    if (entry == null) {
+        ++cache->missCount;
+        return false;
+    }
+
+    ++cache->hitCount;
+    if (entry != cache->head) {
+        ExpressionCache_unlink(cache, entry);
+        ExpressionCache_linkHead(cache, entry);
+    }
+    *result = entry->result;
+    if (entry->result == EVALUATION_SUCCESS) {
+        *value = entry->value;
+    }
+    return true;
+}
+
+/**
+ * Put the result of an expression missing from an
+ * {@link ExpressionCache} into it.
+ * @see ExpressionCache_get
+ */
+void ExpressionCache_put(ExpressionCache *cache, const char *text,
+        size_t length, EvaluationResult result, Operand value) {
+    ExpressionCache_add(cache, text, length,
+            string_hashWithLength((string)text, length), value, result);
+}
+
+/**
+ * Evaluate an expression through an {@link ExpressionCache}.
+ * @note Failed evaluations are cached as well, so that a repeated
+ *       malformed expression is not parsed again.
+ * @see evaluateExpressionN
+ */
+EvaluationResult ExpressionCache_evaluate(ExpressionCache *cache,
+        const char *text, size_t length, Operand *value) {
+
+    size_t hash = string_hashWithLength((string)text, length);
+    ExpressionCacheEntry *entry = ExpressionCache_find(cache, text,
+            length, hash);
+    Operand theValue = 0;
+    EvaluationResult result;
+
+    if (entry != null) {
+        ++cache->hitCount;
+        if (entry != cache->head) {
+            ExpressionCache_unlink(cache, entry);
+            ExpressionCache_linkHead(cache, entry);
+        }
+        if (entry->result == EVALUATION_SUCCESS) {
+            *value = entry->value;
+        }
+        return entry->result;
+    }
+
+    ++cache->missCount;
+    result = evaluateExpressionN(text, length, &theValue);
+    ExpressionCache_add(cache, text, length, hash, theValue, result);
+    if (result == EVALUATION_SUCCESS) {
+        *value = theValue;
+    }
+    return result;
+}
@@ -0,0 +1,73 @@
+/**
+ * @file ExpressionCache.h
+ * @author: Zhang Hai
+ */
+
+/*
+ * Copyright (C) 2014 Zhang Hai
+ *
+ * This file is part of calc.
+ *
+ * calc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * calc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with calc.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _EXPRESSION_CACHE_H_
+#define _EXPRESSION_CACHE_H_
+
+
+#include "zhclib/Common.h"
+
+#include "Evaluator.h"
+
+
+typedef struct tagExpressionCacheEntry ExpressionCacheEntry;
+
+/**
+ * A bounded least-recently-used cache of evaluation results, keyed by
+ * the text of the expression.
+ */
+typedef struct tagExpressionCache {
+    ExpressionCacheEntry **buckets;
+    size_t bucketCount;
+    /* Most and least recently used entries. */
+    ExpressionCacheEntry *head;
+    ExpressionCacheEntry *tail;
+    size_t entryCount;
+    size_t byteCount;
+    size_t maximumEntryCount;
+    size_t maximumByteCount;
+    size_t hitCount;
+    size_t missCount;
+    size_t evictionCount;
+} ExpressionCache;
+
+
+ExpressionCache *ExpressionCache_new(size_t maximumEntryCount,
+        size_t maximumByteCount);
+
+void ExpressionCache_delete(ExpressionCache *cache);
+
+bool ExpressionCache_get(ExpressionCache *cache, const char *text,
+        size_t length, EvaluationResult *result, Operand *value);
+
+void ExpressionCache_put(ExpressionCache *cache, const char *text,
+        size_t length, EvaluationResult result, Operand value);
+
+EvaluationResult ExpressionCache_evaluate(ExpressionCache *cache,
+        const char *text, size_t length, Operand *value);
+
+void ExpressionCache_clear(ExpressionCache *cache);
+
+
+#endif /* _EXPRESSION_CACHE_H_ */
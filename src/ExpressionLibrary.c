@@ -0,0 +1,860 @@
+/**
+ * @file ExpressionLibrary.c
+ * @author: Zhang Hai
+ */
+
+/*
+ * Copyright (C) 2014 Zhang Hai
+ *
+ * This file is part of calc.
+ *
+ * calc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * calc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with calc.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ExpressionLibrary.h"
+
+#include <fcntl.h>
+#include <sched.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "FunctionRegistry.h"
+#include "Operator.h"
+
+
+/*
+ * A library file is a header, a record for each expression, the indices
+ * of the expressions sorted by name, the names of the registered
+ * functions used, and the arrays of the programs, each aligned to 8
+ * bytes, followed by a section of null-terminated strings ending with a
+ * null byte. Offsets are from the start of the file, except those of
+ * strings, which are from the start of their section, so that the file
+ * can be mapped anywhere. Values are in the byte order and sizes of the
+ * machine writing it, which the header records so that a file from
+ * another kind of machine is rejected instead of misread.
+ */
+
+static const char MAGIC[8] = "CALCLIB";
+
+static const uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+static const size_t INITIAL_BUFFER_SIZE = 4096;
+
+/* States of a program of a library, which is set up when first used. */
+enum {
+    PROGRAM_UNLOADED,
+    PROGRAM_LOADING,
+    PROGRAM_LOADED,
+    PROGRAM_INVALID
+};
+
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;
+    uint32_t wordSize;
+    uint32_t boolSize;
+    uint32_t instructionSize;
+    uint32_t operatorCount;
+    uint64_t expressionCount;
+    uint64_t records;
+    uint64_t sortedIndices;
+    uint64_t functionCount;
+    uint64_t functions;
+    /* Variable names and literals of all the programs. */
+    uint64_t stringCount;
+    uint64_t chainCount;
+    uint64_t strings;
+    uint64_t size;
+    /* Checksum of everything after the header. */
+    uint64_t checksum;
+} LibraryHeader;
+
+struct tagLibraryRecord {
+    uint64_t name;
+    /* Index of the first variable name of the program among those of
+     * all the programs, followed by its literals. */
+    uint64_t stringIndex;
+    /* Index of the chain among those of all the programs. */
+    uint64_t chainIndex;
+    uint64_t instructions;
+    uint64_t instructionCount;
+    uint64_t variableNames;
+    uint64_t variableCount;
+    uint64_t literals;
+    uint64_t literalCount;
+    uint64_t stackDepth;
+    uint64_t temporaryCount;
+    uint64_t eliminatedOperatorCount;
+    uint64_t inexact;
+    /* Offset of the chain, or 0 for none. */
+    uint64_t chain;
+};
+
+typedef struct {
+    uint64_t operator;
+    uint64_t termEnds;
+    uint64_t chunkStarts;
+    uint64_t chunkCount;
+    uint64_t sharedRanges;
+    uint64_t sharedRangeCount;
+    uint64_t isShared;
+} LibraryChain;
+
+/**
+ * A growing buffer of bytes, where a library is laid out before it is
+ * written.
+ */
+typedef struct {
+    unsigned char *data;
+    size_t size;
+    size_t capacity;
+} LibraryBuffer;
+
+typedef struct {
+    string name;
+    uint64_t index;
+} LibraryName;
+
+
+/**
+ * Reserve zeroed room at the end of a buffer.
+ * @param alignment The alignment of the room, a power of two.
+ * @return The offset of the room.
+ */
+static uint64_t LibraryBuffer_reserve(LibraryBuffer *buffer,
+        size_t size, size_t alignment) {
+
+    size_t offset = (buffer->size + alignment - 1) / alignment
+            * alignment;
+
+    if (offset + size > buffer->capacity) {
+        buffer->capacity = MAX(MAX(INITIAL_BUFFER_SIZE,
+                2 * buffer->capacity), offset + size);
+        buffer->data = Memory_reallocate(buffer->data, buffer->capacity);
+    }
+    memset(buffer->data + buffer->size, 0, offset + size - buffer->size);
+    buffer->size = offset + size;
+
+    return offset;
+}
+
+static uint64_t LibraryBuffer_append(LibraryBuffer *buffer,
+        const void *data, size_t size, size_t alignment) {
+
+    uint64_t offset = LibraryBuffer_reserve(buffer, size, alignment);
+
+    if (size != 0) {
+        memcpy(buffer->data + offset, data, size);
+    }
+    return offset;
+}
+
+/**
+ * Append the instructions of a program, leaving the operator of those
+ * not applying one as zero, so that the same programs always give the
+ * same file.
+ */
+static uint64_t ExpressionLibrary_appendInstructions(
+        LibraryBuffer *buffer, CompiledExpression *program) {
+
+    uint64_t offset = LibraryBuffer_reserve(buffer,
+            program->instructionCount * sizeof(Instruction), 8);
+    Instruction *instructions = (Instruction *)(buffer->data + offset);
+    size_t i;
+
+    for (i = 0; i < program->instructionCount; ++i) {
+        instructions[i].type = program->instructions[i].type;
+        if (instructions[i].type == INSTRUCTION_OPERATOR) {
+            instructions[i].operator = program->instructions[i].operator;
+        }
+        instructions[i].argument = program->instructions[i].argument;
+    }
+    return offset;
+}
+
+/**
+ * Append a string to the string section.
+ * @return The offset of the string in the section.
+ */
+static uint64_t LibraryBuffer_appendString(LibraryBuffer *strings,
+        string theString) {
+    return LibraryBuffer_append(strings, theString,
+            string_length(theString) + 1, 1);
+}
+
+static uint64_t ExpressionLibrary_appendStrings(LibraryBuffer *buffer,
+        LibraryBuffer *strings, string *array, size_t count) {
+
+    uint64_t offset = LibraryBuffer_reserve(buffer,
+            count * sizeof(uint64_t), 8), stringOffset;
+    size_t i;
+
+    for (i = 0; i < count; ++i) {
+        stringOffset = LibraryBuffer_appendString(strings, array[i]);
+        memcpy(buffer->data + offset + i * sizeof(uint64_t),
+                &stringOffset, sizeof(uint64_t));
+    }
+    return offset;
+}
+
+static uint64_t ExpressionLibrary_appendChain(LibraryBuffer *buffer,
+        CompiledExpression *program) {
+
+    ExpressionChain *chain = program->chain;
+    LibraryChain record;
+
+    record.operator = chain->operator;
+    record.termEnds = LibraryBuffer_append(buffer, chain->termEnds,
+            (program->instructionCount + 7) / 8, 8);
+    record.chunkStarts = LibraryBuffer_append(buffer, chain->chunkStarts,
+            chain->chunkCount * sizeof(size_t), 8);
+    record.chunkCount = chain->chunkCount;
+    record.sharedRanges = LibraryBuffer_append(buffer,
+            chain->sharedRanges,
+            2 * chain->sharedRangeCount * sizeof(size_t), 8);
+    record.sharedRangeCount = chain->sharedRangeCount;
+    record.isShared = LibraryBuffer_append(buffer, chain->isShared,
+            (program->temporaryCount + 1) * sizeof(bool), 8);
+
+    return LibraryBuffer_append(buffer, &record, sizeof(record), 8);
+}
+
+static int LibraryName_compare(const void *name1, const void *name2) {
+    return strcmp(((const LibraryName *)name1)->name,
+            ((const LibraryName *)name2)->name);
+}
+
+static const uint64_t CHECKSUM_PRIME1 = 0x9E3779B185EBCA87ULL;
+
+static const uint64_t CHECKSUM_PRIME2 = 0xC2B2AE3D27D4EB4FULL;
+
+static inline void ExpressionLibrary_mixWords(uint64_t *lanes,
+        const uint64_t *words) {
+
+    uint64_t word;
+    size_t i;
+
+    for (i = 0; i < 4; ++i) {
+        word = lanes[i] + words[i] * CHECKSUM_PRIME2;
+        lanes[i] = ((word << 31) | (word >> 33)) * CHECKSUM_PRIME1;
+    }
+}
+
+/**
+ * Compute a checksum of a range of bytes, four words at a time in
+ * independent lanes so that it runs near memory speed.
+ * @note The range is a whole number of words.
+ */
+static uint64_t ExpressionLibrary_checksum(const unsigned char *data,
+        size_t size) {
+
+    uint64_t lanes[4] = {CHECKSUM_PRIME1, CHECKSUM_PRIME2, 0,
+            -CHECKSUM_PRIME1}, words[4], checksum = size;
+    size_t wordCount = size / sizeof(uint64_t), i;
+
+    for (i = 0; i + 4 <= wordCount; i += 4) {
+        memcpy(words, data + i * sizeof(uint64_t), sizeof(words));
+        ExpressionLibrary_mixWords(lanes, words);
+    }
+    /* The last words are padded with zeros. */
+    if (i < wordCount) {
+        memset(words, 0, sizeof(words));
+        memcpy(words, data + i * sizeof(uint64_t),
+                (wordCount - i) * sizeof(uint64_t));
+        ExpressionLibrary_mixWords(lanes, words);
+    }
+
+    for (i = 0; i < 4; ++i) {
+        checksum = (checksum ^ lanes[i]) * CHECKSUM_PRIME1
+                + CHECKSUM_PRIME2;
+        checksum ^= checksum >> 29;
+    }
+    return checksum;
+}
+
+/**
+ * Write compiled expressions with their names to a library file, to be
+ * mapped later with {@link ExpressionLibrary_open}.
+ * @note Registered functions are written by name; the reader must have
+ *       registered the same functions in the same order.
+ * @param names The name of each expression.
+ * @param programs The programs returned by {@link compileExpression}.
+ * @param count The number of expressions.
+ * @param file The file to write to, which should be opened in binary
+ *        mode.
+ * @return Whether the library was written.
+ */
+bool ExpressionLibrary_serialize(string *names,
+        CompiledExpression **programs, size_t count, FILE *file) {
+
+    LibraryBuffer buffer = {null, 0, 0}, strings = {null, 0, 0};
+    LibraryHeader header;
+    LibraryRecord record;
+    LibraryName *sortedNames;
+    CompiledExpression *program;
+    Operator operator, lastOperator = OPERATOR_FIRST_USER_FUNCTION;
+    uint64_t stringOffset;
+    size_t i, j;
+    bool success;
+
+    memset(&header, 0, sizeof(header));
+    LibraryBuffer_reserve(&buffer, sizeof(header), 8);
+    header.expressionCount = count;
+    header.records = LibraryBuffer_reserve(&buffer,
+            count * sizeof(LibraryRecord), 8);
+
+    for (i = 0; i < count; ++i) {
+        program = programs[i];
+        memset(&record, 0, sizeof(record));
+        record.name = LibraryBuffer_appendString(&strings, names[i]);
+        record.stringIndex = header.stringCount;
+        header.stringCount += program->variableCount
+                + program->literalCount;
+        record.instructions = ExpressionLibrary_appendInstructions(
+                &buffer, program);
+        record.instructionCount = program->instructionCount;
+        record.variableNames = ExpressionLibrary_appendStrings(&buffer,
+                &strings, program->variableNames, program->variableCount);
+        record.variableCount = program->variableCount;
+        record.literals = ExpressionLibrary_appendStrings(&buffer,
+                &strings, program->literals, program->literalCount);
+        record.literalCount = program->literalCount;
+        record.stackDepth = program->stackDepth;
+        record.temporaryCount = program->temporaryCount;
+        record.eliminatedOperatorCount =
+                program->eliminatedOperatorCount;
+        record.inexact = program->inexact;
+        if (program->chain != null) {
+            record.chainIndex = header.chainCount++;
+            record.chain = ExpressionLibrary_appendChain(&buffer,
+                    program);
+        }
+        memcpy(buffer.data + header.records + i * sizeof(record),
+                &record, sizeof(record));
+
+        for (j = 0; j < program->instructionCount; ++j) {
+            operator = program->instructions[j].operator;
+            if (program->instructions[j].type == INSTRUCTION_OPERATOR
+                    && operator >= lastOperator) {
+                lastOperator = operator + 1;
+            }
+        }
+    }
+
+    sortedNames = Memory_allocate(MAX(count, 1) * sizeof(LibraryName));
+    for (i = 0; i < count; ++i) {
+        sortedNames[i].name = names[i];
+        sortedNames[i].index = i;
+    }
+    qsort(sortedNames, count, sizeof(LibraryName), LibraryName_compare);
+    header.sortedIndices = LibraryBuffer_reserve(&buffer,
+            count * sizeof(uint64_t), 8);
+    for (i = 0; i < count; ++i) {
+        memcpy(buffer.data + header.sortedIndices + i * sizeof(uint64_t),
+                &sortedNames[i].index, sizeof(uint64_t));
+    }
+    Memory_free(sortedNames);
+
+    header.functionCount = lastOperator - OPERATOR_FIRST_USER_FUNCTION;
+    header.functions = LibraryBuffer_reserve(&buffer,
+            header.functionCount * sizeof(uint64_t), 8);
+    for (i = 0; i < header.functionCount; ++i) {
+        stringOffset = LibraryBuffer_appendString(&strings,
+                FunctionRegistry_getName(OPERATOR_FIRST_USER_FUNCTION + i));
+        memcpy(buffer.data + header.functions + i * sizeof(uint64_t),
+                &stringOffset, sizeof(uint64_t));
+    }
+
+    /* The final null byte ends any string, even in a corrupt file. */
+    LibraryBuffer_reserve(&strings, 1, 1);
+    header.strings = LibraryBuffer_append(&buffer, strings.data,
+            strings.size, 8);
+    LibraryBuffer_reserve(&buffer, 0, 8);
+    Memory_free(strings.data);
+
+    memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = EXPRESSION_LIBRARY_VERSION;
+    header.byteOrder = BYTE_ORDER_MARK;
+    header.wordSize = sizeof(size_t);
+    header.boolSize = sizeof(bool);
+    header.instructionSize = sizeof(Instruction);
+    header.operatorCount = OPERATOR_COUNT;
+    header.size = buffer.size;
+    header.checksum = ExpressionLibrary_checksum(
+            buffer.data + sizeof(header), buffer.size - sizeof(header));
+    memcpy(buffer.data, &header, sizeof(header));
+
+    success = fwrite(buffer.data, buffer.size, 1, file) == 1;
+    Memory_free(buffer.data);
+
+    return success;
+}
+
+/**
+ * Check that an array of a mapped library lies within it.
+ */
+static bool ExpressionLibrary_isInFile(ExpressionLibrary *library,
+        uint64_t offset, uint64_t count, size_t elementSize) {
+    return offset % 8 == 0 && offset <= library->mappingSize
+            && count <= (library->mappingSize - offset) / elementSize;
+}
+
+/**
+ * Get a string of a mapped library, or null if its offset is out of
+ * the string section.
+ */
+static string ExpressionLibrary_getString(ExpressionLibrary *library,
+        uint64_t offset) {
+
+    const LibraryHeader *header = library->mapping;
+
+    if (offset >= library->mappingSize - header->strings) {
+        return null;
+    }
+    return (string)library->mapping + header->strings + offset;
+}
+
+/**
+ * Point strings of a program at the string section, from an array of
+ * their offsets.
+ */
+static bool ExpressionLibrary_loadStrings(ExpressionLibrary *library,
+        uint64_t offset, size_t count, string *strings) {
+
+    const uint64_t *offsets;
+    size_t i;
+
+    if (!ExpressionLibrary_isInFile(library, offset, count,
+            sizeof(uint64_t))) {
+        return false;
+    }
+    offsets = (const uint64_t *)((char *)library->mapping + offset);
+    for (i = 0; i < count; ++i) {
+        strings[i] = ExpressionLibrary_getString(library, offsets[i]);
+        if (strings[i] == null) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Check that the instructions of a program keep to its operand stack,
+ * variables and temporaries, and apply only known operators.
+ */
+static bool ExpressionLibrary_checkProgram(CompiledExpression *program,
+        size_t operatorCount) {
+
+    Instruction *instruction = program->instructions,
+            *end = instruction + program->instructionCount;
+    size_t depth = 0, operandCount;
+
+    for (; instruction != end; ++instruction) {
+        switch (instruction->type) {
+        case INSTRUCTION_CONSTANT:
+            ++depth;
+            break;
+        case INSTRUCTION_VARIABLE:
+            if (instruction->argument.variable >= program->variableCount) {
+                return false;
+            }
+            ++depth;
+            break;
+        case INSTRUCTION_OPERATOR:
+            if ((size_t)instruction->operator >= operatorCount) {
+                return false;
+            }
+            operandCount = Operator_getOperandCount(instruction->operator);
+            if (depth < operandCount) {
+                return false;
+            }
+            depth = depth - operandCount + 1;
+            break;
+        case INSTRUCTION_STORE:
+            if (depth == 0 || instruction->argument.temporary
+                    >= program->temporaryCount) {
+                return false;
+            }
+            break;
+        case INSTRUCTION_LOAD:
+            if (instruction->argument.temporary
+                    >= program->temporaryCount) {
+                return false;
+            }
+            ++depth;
+            break;
+        default:
+            return false;
+        }
+        if (depth > program->stackDepth) {
+            return false;
+        }
+    }
+
+    return depth == 1;
+}
+
+/**
+ * Point the chain of a program at its arrays in a mapped library,
+ * checking that they lie within the program.
+ */
+static bool ExpressionLibrary_loadChain(ExpressionLibrary *library,
+        uint64_t offset, CompiledExpression *program,
+        ExpressionChain *chain) {
+
+    const LibraryChain *record;
+    char *base = library->mapping;
+    size_t i;
+
+    if (!ExpressionLibrary_isInFile(library, offset, 1,
+            sizeof(LibraryChain))) {
+        return false;
+    }
+    record = (const LibraryChain *)(base + offset);
+    if ((record->operator != OPERATOR_ADDITION
+                    && record->operator != OPERATOR_MULPLICATION)
+            || record->chunkCount == 0
+            || record->sharedRangeCount > program->temporaryCount
+            || !ExpressionLibrary_isInFile(library, record->termEnds,
+                    (program->instructionCount + 7) / 8, 1)
+            || !ExpressionLibrary_isInFile(library, record->chunkStarts,
+                    record->chunkCount, sizeof(size_t))
+            || !ExpressionLibrary_isInFile(library, record->sharedRanges,
+                    2 * record->sharedRangeCount, sizeof(size_t))
+            || !ExpressionLibrary_isInFile(library, record->isShared,
+                    program->temporaryCount + 1, sizeof(bool))) {
+        return false;
+    }
+
+    chain->operator = record->operator;
+    chain->termEnds = (unsigned char *)(base + record->termEnds);
+    chain->chunkStarts = (size_t *)(base + record->chunkStarts);
+    chain->chunkCount = record->chunkCount;
+    chain->sharedRanges = (size_t *)(base + record->sharedRanges);
+    chain->sharedRangeCount = record->sharedRangeCount;
+    chain->isShared = (bool *)(base + record->isShared);
+
+    for (i = 0; i < chain->chunkCount; ++i) {
+        if (chain->chunkStarts[i] >= program->instructionCount
+                || (i == 0 ? chain->chunkStarts[i] != 0
+                        : chain->chunkStarts[i]
+                                <= chain->chunkStarts[i - 1])) {
+            return false;
+        }
+    }
+    for (i = 0; i < chain->sharedRangeCount; ++i) {
+        if (chain->sharedRanges[2 * i] >= chain->sharedRanges[2 * i + 1]
+                || chain->sharedRanges[2 * i + 1]
+                        > program->instructionCount) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Check that the registered functions a mapped library uses are
+ * registered as the same operators as when it was written.
+ */
+static bool ExpressionLibrary_checkFunctions(ExpressionLibrary *library) {
+
+    const LibraryHeader *header = library->mapping;
+    const uint64_t *offsets;
+    string name;
+    Operator operator;
+    size_t i;
+
+    if (!ExpressionLibrary_isInFile(library, header->functions,
+            header->functionCount, sizeof(uint64_t))) {
+        return false;
+    }
+    offsets = (const uint64_t *)((char *)library->mapping
+            + header->functions);
+    for (i = 0; i < header->functionCount; ++i) {
+        name = ExpressionLibrary_getString(library, offsets[i]);
+        if (name == null
+                || !FunctionRegistry_find(name, string_length(name),
+                        &operator)
+                || operator != OPERATOR_FIRST_USER_FUNCTION + i) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Set up a program of a mapped library, pointing it into the mapping,
+ * and check that it is well formed.
+ * @return Whether the program is well formed.
+ */
+static bool ExpressionLibrary_setUpProgram(ExpressionLibrary *library,
+        size_t index) {
+
+    const LibraryHeader *header = library->mapping;
+    const LibraryRecord *record = &library->records[index];
+    CompiledExpression *program = &library->programs[index];
+    char *base = library->mapping;
+
+    if (!ExpressionLibrary_isInFile(library, record->instructions,
+                    record->instructionCount, sizeof(Instruction))
+            || record->stackDepth > record->instructionCount
+            || record->temporaryCount > record->instructionCount
+            || record->stringIndex > header->stringCount
+            || record->variableCount > header->stringCount
+                    - record->stringIndex
+            || record->literalCount > header->stringCount
+                    - record->stringIndex - record->variableCount
+            || (record->chain != 0
+                    && record->chainIndex >= header->chainCount)) {
+        return false;
+    }
+
+    program->instructions = (Instruction *)(base + record->instructions);
+    program->instructionCount = record->instructionCount;
+    program->variableNames = &library->strings[record->stringIndex];
+    program->variableCount = record->variableCount;
+    program->literals = program->variableNames + record->variableCount;
+    program->literalCount = record->literalCount;
+    program->stackDepth = record->stackDepth;
+    program->temporaryCount = record->temporaryCount;
+    program->eliminatedOperatorCount = record->eliminatedOperatorCount;
+    program->inexact = record->inexact != 0;
+    if (record->chain != 0) {
+        program->chain = &library->chains[record->chainIndex];
+    }
+
+    return ExpressionLibrary_loadStrings(library, record->variableNames,
+                    program->variableCount, program->variableNames)
+            && ExpressionLibrary_loadStrings(library, record->literals,
+                    program->literalCount, program->literals)
+            && ExpressionLibrary_checkProgram(program,
+                    OPERATOR_FIRST_USER_FUNCTION + header->functionCount)
+            && (program->chain == null
+                    || ExpressionLibrary_loadChain(library, record->chain,
+                            program, program->chain));
+}
+
+/**
+ * Set up a program of a mapped library unless it already is, waiting
+ * for another thread setting it up at the same time.
+ * @return The state of the program, loaded or invalid.
+ */
+static unsigned char ExpressionLibrary_loadProgram(
+        ExpressionLibrary *library, size_t index) {
+
+    unsigned char *state = &library->programStates[index],
+            expected = PROGRAM_UNLOADED;
+
+    if (__atomic_compare_exchange_n(state, &expected, PROGRAM_LOADING,
+            false, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE)) {
+        expected = ExpressionLibrary_setUpProgram(library, index)
+                ? PROGRAM_LOADED : PROGRAM_INVALID;
+        __atomic_store_n(state, expected, __ATOMIC_RELEASE);
+        return expected;
+    }
+
+    while (expected == PROGRAM_LOADING) {
+        sched_yield();
+        expected = __atomic_load_n(state, __ATOMIC_ACQUIRE);
+    }
+    return expected;
+}
+
+/**
+ * Open a library file written by {@link ExpressionLibrary_serialize},
+ * by mapping it into memory.
+ * @note Nothing is parsed and nothing is copied. Only the header is
+ *       read when opening; each program is pointed into the mapping
+ *       and checked to be well formed when it is first used, so that a
+ *       cold start takes about as long as mapping the file.
+ * @note Verifying reads the whole file when opening, for its checksum
+ *       and to set up every program, so that a corrupt library is
+ *       rejected as a whole. A library should still be trusted like the
+ *       program using it.
+ * @param path The path of the library file.
+ * @param verify Whether to verify the library when opening it.
+ * @return The library, to be closed with
+ *         {@link ExpressionLibrary_close}, or null if the file cannot
+ *         be read, is not a library of this version and machine, uses
+ *         functions that are not registered as when it was written, or
+ *         fails verification.
+ */
+ExpressionLibrary *ExpressionLibrary_open(string path, bool verify) {
+
+    ExpressionLibrary *library;
+    const LibraryHeader *header;
+    struct stat status;
+    void *mapping;
+    size_t i;
+    int file = open(path, O_RDONLY);
+
+    if (file < 0) {
+        return null;
+    }
+    if (fstat(file, &status) != 0
+            || (size_t)status.st_size < sizeof(LibraryHeader)
+            || status.st_size % 8 != 0) {
+        close(file);
+        return null;
+    }
+    mapping = mmap(null, status.st_size, PROT_READ, MAP_PRIVATE, file,
+            0);
+    close(file);
+    if (mapping == MAP_FAILED) {
+        return null;
+    }
+
+    library = Memory_allocateType(ExpressionLibrary);
+    library->mapping = mapping;
+    library->mappingSize = status.st_size;
+
+    header = mapping;
+    if (memcmp(header->magic, MAGIC, sizeof(MAGIC)) != 0
+            || header->version != EXPRESSION_LIBRARY_VERSION
+            || header->byteOrder != BYTE_ORDER_MARK
+            || header->wordSize != sizeof(size_t)
+            || header->boolSize != sizeof(bool)
+            || header->instructionSize != sizeof(Instruction)
+            || header->operatorCount != OPERATOR_COUNT
+            || header->size != library->mappingSize
+            || header->strings > library->mappingSize
+            || header->strings < sizeof(LibraryHeader)
+            || ((char *)mapping)[library->mappingSize - 1] != '\0'
+            || header->stringCount > library->mappingSize
+            || header->chainCount > library->mappingSize
+            || !ExpressionLibrary_isInFile(library, header->records,
+                    header->expressionCount, sizeof(LibraryRecord))
+            || !ExpressionLibrary_isInFile(library, header->sortedIndices,
+                    header->expressionCount, sizeof(uint64_t))
+            || !ExpressionLibrary_checkFunctions(library)
+            || (verify && header->checksum
+                    != ExpressionLibrary_checksum((unsigned char *)mapping
+                            + sizeof(LibraryHeader),
+                            library->mappingSize
+                                    - sizeof(LibraryHeader)))) {
+        ExpressionLibrary_close(library);
+        return null;
+    }
+
+    library->count = header->expressionCount;
+    library->records = (const LibraryRecord *)((char *)mapping
+            + header->records);
+    library->sortedIndices = (const uint64_t *)((char *)mapping
+            + header->sortedIndices);
+    /*
+     * Memory for all the programs is allocated at once, and is only
+     * touched when they are first used.
+     */
+    library->programs = Memory_allocate(MAX(library->count, 1)
+            * sizeof(CompiledExpression));
+    library->programStates = Memory_allocate(MAX(library->count, 1));
+    library->strings = Memory_allocate(MAX(header->stringCount, 1)
+            * sizeof(string));
+    library->chains = Memory_allocate(MAX(header->chainCount, 1)
+            * sizeof(ExpressionChain));
+
+    if (verify) {
+        for (i = 0; i < library->count; ++i) {
+            if (library->sortedIndices[i] >= library->count
+                    || ExpressionLibrary_loadProgram(library, i)
+                            != PROGRAM_LOADED) {
+                ExpressionLibrary_close(library);
+                return null;
+            }
+        }
+    }
+
+    return library;
+}
+
+void ExpressionLibrary_close(ExpressionLibrary *library) {
+
+    Memory_free(library->chains);
+    Memory_free(library->strings);
+    Memory_free(library->programStates);
+    Memory_free(library->programs);
+    munmap(library->mapping, library->mappingSize);
+
+    Memory_free(library);
+}
+
+size_t ExpressionLibrary_getCount(ExpressionLibrary *library) {
+    return library->count;
+}
+
+/**
+ * Get the name of an expression of a library.
+ * @return The name, or null if it is corrupt.
+ */
+string ExpressionLibrary_getName(ExpressionLibrary *library,
+        size_t index) {
+    return ExpressionLibrary_getString(library,
+            library->records[index].name);
+}
+
+/**
+ * Get the program of an expression of a library, setting it up if it
+ * is used for the first time.
+ * @note Programs can be got and evaluated from many threads at once.
+ * @return The program, or null if it is corrupt.
+ */
+CompiledExpression *ExpressionLibrary_getProgram(
+        ExpressionLibrary *library, size_t index) {
+
+    unsigned char state = __atomic_load_n(&library->programStates[index],
+            __ATOMIC_ACQUIRE);
+
+    if (state != PROGRAM_LOADED) {
+        state = ExpressionLibrary_loadProgram(library, index);
+    }
+    return state == PROGRAM_LOADED ? &library->programs[index] : null;
+}
+
+/**
+ * Get the index of an expression in a library by its name, with a
+ * binary search.
+ * @return The index of the expression, or -1 if the library does not
+ *         have it.
+ */
+size_t ExpressionLibrary_indexOf(ExpressionLibrary *library,
+        string name) {
+
+    size_t low = 0, high = library->count, middle, index;
+    string middleName;
+    int comparison;
+
+    while (low < high) {
+        middle = low + (high - low) / 2;
+        index = library->sortedIndices[middle];
+        middleName = index < library->count
+                ? ExpressionLibrary_getName(library, index) : null;
+        if (middleName == null) {
+            return -1;
+        }
+        comparison = strcmp(middleName, name);
+        if (comparison == 0) {
+            return index;
+        } else if (comparison < 0) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+
+    return -1;
+}
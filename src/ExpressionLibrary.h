@@ -0,0 +1,83 @@
+/**
+ * @file ExpressionLibrary.h
+ * @author: Zhang Hai
+ */
+
+/*
+ * Copyright (C) 2014 Zhang Hai
+ *
+ * This file is part of calc.
+ *
+ * calc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * calc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with calc.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _EXPRESSION_LIBRARY_H_
+#define _EXPRESSION_LIBRARY_H_
+
+
+#include "zhclib/Common.h"
+
+#include <stdint.h>
+
+#include "CompiledExpression.h"
+#include "Evaluator.h"
+
+
+/* Version of the file format, changed with any change to it. */
+#define EXPRESSION_LIBRARY_VERSION 1
+
+typedef struct tagLibraryRecord LibraryRecord;
+
+/**
+ * A library of named compiled expressions, mapped from a file written
+ * by {@link ExpressionLibrary_serialize}.
+ * @note The programs point into the mapping and are owned by the
+ *       library; they must not be deleted or modified, and are valid
+ *       until the library is closed.
+ */
+typedef struct {
+    void *mapping;
+    size_t mappingSize;
+    size_t count;
+    const LibraryRecord *records;
+    /* Indices of the expressions in order of their names. */
+    const uint64_t *sortedIndices;
+    CompiledExpression *programs;
+    unsigned char *programStates;
+    /* Variable names and literals of all the programs. */
+    string *strings;
+    ExpressionChain *chains;
+} ExpressionLibrary;
+
+
+bool ExpressionLibrary_serialize(string *names,
+        CompiledExpression **programs, size_t count, FILE *file);
+
+ExpressionLibrary *ExpressionLibrary_open(string path, bool verify);
+
+void ExpressionLibrary_close(ExpressionLibrary *library);
+
+size_t ExpressionLibrary_getCount(ExpressionLibrary *library);
+
+string ExpressionLibrary_getName(ExpressionLibrary *library,
+        size_t index);
+
+CompiledExpression *ExpressionLibrary_getProgram(
+        ExpressionLibrary *library, size_t index);
+
+size_t ExpressionLibrary_indexOf(ExpressionLibrary *library,
+        string name);
+
+
+#endif /* _EXPRESSION_LIBRARY_H_ */
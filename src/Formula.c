@@ -0,0 +1,175 @@
+/**
+ * @file Formula.c
+ * @author: Zhang Hai
+ */
+
+/*
+ * Copyright (C) 2014 Zhang Hai
+ *
+ * This file is part of calc.
+ *
+ * calc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * calc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with calc.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Formula.h"
+
+
+static const size_t INITIAL_NAME_COUNT = 16;
+
+/*
+ * A formula takes tens of nanoseconds, so only levels wide enough to
+ * give every thread a few chunks of this size are split up.
+ */
+static const size_t FORMULA_GRAIN_SIZE = 64;
+
+
+/**
+ * A level of formulas run on a pool, whose ranges start at the start
+ * of the level.
+ */
+typedef struct {
+    ThreadPool_Task task;
+    void *data;
+    size_t start;
+} FormulaLevel;
+
+
+static void FormulaNameTable_rehash(FormulaNameTable *table,
+        size_t bucketCount) {
+
+    size_t i, *bucket;
+
+    Memory_free(table->buckets);
+    table->buckets = Memory_allocate(bucketCount * sizeof(size_t));
+    table->bucketMask = bucketCount - 1;
+    for (i = 0; i < bucketCount; ++i) {
+        table->buckets[i] = FORMULA_NO_NAME;
+    }
+
+    for (i = 0; i < table->count; ++i) {
+        bucket = &table->buckets[table->names[i].hash & table->bucketMask];
+        table->names[i].nextInBucket = *bucket;
+        *bucket = i;
+    }
+}
+
+/**
+ * Initialize an empty {@link FormulaNameTable}.
+ * @param capacity The number of names the table can hold before it
+ *        grows.
+ */
+void FormulaNameTable_initialize(FormulaNameTable *table,
+        size_t capacity) {
+
+    size_t bucketCount = INITIAL_NAME_COUNT;
+
+    while (bucketCount < capacity) {
+        bucketCount *= 2;
+    }
+    table->names = Memory_allocate(bucketCount * sizeof(FormulaName));
+    table->count = 0;
+    table->allocatedCount = bucketCount;
+    table->buckets = null;
+    FormulaNameTable_rehash(table, bucketCount);
+}
+
+void FormulaNameTable_finalize(FormulaNameTable *table) {
+    Memory_free(table->names);
+    Memory_free(table->buckets);
+}
+
+/**
+ * Find a name in a table.
+ * @param hash The hash of the name, as given by string_hash.
+ * @return The index of the name, or FORMULA_NO_NAME if the table does
+ *         not have it.
+ */
+size_t FormulaNameTable_find(FormulaNameTable *table, string name,
+        size_t hash) {
+
+    size_t index = table->buckets[hash & table->bucketMask];
+
+    for (; index != FORMULA_NO_NAME;
+            index = table->names[index].nextInBucket) {
+        if (table->names[index].hash == hash
+                && string_isEqual(table->names[index].name, name)) {
+            return index;
+        }
+    }
+    return FORMULA_NO_NAME;
+}
+
+/**
+ * Add a name that is not in a table yet, growing the table if it is
+ * full.
+ * @return The index of the name, which is the number of names added
+ *         before it.
+ */
+size_t FormulaNameTable_add(FormulaNameTable *table, string name,
+        size_t hash) {
+
+    size_t index, *bucket;
+
+    if (table->count == table->allocatedCount) {
+        table->allocatedCount *= 2;
+        table->names = Memory_reallocate(table->names,
+                table->allocatedCount * sizeof(FormulaName));
+        FormulaNameTable_rehash(table, table->allocatedCount);
+    }
+
+    index = table->count++;
+    bucket = &table->buckets[hash & table->bucketMask];
+    table->names[index].name = name;
+    table->names[index].hash = hash;
+    table->names[index].nextInBucket = *bucket;
+    *bucket = index;
+
+    return index;
+}
+
+static void FormulaLevel_runRange(void *data, size_t start, size_t end) {
+    FormulaLevel *level = data;
+    level->task(level->data, level->start + start, level->start + end);
+}
+
+/**
+ * Evaluate formulas level by level, where a level only depends on the
+ * levels before it, so that a formula can take the results of those it
+ * references, and fail with the first of them that failed.
+ * @note The formulas of a level wide enough are spread across the
+ *       threads of the pool, and the others run on the calling thread.
+ * @param pool The pool, or null to run every level on the calling
+ *        thread.
+ * @param levelStarts The start of each level in the order of the
+ *        formulas, followed by the end of the last one.
+ * @param task The task evaluating a range of the order of the
+ *        formulas.
+ */
+void Formula_evaluateLevels(ThreadPool *pool, const size_t *levelStarts,
+        size_t levelCount, ThreadPool_Task task, void *data) {
+
+    FormulaLevel level = {task, data, 0};
+    size_t count, i;
+
+    for (i = 0; i < levelCount; ++i) {
+        level.start = levelStarts[i];
+        count = levelStarts[i + 1] - level.start;
+        if (pool == null || count < 2 * FORMULA_GRAIN_SIZE) {
+            task(data, level.start, level.start + count);
+        } else {
+            ThreadPool_run(pool, 0, count, FORMULA_GRAIN_SIZE,
+                    FormulaLevel_runRange, &level);
+        }
+    }
+}
@@ -0,0 +1,72 @@
+/**
+ * @file Formula.h
+ * @author: Zhang Hai
+ */
+
+/*
+ * Copyright (C) 2014 Zhang Hai
+ *
+ * This file is part of calc.
+ *
+ * calc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * calc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with calc.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _FORMULA_H_
+#define _FORMULA_H_
+
+
+#include "zhclib/Common.h"
+#include "zhclib/ThreadPool.h"
+
+
+#define FORMULA_NO_NAME ((size_t)-1)
+
+
+typedef struct {
+    string name;
+    size_t hash;
+    size_t nextInBucket;
+} FormulaName;
+
+/**
+ * Names of formulas in a hash table, indexed in the order they were
+ * added.
+ * @note The names are not copied, so they must outlive the table.
+ */
+typedef struct {
+    FormulaName *names;
+    size_t count;
+    size_t allocatedCount;
+    size_t *buckets;
+    /* Bucket count is always a power of two. */
+    size_t bucketMask;
+} FormulaNameTable;
+
+
+void FormulaNameTable_initialize(FormulaNameTable *table,
+        size_t capacity);
+
+void FormulaNameTable_finalize(FormulaNameTable *table);
+
+size_t FormulaNameTable_find(FormulaNameTable *table, string name,
+        size_t hash);
+
+size_t FormulaNameTable_add(FormulaNameTable *table, string name,
+        size_t hash);
+
+void Formula_evaluateLevels(ThreadPool *pool, const size_t *levelStarts,
+        size_t levelCount, ThreadPool_Task task, void *data);
+
+
+#endif /* _FORMULA_H_ */
@@ -0,0 +1,488 @@
+/**
+ * @file FormulaGraph.c
+ * @author: Zhang Hai
+ */
+
+/*
+ * Copyright (C) 2014 Zhang Hai
+ *
+ * This file is part of calc.
+ *
+ * calc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * calc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with calc.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "FormulaGraph.h"
+
+#include <string.h>
+
+#include "zhclib/ArrayStack.h"
+#include "CompiledExpression.h"
+#include "Formula.h"
+
+
+typedef size_t FormulaCellIndex;
+
+ARRAY_STACK_DEFINE(FormulaCellIndex)
+
+
+typedef struct {
+    /* Null for an input. */
+    CompiledExpression *program;
+    /* The cell of each variable of the program, indexed by its slot. */
+    size_t *dependencies;
+    size_t dependencyCount;
+    FormulaCellIndexStack dependents;
+    /* Greater than the level of every dependency. */
+    size_t level;
+    Operand value;
+    EvaluationResult result;
+    /* The formula changed and must be evaluated on the next update. */
+    bool stale;
+    /* The value changed during the current update. */
+    bool changed;
+    size_t visit;
+} FormulaCell;
+
+struct tagFormulaGraph {
+    /* The name of each cell, by its index. */
+    FormulaNameTable names;
+    FormulaCell **cells;
+    size_t allocatedCellCount;
+    /* Cells set since the last update. */
+    FormulaCellIndexStack changedCells;
+    size_t visit;
+    ThreadPool *pool;
+    /* Scratch memory for traversals and updates. */
+    FormulaCellIndexStack pending;
+    FormulaCellIndexStack affected;
+    FormulaCellIndexStack order;
+    FormulaCellIndexStack levelStarts;
+};
+
+typedef struct {
+    FormulaGraph *graph;
+    size_t recomputedCount;
+    pthread_mutex_t mutex;
+} FormulaUpdate;
+
+
+/**
+ * Find a cell by its name, adding it as an input of 0 if it is not
+ * there.
+ */
+static size_t FormulaGraph_findOrAdd(FormulaGraph *graph, string name) {
+
+    size_t hash = string_hash(name),
+            index = FormulaNameTable_find(&graph->names, name, hash);
+    FormulaCell *cell;
+
+    if (index != FORMULA_NO_NAME) {
+        return index;
+    }
+
+    index = FormulaNameTable_add(&graph->names, string_clone(name), hash);
+    if (graph->names.allocatedCount != graph->allocatedCellCount) {
+        graph->allocatedCellCount = graph->names.allocatedCount;
+        graph->cells = Memory_reallocate(graph->cells,
+                graph->allocatedCellCount * sizeof(FormulaCell *));
+    }
+
+    cell = Memory_allocateType(FormulaCell);
+    cell->result = EVALUATION_SUCCESS;
+    graph->cells[index] = cell;
+
+    return index;
+}
+
+static void FormulaGraph_markChanged(FormulaGraph *graph, size_t index) {
+
+    FormulaCell *cell = graph->cells[index];
+
+    if (!cell->changed) {
+        cell->changed = true;
+        FormulaCellIndexStack_push(&graph->changedCells, index);
+    }
+}
+
+/**
+ * Visit every cell that depends on a cell, directly or not, including
+ * the cell itself, leaving them in graph->affected.
+ * @note Cells already visited in the current round are skipped, so that
+ *       several calls with the same graph->visit visit each cell once.
+ */
+static void FormulaGraph_visitDependents(FormulaGraph *graph,
+        size_t index) {
+
+    FormulaCell *cell = graph->cells[index];
+    size_t i;
+
+    if (cell->visit == graph->visit) {
+        return;
+    }
+    cell->visit = graph->visit;
+    FormulaCellIndexStack_push(&graph->pending, index);
+
+    while (!FormulaCellIndexStack_isEmpty(&graph->pending)) {
+        index = FormulaCellIndexStack_pop(&graph->pending);
+        FormulaCellIndexStack_push(&graph->affected, index);
+        cell = graph->cells[index];
+        for (i = 0; i < cell->dependents.size; ++i) {
+            if (graph->cells[cell->dependents.array[i]]->visit
+                    != graph->visit) {
+                graph->cells[cell->dependents.array[i]]->visit =
+                        graph->visit;
+                FormulaCellIndexStack_push(&graph->pending,
+                        cell->dependents.array[i]);
+            }
+        }
+    }
+}
+
+static void FormulaGraph_removeDependencies(FormulaGraph *graph,
+        size_t index) {
+
+    FormulaCell *cell = graph->cells[index];
+    FormulaCellIndexStack *dependents;
+    size_t i, j;
+
+    for (i = 0; i < cell->dependencyCount; ++i) {
+        dependents = &graph->cells[cell->dependencies[i]]->dependents;
+        for (j = 0; dependents->array[j] != index; ++j) {}
+        dependents->array[j] = FormulaCellIndexStack_pop(dependents);
+    }
+    Memory_free(cell->dependencies);
+    cell->dependencies = null;
+    cell->dependencyCount = 0;
+
+    if (cell->program != null) {
+        CompiledExpression_delete(cell->program);
+        cell->program = null;
+    }
+}
+
+/**
+ * Raise the level of the cells that depend on a cell, so that each
+ * stays above all of its dependencies.
+ */
+static void FormulaGraph_propagateLevel(FormulaGraph *graph,
+        size_t index) {
+
+    FormulaCell *cell, *dependent;
+    size_t i;
+
+    FormulaCellIndexStack_push(&graph->pending, index);
+    while (!FormulaCellIndexStack_isEmpty(&graph->pending)) {
+        cell = graph->cells[FormulaCellIndexStack_pop(&graph->pending)];
+        for (i = 0; i < cell->dependents.size; ++i) {
+            dependent = graph->cells[cell->dependents.array[i]];
+            if (dependent->level <= cell->level) {
+                dependent->level = cell->level + 1;
+                FormulaCellIndexStack_push(&graph->pending,
+                        cell->dependents.array[i]);
+            }
+        }
+    }
+}
+
+/**
+ * Create a {@link FormulaGraph}.
+ * @param threadCount The number of threads to recompute cells on, or 0
+ *        for the number of processors.
+ */
+FormulaGraph *FormulaGraph_new(size_t threadCount) {
+
+    FormulaGraph *graph = Memory_allocateType(FormulaGraph);
+
+    FormulaNameTable_initialize(&graph->names, 0);
+    graph->allocatedCellCount = graph->names.allocatedCount;
+    graph->cells = Memory_allocate(
+            graph->allocatedCellCount * sizeof(FormulaCell *));
+    if (threadCount != 1) {
+        graph->pool = ThreadPool_new(threadCount);
+    }
+
+    return graph;
+}
+
+void FormulaGraph_delete(FormulaGraph *graph) {
+
+    FormulaCell *cell;
+    size_t i;
+
+    for (i = 0; i < graph->names.count; ++i) {
+        cell = graph->cells[i];
+        Memory_free(graph->names.names[i].name);
+        if (cell->program != null) {
+            CompiledExpression_delete(cell->program);
+        }
+        Memory_free(cell->dependencies);
+        FormulaCellIndexStack_finalize(&cell->dependents);
+        Memory_free(cell);
+    }
+    Memory_free(graph->cells);
+    FormulaNameTable_finalize(&graph->names);
+
+    FormulaCellIndexStack_finalize(&graph->changedCells);
+    FormulaCellIndexStack_finalize(&graph->pending);
+    FormulaCellIndexStack_finalize(&graph->affected);
+    FormulaCellIndexStack_finalize(&graph->order);
+    FormulaCellIndexStack_finalize(&graph->levelStarts);
+    if (graph->pool != null) {
+        ThreadPool_delete(graph->pool);
+    }
+
+    Memory_free(graph);
+}
+
+/**
+ * Set a cell to a formula, adding the cells it references as inputs of
+ * 0 if they are not there.
+ * @note The cell is evaluated on the next {@link FormulaGraph_update}.
+ * @return The result of compiling the formula, or
+ *         EVALUATION_ERROR_CIRCULAR_REFERENCE if the formula depends on
+ *         the cell itself; the cell is left as it was on failure.
+ */
+EvaluationResult FormulaGraph_setFormula(FormulaGraph *graph,
+        string name, string expression) {
+
+    CompiledExpression *program;
+    EvaluationResult result = compileExpression(expression, &program);
+    size_t index, variableCount, *dependencies, i;
+    FormulaCell *cell, *dependency;
+
+    if (result != EVALUATION_SUCCESS) {
+        return result;
+    }
+
+    index = FormulaGraph_findOrAdd(graph, name);
+    variableCount = CompiledExpression_getVariableCount(program);
+    dependencies = Memory_allocate(MAX(variableCount, 1) * sizeof(size_t));
+    for (i = 0; i < variableCount; ++i) {
+        dependencies[i] = FormulaGraph_findOrAdd(graph,
+                CompiledExpression_getVariableName(program, i));
+    }
+
+    /* A cycle means a dependency already depends on the cell. */
+    ++graph->visit;
+    FormulaCellIndexStack_clear(&graph->affected);
+    FormulaGraph_visitDependents(graph, index);
+    for (i = 0; i < variableCount; ++i) {
+        if (graph->cells[dependencies[i]]->visit == graph->visit) {
+            Memory_free(dependencies);
+            CompiledExpression_delete(program);
+            return EVALUATION_ERROR_CIRCULAR_REFERENCE;
+        }
+    }
+
+    FormulaGraph_removeDependencies(graph, index);
+    cell = graph->cells[index];
+    cell->program = program;
+    cell->dependencies = dependencies;
+    cell->dependencyCount = variableCount;
+    cell->level = 0;
+    for (i = 0; i < variableCount; ++i) {
+        dependency = graph->cells[dependencies[i]];
+        FormulaCellIndexStack_push(&dependency->dependents, index);
+        cell->level = MAX(cell->level, dependency->level + 1);
+    }
+    FormulaGraph_propagateLevel(graph, index);
+
+    cell->stale = true;
+    FormulaGraph_markChanged(graph, index);
+
+    return EVALUATION_SUCCESS;
+}
+
+/**
+ * Set a cell to an input value, replacing any formula it had.
+ * @note The cells depending on it are recomputed on the next
+ *       {@link FormulaGraph_update}, unless the value is the same.
+ */
+void FormulaGraph_setValue(FormulaGraph *graph, string name,
+        Operand value) {
+
+    size_t index = FormulaGraph_findOrAdd(graph, name);
+    FormulaCell *cell = graph->cells[index];
+
+    if (cell->program == null && cell->result == EVALUATION_SUCCESS
+            && memcmp(&cell->value, &value, sizeof(Operand)) == 0) {
+        return;
+    }
+
+    FormulaGraph_removeDependencies(graph, index);
+    cell->value = value;
+    cell->result = EVALUATION_SUCCESS;
+    cell->stale = false;
+    FormulaGraph_markChanged(graph, index);
+}
+
+/**
+ * Evaluate a formula if it is stale or a dependency changed.
+ * @return Whether the formula was evaluated.
+ */
+static bool FormulaGraph_recompute(FormulaGraph *graph, FormulaCell *cell) {
+
+    FormulaCell *dependency;
+    Operand *dependencyValues, value = 0;
+    EvaluationResult result = EVALUATION_SUCCESS;
+    bool changed = cell->stale;
+    size_t i;
+
+    for (i = 0; i < cell->dependencyCount && !changed; ++i) {
+        changed = graph->cells[cell->dependencies[i]]->changed;
+    }
+    if (!changed) {
+        return false;
+    }
+
+    dependencyValues = reserveScratchStack(SCRATCH_STACK_VARIABLES,
+            cell->dependencyCount);
+    for (i = 0; i < cell->dependencyCount; ++i) {
+        dependency = graph->cells[cell->dependencies[i]];
+        /* An error spreads to every cell that depends on it. */
+        if (dependency->result != EVALUATION_SUCCESS) {
+            result = dependency->result;
+            break;
+        }
+        dependencyValues[i] = dependency->value;
+    }
+    if (result == EVALUATION_SUCCESS) {
+        result = evaluateCompiled(cell->program, dependencyValues,
+                &value);
+    }
+
+    cell->changed = cell->stale || result != cell->result
+            || (result == EVALUATION_SUCCESS
+                    && memcmp(&cell->value, &value, sizeof(Operand)) != 0);
+    cell->stale = false;
+    cell->value = result == EVALUATION_SUCCESS ? value : 0;
+    cell->result = result;
+
+    return true;
+}
+
+static void FormulaGraph_recomputeRange(void *data, size_t start,
+        size_t end) {
+
+    FormulaUpdate *update = data;
+    size_t recomputedCount = 0, i;
+    FormulaCell *cell;
+
+    for (i = start; i < end; ++i) {
+        cell = update->graph->cells[update->graph->order.array[i]];
+        if (cell->program != null
+                && FormulaGraph_recompute(update->graph, cell)) {
+            ++recomputedCount;
+        }
+    }
+
+    pthread_mutex_lock(&update->mutex);
+    update->recomputedCount += recomputedCount;
+    pthread_mutex_unlock(&update->mutex);
+}
+
+/**
+ * Recompute the formulas affected by the cells set since the last
+ * update.
+ * @note Cells are recomputed level by level, where a level only
+ *       depends on the levels below it, and the cells of a wide level
+ *       are spread across threads. A formula whose dependencies all kept
+ *       their values is not evaluated again, and neither are the cells
+ *       after it unless something else they depend on changed.
+ * @return The number of formulas evaluated.
+ */
+size_t FormulaGraph_update(FormulaGraph *graph) {
+
+    FormulaUpdate update;
+    size_t *levelStarts, levelCount = 0, i;
+    FormulaCell *cell;
+
+    if (FormulaCellIndexStack_isEmpty(&graph->changedCells)) {
+        return 0;
+    }
+
+    ++graph->visit;
+    FormulaCellIndexStack_clear(&graph->affected);
+    for (i = 0; i < graph->changedCells.size; ++i) {
+        FormulaGraph_visitDependents(graph, graph->changedCells.array[i]);
+    }
+
+    /* Sort the affected cells by level. */
+    for (i = 0; i < graph->affected.size; ++i) {
+        levelCount = MAX(levelCount,
+                graph->cells[graph->affected.array[i]]->level + 1);
+    }
+    FormulaCellIndexStack_reserve(&graph->levelStarts, levelCount + 2);
+    levelStarts = graph->levelStarts.array;
+    memset(levelStarts, 0, (levelCount + 2) * sizeof(size_t));
+    for (i = 0; i < graph->affected.size; ++i) {
+        ++levelStarts[graph->cells[graph->affected.array[i]]->level + 2];
+    }
+    for (i = 0; i < levelCount; ++i) {
+        levelStarts[i + 2] += levelStarts[i + 1];
+    }
+    /*
+     * Each level is placed from levelStarts[level + 1], which is left
+     * at its end, that is at the start of the next level.
+     */
+    FormulaCellIndexStack_reserve(&graph->order, graph->affected.size);
+    for (i = 0; i < graph->affected.size; ++i) {
+        cell = graph->cells[graph->affected.array[i]];
+        graph->order.array[levelStarts[cell->level + 1]++] =
+                graph->affected.array[i];
+    }
+
+    update.graph = graph;
+    update.recomputedCount = 0;
+    pthread_mutex_init(&update.mutex, null);
+    Formula_evaluateLevels(graph->pool, levelStarts, levelCount,
+            FormulaGraph_recomputeRange, &update);
+    pthread_mutex_destroy(&update.mutex);
+
+    for (i = 0; i < graph->affected.size; ++i) {
+        graph->cells[graph->affected.array[i]]->changed = false;
+    }
+    FormulaCellIndexStack_clear(&graph->changedCells);
+
+    return update.recomputedCount;
+}
+
+/**
+ * Get the value of a cell as of the last {@link FormulaGraph_update}.
+ * @note A cell that was never set is an input of 0.
+ * @return The result of evaluating the cell.
+ */
+EvaluationResult FormulaGraph_getValue(FormulaGraph *graph, string name,
+        Operand *value) {
+
+    size_t index = FormulaNameTable_find(&graph->names, name,
+            string_hash(name));
+    FormulaCell *cell;
+
+    if (index == FORMULA_NO_NAME) {
+        *value = 0;
+        return EVALUATION_SUCCESS;
+    }
+
+    cell = graph->cells[index];
+    if (cell->result == EVALUATION_SUCCESS) {
+        *value = cell->value;
+    }
+    return cell->result;
+}
+
+size_t FormulaGraph_getCellCount(FormulaGraph *graph) {
+    return graph->names.count;
+}
@@ -0,0 +1,60 @@
+/**
+ * @file FormulaGraph.h
+ * @author: Zhang Hai
+ */
+
+/*
+ * Copyright (C) 2014 Zhang Hai
+ *
+ * This file is part of calc.
+ *
+ * calc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * calc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with calc.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _FORMULA_GRAPH_H_
+#define _FORMULA_GRAPH_H_
+
+
+#include "zhclib/Common.h"
+
+#include "Evaluator.h"
+
+
+/**
+ * A graph of named cells, each either an input value or a formula
+ * that references other cells by name, like a spreadsheet.
+ */
+typedef struct tagFormulaGraph FormulaGraph;
+
+
+FormulaGraph *FormulaGraph_new(size_t threadCount);
+
+void FormulaGraph_delete(FormulaGraph *graph);
+
+EvaluationResult FormulaGraph_setFormula(FormulaGraph *graph,
+        string name, string expression);
+
+void FormulaGraph_setValue(FormulaGraph *graph, string name,
+        Operand value);
+
+size_t FormulaGraph_update(FormulaGraph *graph);
+
+EvaluationResult FormulaGraph_getValue(FormulaGraph *graph, string name,
+        Operand *value);
+
+size_t FormulaGraph_getCellCount(FormulaGraph *graph);
+
+
+#endif /* _FORMULA_GRAPH_H_ */
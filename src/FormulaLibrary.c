@@ -0,0 +1,601 @@
+/**
+ * @file FormulaLibrary.c
+ * @author: Zhang Hai
+ */
+
+/*
+ * Copyright (C) 2014 Zhang Hai
+ *
+ * This file is part of calc.
+ *
+ * calc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * calc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with calc.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "FormulaLibrary.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "zhclib/ArrayStack.h"
+#include "CompiledExpression.h"
+#include "Formula.h"
+
+
+static const size_t INITIAL_TEXT_SIZE = 64 * 1024;
+
+/*
+ * Compiling a formula takes a microsecond or so, which is enough work
+ * for small chunks to keep every thread busy without much stealing.
+ */
+static const size_t COMPILE_GRAIN_SIZE = 16;
+
+
+ARRAY_STACK_DEFINE(FormulaError)
+
+
+typedef struct {
+    size_t line;
+    const char *expression;
+    size_t expressionLength;
+    /* Null if the expression failed to compile. */
+    CompiledExpression *program;
+    EvaluationResult result;
+    /*
+     * What each variable of the program references, by its slot: a
+     * formula by its index, or an input by its index plus the number
+     * of formulas.
+     */
+    size_t *references;
+} Formula;
+
+struct tagFormulaLibrary {
+    /* The text of the file, which holds the names of the formulas. */
+    char *text;
+    FormulaNameTable formulaNames;
+    Formula *formulas;
+    /* Names referenced by formulas that are not formulas themselves. */
+    FormulaNameTable inputNames;
+    size_t *references;
+    /*
+     * The formulas level by level, where a level only references the
+     * levels before it; formulas on a cycle of references are left out.
+     */
+    size_t *order;
+    size_t *levelStarts;
+    size_t levelCount;
+    FormulaErrorStack errors;
+    ThreadPool *pool;
+};
+
+typedef struct {
+    FormulaLibrary *library;
+    const Operand *inputValues;
+    Operand *values;
+    EvaluationResult *results;
+} FormulaEvaluation;
+
+
+static bool FormulaLibrary_isWhitespace(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+static bool FormulaLibrary_isIdentifierStart(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+}
+
+static bool FormulaLibrary_isIdentifierPart(char c) {
+    return FormulaLibrary_isIdentifierStart(c) || (c >= '0' && c <= '9');
+}
+
+static int FormulaError_compare(const void *error1, const void *error2) {
+    size_t line1 = ((const FormulaError *)error1)->line,
+            line2 = ((const FormulaError *)error2)->line;
+    return line1 < line2 ? -1 : line1 > line2;
+}
+
+/**
+ * Read a whole file into a null-terminated buffer.
+ * @return The text, or null if the file cannot be read.
+ */
+static char *FormulaLibrary_readFile(string path, size_t *length) {
+
+    FILE *file = fopen(path, "rb");
+    size_t allocatedSize = INITIAL_TEXT_SIZE;
+    char *text;
+
+    if (file == null) {
+        return null;
+    }
+
+    text = Memory_allocate(allocatedSize);
+    *length = 0;
+    for (;;) {
+        *length += fread(text + *length, 1, allocatedSize - *length - 1,
+                file);
+        if (*length < allocatedSize - 1) {
+            break;
+        }
+        allocatedSize *= 2;
+        text = Memory_reallocate(text, allocatedSize);
+    }
+    if (ferror(file)) {
+        fclose(file);
+        Memory_free(text);
+        return null;
+    }
+    fclose(file);
+    text[*length] = '\0';
+
+    return text;
+}
+
+/**
+ * Split the text of a library into formulas, terminating their names
+ * in place.
+ * @note Blank lines and lines starting with # are skipped. The first
+ *       definition of a name is kept, and a later one is an error.
+ */
+static void FormulaLibrary_parse(FormulaLibrary *library, size_t length) {
+
+    char *text = library->text, *end = text + length, *lineStart,
+            *lineEnd, *nameEnd, *position;
+    size_t lineCount = 1, line = 0, hash, index;
+    FormulaError error;
+    Formula *formula;
+
+    for (position = text; (position = memchr(position, '\n',
+            end - position)) != null; ++position) {
+        ++lineCount;
+    }
+    FormulaNameTable_initialize(&library->formulaNames, lineCount);
+    library->formulas = Memory_allocate(lineCount * sizeof(Formula));
+
+    for (lineStart = text; lineStart <= end; lineStart = lineEnd + 1) {
+        ++line;
+        lineEnd = memchr(lineStart, '\n', end - lineStart);
+        if (lineEnd == null) {
+            lineEnd = end;
+        }
+
+        position = lineStart;
+        while (position != lineEnd && FormulaLibrary_isWhitespace(
+                *position)) {
+            ++position;
+        }
+        if (position == lineEnd || *position == '#') {
+            continue;
+        }
+
+        error.line = line;
+        if (!FormulaLibrary_isIdentifierStart(*position)) {
+            error.result = EVALUATION_ERROR_MALFORMED_DEFINITION;
+            FormulaErrorStack_push(&library->errors, error);
+            continue;
+        }
+        lineStart = position;
+        while (position != lineEnd && FormulaLibrary_isIdentifierPart(
+                *position)) {
+            ++position;
+        }
+        nameEnd = position;
+        while (position != lineEnd && FormulaLibrary_isWhitespace(
+                *position)) {
+            ++position;
+        }
+        if (position == lineEnd || *position != '=') {
+            error.result = EVALUATION_ERROR_MALFORMED_DEFINITION;
+            FormulaErrorStack_push(&library->errors, error);
+            continue;
+        }
+        ++position;
+
+        *nameEnd = '\0';
+        hash = string_hashWithLength(lineStart, nameEnd - lineStart);
+        if (FormulaNameTable_find(&library->formulaNames, lineStart, hash)
+                != FORMULA_NO_NAME) {
+            error.result = EVALUATION_ERROR_DUPLICATE_DEFINITION;
+            FormulaErrorStack_push(&library->errors, error);
+            continue;
+        }
+        index = FormulaNameTable_add(&library->formulaNames, lineStart,
+                hash);
+        formula = &library->formulas[index];
+        formula->line = line;
+        formula->expression = position;
+        formula->expressionLength = lineEnd - position;
+    }
+}
+
+static void FormulaLibrary_compileRange(void *data, size_t start,
+        size_t end) {
+
+    FormulaLibrary *library = data;
+    Formula *formula;
+    size_t i;
+
+    for (i = start; i < end; ++i) {
+        formula = &library->formulas[i];
+        formula->result = compileExpressionN(formula->expression,
+                formula->expressionLength, &formula->program);
+    }
+}
+
+/**
+ * Resolve each variable of the formulas to the formula of that name,
+ * or to an input if there is none.
+ */
+static void FormulaLibrary_resolve(FormulaLibrary *library) {
+
+    size_t count = library->formulaNames.count, referenceCount = 0,
+            variableCount, index, hash, i, j;
+    Formula *formula;
+    string name;
+
+    for (i = 0; i < count; ++i) {
+        formula = &library->formulas[i];
+        if (formula->program != null) {
+            referenceCount += CompiledExpression_getVariableCount(
+                    formula->program);
+        }
+    }
+    library->references = Memory_allocate(
+            MAX(referenceCount, 1) * sizeof(size_t));
+    FormulaNameTable_initialize(&library->inputNames, referenceCount);
+
+    referenceCount = 0;
+    for (i = 0; i < count; ++i) {
+        formula = &library->formulas[i];
+        if (formula->program == null) {
+            continue;
+        }
+        formula->references = library->references + referenceCount;
+        variableCount = CompiledExpression_getVariableCount(
+                formula->program);
+        referenceCount += variableCount;
+        for (j = 0; j < variableCount; ++j) {
+            name = CompiledExpression_getVariableName(formula->program, j);
+            hash = string_hash(name);
+            index = FormulaNameTable_find(&library->formulaNames, name,
+                    hash);
+            if (index == FORMULA_NO_NAME) {
+                index = FormulaNameTable_find(&library->inputNames, name,
+                        hash);
+                if (index == FORMULA_NO_NAME) {
+                    index = FormulaNameTable_add(&library->inputNames,
+                            name, hash);
+                }
+                index += count;
+            }
+            formula->references[j] = index;
+        }
+    }
+}
+
+/**
+ * Sort the formulas into levels, where each formula comes after every
+ * formula it references, and mark the formulas on a cycle of
+ * references, or depending on one, as circular.
+ */
+static void FormulaLibrary_sort(FormulaLibrary *library) {
+
+    size_t count = library->formulaNames.count, *pendingCounts,
+            *dependentStarts, *dependentEnds, *dependents, *order,
+            orderedCount = 0, levelStart, levelEnd, variableCount,
+            reference, i, j;
+    Formula *formula;
+    FormulaError error;
+
+    pendingCounts = Memory_allocate(MAX(count, 1) * sizeof(size_t));
+    dependentStarts = Memory_allocate((count + 1) * sizeof(size_t));
+    for (i = 0; i < count; ++i) {
+        formula = &library->formulas[i];
+        variableCount = formula->program != null
+                ? CompiledExpression_getVariableCount(formula->program) : 0;
+        for (j = 0; j < variableCount; ++j) {
+            reference = formula->references[j];
+            if (reference < count) {
+                ++pendingCounts[i];
+                ++dependentStarts[reference + 1];
+            }
+        }
+    }
+    for (i = 0; i < count; ++i) {
+        dependentStarts[i + 1] += dependentStarts[i];
+    }
+    dependents = Memory_allocate(
+            MAX(dependentStarts[count], 1) * sizeof(size_t));
+    dependentEnds = Memory_allocate(MAX(count, 1) * sizeof(size_t));
+    memcpy(dependentEnds, dependentStarts, count * sizeof(size_t));
+    for (i = 0; i < count; ++i) {
+        formula = &library->formulas[i];
+        variableCount = formula->program != null
+                ? CompiledExpression_getVariableCount(formula->program) : 0;
+        for (j = 0; j < variableCount; ++j) {
+            reference = formula->references[j];
+            if (reference < count) {
+                dependents[dependentEnds[reference]++] = i;
+            }
+        }
+    }
+
+    /* A formula joins the level after the last of its references. */
+    order = library->order = Memory_allocate(
+            MAX(count, 1) * sizeof(size_t));
+    library->levelStarts = Memory_allocate((count + 1) * sizeof(size_t));
+    for (i = 0; i < count; ++i) {
+        if (pendingCounts[i] == 0) {
+            order[orderedCount++] = i;
+        }
+    }
+    for (levelStart = 0; levelStart < orderedCount;
+            levelStart = levelEnd) {
+        library->levelStarts[library->levelCount++] = levelStart;
+        levelEnd = orderedCount;
+        for (i = levelStart; i < levelEnd; ++i) {
+            for (j = dependentStarts[order[i]];
+                    j < dependentStarts[order[i] + 1]; ++j) {
+                if (--pendingCounts[dependents[j]] == 0) {
+                    order[orderedCount++] = dependents[j];
+                }
+            }
+        }
+    }
+    library->levelStarts[library->levelCount] = orderedCount;
+
+    for (i = 0; i < count; ++i) {
+        if (pendingCounts[i] != 0) {
+            formula = &library->formulas[i];
+            formula->result = EVALUATION_ERROR_CIRCULAR_REFERENCE;
+            error.line = formula->line;
+            error.result = formula->result;
+            FormulaErrorStack_push(&library->errors, error);
+        }
+    }
+
+    Memory_free(dependentEnds);
+    Memory_free(dependents);
+    Memory_free(dependentStarts);
+    Memory_free(pendingCounts);
+}
+
+/**
+ * Load a library of formulas from a text file, where each line is a
+ * definition like name = expression.
+ * @note The formulas are compiled in parallel. A line that fails to
+ *       parse or compile does not stop the load; it is reported by
+ *       {@link FormulaLibrary_getErrors} with its line number, and any
+ *       formula referencing it fails when evaluated.
+ * @note A variable of a formula references the formula of that name if
+ *       there is one, and is an input of the library otherwise.
+ * @param threadCount The number of threads to compile and evaluate
+ *        formulas on, or 0 for the number of processors.
+ * @return The library, to be deleted with
+ *         {@link FormulaLibrary_delete}, or null if the file cannot be
+ *         read.
+ */
+FormulaLibrary *FormulaLibrary_load(string path, size_t threadCount) {
+
+    FormulaLibrary *library;
+    FormulaError error;
+    size_t length, count, i;
+    char *text = FormulaLibrary_readFile(path, &length);
+
+    if (text == null) {
+        return null;
+    }
+
+    library = Memory_allocateType(FormulaLibrary);
+    library->text = text;
+    if (threadCount != 1) {
+        library->pool = ThreadPool_new(threadCount);
+    }
+
+    FormulaLibrary_parse(library, length);
+    count = library->formulaNames.count;
+    if (library->pool == null || count < 2 * COMPILE_GRAIN_SIZE) {
+        FormulaLibrary_compileRange(library, 0, count);
+    } else {
+        ThreadPool_run(library->pool, 0, count, COMPILE_GRAIN_SIZE,
+                FormulaLibrary_compileRange, library);
+    }
+    for (i = 0; i < count; ++i) {
+        if (library->formulas[i].result != EVALUATION_SUCCESS) {
+            error.line = library->formulas[i].line;
+            error.result = library->formulas[i].result;
+            FormulaErrorStack_push(&library->errors, error);
+        }
+    }
+
+    FormulaLibrary_resolve(library);
+    FormulaLibrary_sort(library);
+    qsort(library->errors.array, library->errors.size,
+            sizeof(FormulaError), FormulaError_compare);
+
+    return library;
+}
+
+void FormulaLibrary_delete(FormulaLibrary *library) {
+
+    size_t i;
+
+    for (i = 0; i < library->formulaNames.count; ++i) {
+        if (library->formulas[i].program != null) {
+            CompiledExpression_delete(library->formulas[i].program);
+        }
+    }
+    Memory_free(library->formulas);
+    FormulaNameTable_finalize(&library->formulaNames);
+    FormulaNameTable_finalize(&library->inputNames);
+    Memory_free(library->references);
+    Memory_free(library->order);
+    Memory_free(library->levelStarts);
+    FormulaErrorStack_finalize(&library->errors);
+    Memory_free(library->text);
+    if (library->pool != null) {
+        ThreadPool_delete(library->pool);
+    }
+
+    Memory_free(library);
+}
+
+size_t FormulaLibrary_getCount(FormulaLibrary *library) {
+    return library->formulaNames.count;
+}
+
+string FormulaLibrary_getName(FormulaLibrary *library, size_t index) {
+    return library->formulaNames.names[index].name;
+}
+
+size_t FormulaLibrary_getLine(FormulaLibrary *library, size_t index) {
+    return library->formulas[index].line;
+}
+
+/**
+ * Get the result of loading a formula, which is
+ * EVALUATION_ERROR_CIRCULAR_REFERENCE if it references itself, directly
+ * or not, or a formula that does.
+ */
+EvaluationResult FormulaLibrary_getResult(FormulaLibrary *library,
+        size_t index) {
+    return library->formulas[index].result;
+}
+
+/**
+ * Get the compiled program of a formula, whose variables are the
+ * formulas and inputs it references.
+ * @return The program, owned by the library, or null if the formula
+ *         failed to compile.
+ */
+CompiledExpression *FormulaLibrary_getProgram(FormulaLibrary *library,
+        size_t index) {
+    return library->formulas[index].program;
+}
+
+/**
+ * Get the index of a formula by its name.
+ * @return The index of the formula, or -1 if the library does not have
+ *         it.
+ */
+size_t FormulaLibrary_indexOf(FormulaLibrary *library, string name) {
+    return FormulaNameTable_find(&library->formulaNames, name,
+            string_hash(name));
+}
+
+size_t FormulaLibrary_getInputCount(FormulaLibrary *library) {
+    return library->inputNames.count;
+}
+
+string FormulaLibrary_getInputName(FormulaLibrary *library,
+        size_t index) {
+    return library->inputNames.names[index].name;
+}
+
+/**
+ * Get the index of an input by its name.
+ * @return The index of the input, or -1 if no formula references it.
+ */
+size_t FormulaLibrary_indexOfInput(FormulaLibrary *library,
+        string name) {
+    return FormulaNameTable_find(&library->inputNames, name,
+            string_hash(name));
+}
+
+size_t FormulaLibrary_getErrorCount(FormulaLibrary *library) {
+    return library->errors.size;
+}
+
+/**
+ * Get the errors found when loading a library, in order of their lines.
+ */
+FormulaError *FormulaLibrary_getErrors(FormulaLibrary *library) {
+    return library->errors.array;
+}
+
+static void FormulaLibrary_evaluateRange(void *data, size_t start,
+        size_t end) {
+
+    FormulaEvaluation *evaluation = data;
+    FormulaLibrary *library = evaluation->library;
+    size_t count = library->formulaNames.count, variableCount, index,
+            reference, i, j;
+    Formula *formula;
+    EvaluationResult result;
+    Operand *referenceValues, value;
+
+    for (i = start; i < end; ++i) {
+        index = library->order[i];
+        formula = &library->formulas[index];
+        result = formula->result;
+        value = 0;
+        if (result == EVALUATION_SUCCESS) {
+            variableCount = CompiledExpression_getVariableCount(
+                    formula->program);
+            referenceValues = reserveScratchStack(SCRATCH_STACK_VARIABLES,
+                    variableCount);
+            for (j = 0; j < variableCount; ++j) {
+                reference = formula->references[j];
+                if (reference >= count) {
+                    referenceValues[j] =
+                            evaluation->inputValues[reference - count];
+                } else if (evaluation->results[reference]
+                        == EVALUATION_SUCCESS) {
+                    referenceValues[j] = evaluation->values[reference];
+                } else {
+                    result = evaluation->results[reference];
+                    break;
+                }
+            }
+            if (result == EVALUATION_SUCCESS) {
+                result = evaluateCompiled(formula->program,
+                        referenceValues, &value);
+            }
+        }
+        evaluation->values[index] = result == EVALUATION_SUCCESS ? value
+                : 0;
+        evaluation->results[index] = result;
+    }
+}
+
+/**
+ * Evaluate every formula of a library.
+ * @note Formulas are evaluated level by level, where a level only
+ *       references the levels before it, and the formulas of a wide
+ *       level are spread across threads. A formula referencing one
+ *       that failed fails with its result.
+ * @param inputValues The value of each input, by its index.
+ * @param values The value of each formula by its index, or 0 if it
+ *        failed.
+ * @param results The result of each formula by its index.
+ */
+void FormulaLibrary_evaluate(FormulaLibrary *library,
+        const Operand *inputValues, Operand *values,
+        EvaluationResult *results) {
+
+    FormulaEvaluation evaluation = {library, inputValues, values,
+            results};
+    size_t i;
+
+    Formula_evaluateLevels(library->pool, library->levelStarts,
+            library->levelCount, FormulaLibrary_evaluateRange, &evaluation);
+
+    for (i = 0; i < library->formulaNames.count; ++i) {
+        if (library->formulas[i].result
+                == EVALUATION_ERROR_CIRCULAR_REFERENCE) {
+            values[i] = 0;
+            results[i] = EVALUATION_ERROR_CIRCULAR_REFERENCE;
+        }
+    }
+}
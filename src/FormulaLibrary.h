@@ -0,0 +1,85 @@
+/**
+ * @file FormulaLibrary.h
+ * @author: Zhang Hai
+ */
+
+/*
+ * Copyright (C) 2014 Zhang Hai
+ *
+ * This file is part of calc.
+ *
+ * calc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * calc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with calc.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _FORMULA_LIBRARY_H_
+#define _FORMULA_LIBRARY_H_
+
+
+#include "zhclib/Common.h"
+
+#include "Evaluator.h"
+
+
+/**
+ * A library of named formulas loaded from a text file of
+ * name = expression lines, where a formula can reference other
+ * formulas of the library by name.
+ */
+typedef struct tagFormulaLibrary FormulaLibrary;
+
+/**
+ * An error in a line of a formula library file.
+ */
+typedef struct {
+    /* Starting from 1. */
+    size_t line;
+    EvaluationResult result;
+} FormulaError;
+
+
+FormulaLibrary *FormulaLibrary_load(string path, size_t threadCount);
+
+void FormulaLibrary_delete(FormulaLibrary *library);
+
+size_t FormulaLibrary_getCount(FormulaLibrary *library);
+
+string FormulaLibrary_getName(FormulaLibrary *library, size_t index);
+
+size_t FormulaLibrary_getLine(FormulaLibrary *library, size_t index);
+
+EvaluationResult FormulaLibrary_getResult(FormulaLibrary *library,
+        size_t index);
+
+CompiledExpression *FormulaLibrary_getProgram(FormulaLibrary *library,
+        size_t index);
+
+size_t FormulaLibrary_indexOf(FormulaLibrary *library, string name);
+
+size_t FormulaLibrary_getInputCount(FormulaLibrary *library);
+
+string FormulaLibrary_getInputName(FormulaLibrary *library, size_t index);
+
+size_t FormulaLibrary_indexOfInput(FormulaLibrary *library, string name);
+
+size_t FormulaLibrary_getErrorCount(FormulaLibrary *library);
+
+FormulaError *FormulaLibrary_getErrors(FormulaLibrary *library);
+
+void FormulaLibrary_evaluate(FormulaLibrary *library,
+        const Operand *inputValues, Operand *values,
+        EvaluationResult *results);
+
+
+#endif /* _FORMULA_LIBRARY_H_ */
@@ -0,0 +1,231 @@
+/**
+ * @file FunctionRegistry.c
+ * @author: Zhang Hai
+ */
+
+/*
+ * Copyright (C) 2014 Zhang Hai
+ *
+ * This file is part of calc.
+ *
+ * calc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * calc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with calc.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "FunctionRegistry.h"
+
+#include <pthread.h>
+#include <strings.h>
+
+
+/* Slot count of the table before any function is registered. */
+#define INITIAL_SLOT_COUNT 64
+
+
+/**
+ * A slot of the table of function names, which is open-addressed with
+ * linear probing and kept at most half full.
+ */
+typedef struct {
+    /* Name of the function, not owned; null for an empty slot. */
+    string name;
+    size_t length;
+    Operator operator;
+} FunctionSlot;
+
+typedef struct {
+    string name;
+    size_t operandCount;
+    UserFunction function;
+} UserFunctionEntry;
+
+
+static FunctionSlot *slots;
+
+static size_t slotCount;
+
+static size_t usedSlotCount;
+
+static UserFunctionEntry *userFunctions;
+
+static size_t userFunctionCount;
+
+static size_t allocatedUserFunctionCount;
+
+static pthread_once_t initializeOnce = PTHREAD_ONCE_INIT;
+
+
+/**
+ * Hash a function name, ignoring the case of its letters.
+ * @note Setting bit 5 lowercases a letter and leaves digits alone,
+ *       while '_' becomes DEL, which is never in a name.
+ */
+static size_t FunctionRegistry_hash(const char *name, size_t length) {
+
+    size_t hash = 0, i;
+
+    for (i = 0; i < length; ++i) {
+        hash = hash * 31 + (size_t)(name[i] | 0x20);
+    }
+
+    return hash * (size_t)11400714819323198485ULL;
+}
+
+static FunctionSlot *FunctionRegistry_findSlot(const char *name,
+        size_t length) {
+
+    /* Slot count is always a power of two. */
+    size_t mask = slotCount - 1,
+            index = FunctionRegistry_hash(name, length) & mask;
+
+    while (slots[index].name != null
+            && !(slots[index].length == length
+                    && strncasecmp(slots[index].name, name, length)
+                            == 0)) {
+        index = (index + 1) & mask;
+    }
+
+    return &slots[index];
+}
+
+static void FunctionRegistry_insert(string name, Operator operator) {
+
+    FunctionSlot *oldSlots = slots, *slot;
+    size_t oldSlotCount = slotCount, i;
+
+    if (2 * (usedSlotCount + 1) > slotCount) {
+        slotCount = slotCount == 0 ? INITIAL_SLOT_COUNT : 2 * slotCount;
+        slots = Memory_allocate(slotCount * sizeof(FunctionSlot));
+        for (i = 0; i < oldSlotCount; ++i) {
+            if (oldSlots[i].name != null) {
+                *FunctionRegistry_findSlot(oldSlots[i].name,
+                        oldSlots[i].length) = oldSlots[i];
+            }
+        }
+        Memory_free(oldSlots);
+    }
+
+    slot = FunctionRegistry_findSlot(name, string_length(name));
+    slot->name = name;
+    slot->length = string_length(name);
+    slot->operator = operator;
+    ++usedSlotCount;
+}
+
+static void FunctionRegistry_initialize() {
+
+    Operator operator;
+
+    for (operator = OPERATOR_SIN; operator <= OPERATOR_MAX; ++operator) {
+        FunctionRegistry_insert(Operator_getString(operator), operator);
+    }
+}
+
+static bool FunctionRegistry_isName(string name) {
+
+    size_t i;
+
+    for (i = 0; name[i] != '\0'; ++i) {
+        if (!((name[i] >= 'a' && name[i] <= 'z')
+                || (name[i] >= 'A' && name[i] <= 'Z') || name[i] == '_'
+                || (i > 0 && name[i] >= '0' && name[i] <= '9'))) {
+            return false;
+        }
+    }
+
+    return i > 0;
+}
+
+/**
+ * Find the function with a name, ignoring case.
+ * @note This is a single probe of a hash table in the common case, so
+ *       that the number of functions does not slow down compilation.
+ * @param name The name of the function, not necessarily
+ *        null-terminated.
+ * @param length The length of the name.
+ * @param operator The operator of the function.
+ * @return Whether there is such a function.
+ */
+bool FunctionRegistry_find(const char *name, size_t length,
+        Operator *operator) {
+
+    FunctionSlot *slot;
+
+    pthread_once(&initializeOnce, FunctionRegistry_initialize);
+
+    slot = FunctionRegistry_findSlot(name, length);
+    if (slot->name == null) {
+        return false;
+    }
+    *operator = slot->operator;
+    return true;
+}
+
+string FunctionRegistry_getName(Operator operator) {
+    return userFunctions[operator - OPERATOR_FIRST_USER_FUNCTION].name;
+}
+
+size_t FunctionRegistry_getOperandCount(Operator operator) {
+    return userFunctions[operator - OPERATOR_FIRST_USER_FUNCTION]
+            .operandCount;
+}
+
+UserFunction FunctionRegistry_getFunction(Operator operator) {
+    return userFunctions[operator - OPERATOR_FIRST_USER_FUNCTION]
+            .function;
+}
+
+/**
+ * Register a C function to be called from expressions by name, like
+ * the built-in functions.
+ * @note Functions should be registered before expressions that use
+ *       them are compiled, and not while other threads compile or
+ *       evaluate expressions.
+ * @note A function should be pure, since a repeated call with the same
+ *       operands is evaluated only once. Its partial derivatives are
+ *       unknown, so gradients that depend on it are NaN.
+ * @param name The name of the function, which is matched ignoring case.
+ * @param operandCount The number of operands of the function, from 1
+ *        to OPERATOR_MAXIMUM_OPERAND_COUNT.
+ * @param function The function, which receives the operands in the
+ *        order they appear in the expression.
+ * @return Whether the function was registered, which it is not if the
+ *         name is not an identifier or is already taken.
+ */
+bool registerFunction(string name, size_t operandCount,
+        UserFunction function) {
+
+    Operator operator;
+
+    if (!FunctionRegistry_isName(name) || operandCount == 0
+            || operandCount > OPERATOR_MAXIMUM_OPERAND_COUNT
+            || FunctionRegistry_find(name, string_length(name),
+                    &operator)) {
+        return false;
+    }
+
+    if (userFunctionCount == allocatedUserFunctionCount) {
+        allocatedUserFunctionCount = allocatedUserFunctionCount == 0 ? 8
+                : 2 * allocatedUserFunctionCount;
+        userFunctions = Memory_reallocate(userFunctions,
+                allocatedUserFunctionCount * sizeof(UserFunctionEntry));
+    }
+    userFunctions[userFunctionCount].name = string_clone(name);
+    userFunctions[userFunctionCount].operandCount = operandCount;
+    userFunctions[userFunctionCount].function = function;
+
+    FunctionRegistry_insert(userFunctions[userFunctionCount].name,
+            OPERATOR_FIRST_USER_FUNCTION + userFunctionCount);
+    ++userFunctionCount;
+    return true;
+}
@@ -0,0 +1,45 @@
+/**
+ * @file FunctionRegistry.h
+ * @author: Zhang Hai
+ */
+
+/*
+ * Copyright (C) 2014 Zhang Hai
+ *
+ * This file is part of calc.
+ *
+ * calc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * calc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with calc.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _FUNCTION_REGISTRY_H_
+#define _FUNCTION_REGISTRY_H_
+
+
+#include "zhclib/Common.h"
+
+#include "Evaluator.h"
+#include "Operator.h"
+
+
+bool FunctionRegistry_find(const char *name, size_t length,
+        Operator *operator);
+
+string FunctionRegistry_getName(Operator operator);
+
+size_t FunctionRegistry_getOperandCount(Operator operator);
+
+UserFunction FunctionRegistry_getFunction(Operator operator);
+
+
+#endif /* _FUNCTION_REGISTRY_H_ */
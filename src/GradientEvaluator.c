@@ -0,0 +1,176 @@
+/**
+ * @file GradientEvaluator.c
+ * @author: Zhang Hai
+ */
+
+/*
+ * Copyright (C) 2014 Zhang Hai
+ *
+ * This file is part of calc.
+ *
+ * calc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * calc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with calc.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Evaluator.h"
+
+#include "CompiledExpression.h"
+#include "Operator.h"
+#include "Statistics.h"
+
+#include <string.h>
+
+
+/**
+ * Evaluate a program with dual numbers, carrying a number of tangents
+ * alongside each value.
+ * @note A tangent term is only added where the tangent is not zero,
+ *       so that a partial derivative that does not exist only spoils
+ *       the tangents that depend on it.
+ * @param seeds The tangents of each variable, tangentCount per
+ *        variable, or null for the unit tangents of the gradient.
+ * @param tangents The tangents of the value.
+ */
+static EvaluationResult evaluateDual(CompiledExpression *program,
+        Operand *variableValues, const Operand *seeds,
+        size_t tangentCount, Operand *value, Operand *tangents) {
+
+    size_t slotSize = 1 + tangentCount, variable, operandCount, i, j;
+    Operand *stack, *top, *temporaries, *operand,
+            operands[OPERATOR_MAXIMUM_OPERAND_COUNT],
+            partials[OPERATOR_MAXIMUM_OPERAND_COUNT], theValue;
+    Instruction *instruction = program->instructions,
+            *end = instruction + program->instructionCount;
+    EvaluationResult result;
+
+    /* Each slot has its value followed by its tangents. */
+    stack = reserveScratchStack(SCRATCH_STACK_DUALS,
+            (program->stackDepth + program->temporaryCount) * slotSize);
+    top = stack;
+    temporaries = stack + program->stackDepth * slotSize;
+
+    for (; instruction != end; ++instruction) {
+        switch (instruction->type) {
+        case INSTRUCTION_CONSTANT:
+            top[0] = instruction->argument.constant;
+            for (i = 1; i < slotSize; ++i) {
+                top[i] = 0;
+            }
+            top += slotSize;
+            break;
+        case INSTRUCTION_VARIABLE:
+            variable = instruction->argument.variable;
+            top[0] = variableValues[variable];
+            for (i = 0; i < tangentCount; ++i) {
+                top[1 + i] = seeds == null ? i == variable
+                        : seeds[variable * tangentCount + i];
+            }
+            top += slotSize;
+            break;
+        case INSTRUCTION_OPERATOR:
+            operandCount = Operator_getOperandCount(
+                    instruction->operator);
+            top -= operandCount * slotSize;
+            for (j = 0; j < operandCount; ++j) {
+                operands[j] = top[j * slotSize];
+            }
+            result = Operator_evaluate(instruction->operator, operands,
+                    &theValue);
+            if (result != EVALUATION_SUCCESS) {
+                return result;
+            }
+            Operator_differentiate(instruction->operator, operands,
+                    theValue, partials);
+            top[0] = theValue;
+            for (i = 1; i < slotSize; ++i) {
+                if (top[i] != 0) {
+                    top[i] *= partials[0];
+                }
+            }
+            for (j = 1; j < operandCount; ++j) {
+                operand = top + j * slotSize;
+                for (i = 1; i < slotSize; ++i) {
+                    if (operand[i] != 0) {
+                        top[i] += partials[j] * operand[i];
+                    }
+                }
+            }
+            top += slotSize;
+            break;
+        case INSTRUCTION_STORE:
+            memcpy(temporaries + instruction->argument.temporary
+                    * slotSize, top - slotSize, slotSize * sizeof(Operand));
+            break;
+        case INSTRUCTION_LOAD:
+            memcpy(top, temporaries + instruction->argument.temporary
+                    * slotSize, slotSize * sizeof(Operand));
+            top += slotSize;
+            break;
+        }
+    }
+
+    *value = stack[0];
+    for (i = 0; i < tangentCount; ++i) {
+        tangents[i] = stack[1 + i];
+    }
+    return EVALUATION_SUCCESS;
+}
+
+/**
+ * Evaluate a compiled program together with its gradient, in a single
+ * pass with forward-mode automatic differentiation.
+ * @note The value is computed with doubles. Exact integer and rational
+ *       results only come from {@link evaluateCompiled}, so the value
+ *       can differ from it by far more than the last place.
+ * @param program The program returned by {@link compileExpression}.
+ * @param variableValues The values of the variables, indexed by their
+ *        slots.
+ * @param value The value of the expression.
+ * @param gradient The partial derivative of the expression with
+ *        respect to each variable, indexed by their slots.
+ */
+EvaluationResult evaluateGradient(CompiledExpression *program,
+        Operand *variableValues, Operand *value, Operand *gradient) {
+
+    EvaluationResult result;
+    STATISTICS_DECLARE_TIME(start);
+
+    STATISTICS_START(start);
+    result = evaluateDual(program, variableValues, null,
+            program->variableCount, value, gradient);
+    STATISTICS_ADD_PHASE(STATISTICS_PHASE_EVALUATE, start);
+
+    return result;
+}
+
+/**
+ * Evaluate a compiled program together with its derivative along a
+ * direction, with a single dual number per value.
+ * @see evaluateGradient
+ * @param direction The direction, with a component for each variable.
+ * @param derivative The directional derivative of the expression.
+ */
+EvaluationResult evaluateDirectionalDerivative(
+        CompiledExpression *program, Operand *variableValues,
+        const Operand *direction, Operand *value, Operand *derivative) {
+
+    EvaluationResult result;
+    STATISTICS_DECLARE_TIME(start);
+
+    STATISTICS_START(start);
+    result = evaluateDual(program, variableValues, direction, 1, value,
+            derivative);
+    STATISTICS_ADD_PHASE(STATISTICS_PHASE_EVALUATE, start);
+
+    return result;
+}
@@ -0,0 +1,193 @@
+/**
+ * @file Lexer.c
+ * @author: Zhang Hai
+ */
+
+/*
+ * Copyright (C) 2014 Zhang Hai
+ *
+ * This file is part of calc.
+ *
+ * calc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * calc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with calc.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Lexer.h"
+
+#include <strings.h>
+
+#include "Statistics.h"
+
+
+static bool Lexer_isDigit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+static bool Lexer_isWhitespace(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+static bool Lexer_isIdentifierStart(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+}
+
+static bool Lexer_isIdentifierPart(char c) {
+    return Lexer_isIdentifierStart(c) || Lexer_isDigit(c);
+}
+
+/**
+ * Read a number token, which is anything that looks like a number so
+ * that the operand parser can decide whether it is valid.
+ * @note Like the pp-number of C, this accepts a sign only after an
+ *       exponent character, so that "1e-5" is a single token.
+ */
+static size_t Lexer_readNumber(Lexer *lexer) {
+
+    string text = lexer->text;
+    size_t start = lexer->position, position = start;
+    bool hexadecimal = position + 1 < lexer->length
+            && text[position] == '0'
+            && (text[position + 1] == 'x' || text[position + 1] == 'X');
+    char c;
+
+    while (position < lexer->length) {
+        c = text[position];
+        if (Lexer_isIdentifierPart(c) || c == '.') {
+            ++position;
+        } else if ((c == '+' || c == '-') && position > start
+                && (hexadecimal ? (text[position - 1] == 'p'
+                                || text[position - 1] == 'P')
+                        : (text[position - 1] == 'e'
+                                || text[position - 1] == 'E'))) {
+            ++position;
+        } else {
+            break;
+        }
+    }
+
+    return position - start;
+}
+
+static size_t Lexer_readIdentifier(Lexer *lexer) {
+    size_t position = lexer->position + 1;
+    while (position < lexer->length
+            && Lexer_isIdentifierPart(lexer->text[position])) {
+        ++position;
+    }
+    return position - lexer->position;
+}
+
+void Lexer_initialize(Lexer *lexer, string text, size_t length) {
+    lexer->text = text;
+    lexer->length = length;
+    lexer->position = 0;
+}
+
+static TokenType Lexer_read(Lexer *lexer, Token *token) {
+
+    char c;
+
+    while (lexer->position < lexer->length
+            && Lexer_isWhitespace(lexer->text[lexer->position])) {
+        ++lexer->position;
+    }
+
+    token->start = lexer->position;
+    token->length = 1;
+
+    if (lexer->position >= lexer->length) {
+        token->length = 0;
+        return token->type = TOKEN_END;
+    }
+
+    c = lexer->text[lexer->position];
+    switch (c) {
+    case '+':
+    case '-':
+    case '*':
+    case '/':
+    case '^':
+    case '!':
+        token->type = TOKEN_OPERATOR;
+        break;
+    case '(':
+        token->type = TOKEN_PARENTHESIS_LEFT;
+        break;
+    case ')':
+        token->type = TOKEN_PARENTHESIS_RIGHT;
+        break;
+    case ',':
+        token->type = TOKEN_COMMA;
+        break;
+    default:
+        if (Lexer_isDigit(c) || (c == '.'
+                && lexer->position + 1 < lexer->length
+                && Lexer_isDigit(lexer->text[lexer->position + 1]))) {
+            token->type = TOKEN_NUMBER;
+            token->length = Lexer_readNumber(lexer);
+        } else if (Lexer_isIdentifierStart(c)) {
+            token->type = TOKEN_IDENTIFIER;
+            token->length = Lexer_readIdentifier(lexer);
+        } else {
+            token->type = TOKEN_INVALID;
+        }
+    }
+
+    lexer->position += token->length;
+    return token->type;
+}
+
+/**
+ * Read the next token from a {@link Lexer}, skipping whitespace
+ * before it.
+ * @note Each character of the input is examined only once, so
+ *       tokenizing is linear in the input length.
+ * @param token The token read, with TOKEN_END at end of input.
+ * @return The type of the token read.
+ */
+TokenType Lexer_next(Lexer *lexer, Token *token) {
+
+    TokenType type;
+    STATISTICS_DECLARE_TIME(start);
+
+    STATISTICS_START(start);
+    type = Lexer_read(lexer, token);
+    STATISTICS_ADD_PHASE(STATISTICS_PHASE_LEX, start);
+
+    return type;
+}
+
+/**
+ * Read the next token from a {@link Lexer} without consuming it.
+ */
+TokenType Lexer_peek(Lexer *lexer, Token *token) {
+    size_t position = lexer->position;
+    TokenType type = Lexer_next(lexer, token);
+    lexer->position = position;
+    return type;
+}
+
+/**
+ * Get the text of a token.
+ * @note The returned string is not null-terminated at the end of the
+ *       token; use the length of the token instead.
+ */
+string Token_getText(Token *token, Lexer *lexer) {
+    return lexer->text + token->start;
+}
+
+bool Token_isEqualIgnoreCase(Token *token, Lexer *lexer, string text) {
+    return string_length(text) == token->length
+            && strncasecmp(Token_getText(token, lexer), text,
+                    token->length) == 0;
+}
@@ -0,0 +1,70 @@
+/**
+ * @file Lexer.h
+ * @author: Zhang Hai
+ */
+
+/*
+ * Copyright (C) 2014 Zhang Hai
+ *
+ * This file is part of calc.
+ *
+ * calc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * calc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with calc.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _LEXER_H_
+#define _LEXER_H_
+
+
+#include "zhclib/Common.h"
+
+
+typedef enum {
+    TOKEN_NUMBER,
+    TOKEN_IDENTIFIER,
+    TOKEN_OPERATOR,
+    TOKEN_PARENTHESIS_LEFT,
+    TOKEN_PARENTHESIS_RIGHT,
+    TOKEN_COMMA,
+    TOKEN_INVALID,
+    TOKEN_END
+} TokenType;
+
+/**
+ * A token, referencing its text by offset into the lexer input.
+ */
+typedef struct {
+    TokenType type;
+    size_t start;
+    size_t length;
+} Token;
+
+typedef struct {
+    string text;
+    size_t length;
+    size_t position;
+} Lexer;
+
+
+void Lexer_initialize(Lexer *lexer, string text, size_t length);
+
+TokenType Lexer_next(Lexer *lexer, Token *token);
+
+TokenType Lexer_peek(Lexer *lexer, Token *token);
+
+string Token_getText(Token *token, Lexer *lexer);
+
+bool Token_isEqualIgnoreCase(Token *token, Lexer *lexer, string text);
+
+
+#endif /* _LEXER_H_ */
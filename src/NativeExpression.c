@@ -0,0 +1,610 @@
+/**
+ * @file NativeExpression.c
+ * @author: Zhang Hai
+ */
+
+/*
+ * Copyright (C) 2014 Zhang Hai
+ *
+ * This file is part of calc.
+ *
+ * calc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * calc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with calc.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "Evaluator.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "CompiledExpression.h"
+#include "FunctionRegistry.h"
+#include "Operator.h"
+
+/*
+ * Native code is generated for x86-64 with the System V calling
+ * convention; elsewhere, or with __DISABLE_JIT__, expressions are
+ * interpreted.
+ */
+#if defined(__x86_64__) && !defined(_WIN32) && !defined(__DISABLE_JIT__)
+#define JIT_SUPPORTED
+#include <sys/mman.h>
+#endif
+
+
+typedef struct tagNativeExpression {
+    CompiledExpression *program;
+    NativeFunction function;
+    void *code;
+    size_t codeSize;
+} NativeExpression;
+
+
+#ifdef JIT_SUPPORTED
+
+/*
+ * Operators that can fail are evaluated through Operator_evaluate, so
+ * that native code agrees with the interpreter on their domain. A
+ * failure sets a flag in the stack frame of the native function, which
+ * then returns NaN whatever the later operators make of the value, as
+ * the interpreter stops at the first error.
+ */
+
+static double NativeExpression_evaluateFailable(Operator operator,
+        double operand1, double operand2, bool *failed) {
+    Operand operands[2] = {operand1, operand2}, value;
+    if (Operator_evaluate(operator, operands, &value)
+            != EVALUATION_SUCCESS) {
+        *failed = true;
+        return NAN;
+    }
+    return value;
+}
+
+static double NativeExpression_factorial(double operand, bool *failed) {
+    return NativeExpression_evaluateFailable(OPERATOR_FACTORIAL,
+            operand, 0, failed);
+}
+
+static double NativeExpression_log(double base, double operand,
+        bool *failed) {
+    return NativeExpression_evaluateFailable(OPERATOR_LOG, base,
+            operand, failed);
+}
+
+static double NativeExpression_ln(double operand, bool *failed) {
+    return NativeExpression_evaluateFailable(OPERATOR_LN, operand, 0,
+            failed);
+}
+
+static double NativeExpression_sqrt(double operand, bool *failed) {
+    return NativeExpression_evaluateFailable(OPERATOR_SQRT, operand, 0,
+            failed);
+}
+
+static double NativeExpression_asin(double operand, bool *failed) {
+    return NativeExpression_evaluateFailable(OPERATOR_ASIN, operand, 0,
+            failed);
+}
+
+static double NativeExpression_acos(double operand, bool *failed) {
+    return NativeExpression_evaluateFailable(OPERATOR_ACOS, operand, 0,
+            failed);
+}
+
+
+/*
+ * Upper bound of the bytes emitted for one instruction, which is a call
+ * of two operands that can fail: two loads, lea, mov rax, call and a
+ * store.
+ */
+#define JIT_MAXIMUM_INSTRUCTION_SIZE 47
+
+/*
+ * Upper bound of the bytes emitted outside the instructions: the
+ * prologue, clearing the failure flag, loading the result, checking
+ * the failure flag and the epilogue.
+ */
+#define JIT_FRAME_CODE_SIZE 67
+
+/* No failure flag, for an operator that cannot fail. */
+#define JIT_NO_SLOT ((size_t)-1)
+
+/*
+ * Largest stack frame of native code, which is reserved at once without
+ * probing; a larger one could skip over the guard page of the stack of
+ * a thread, so such a program is interpreted instead.
+ */
+#define JIT_MAXIMUM_FRAME_SIZE 4096
+
+
+typedef struct {
+    uint8_t *code;
+    size_t size;
+} Assembler;
+
+
+static void Assembler_emitBytes(Assembler *assembler, const uint8_t *bytes,
+        size_t count) {
+    memcpy(assembler->code + assembler->size, bytes, count);
+    assembler->size += count;
+}
+
+static void Assembler_emitInt32(Assembler *assembler, int32_t value) {
+    Assembler_emitBytes(assembler, (uint8_t *)&value, sizeof(value));
+}
+
+static void Assembler_emitInt64(Assembler *assembler, int64_t value) {
+    Assembler_emitBytes(assembler, (uint8_t *)&value, sizeof(value));
+}
+
+/**
+ * Emit an instruction with a [rsp + displacement] memory operand.
+ * @param prefix The bytes of the instruction before its ModRM byte.
+ * @param reg The register field of the ModRM byte.
+ */
+static void Assembler_emitStackAccess(Assembler *assembler,
+        const uint8_t *prefix, size_t prefixCount, uint8_t reg,
+        size_t slot) {
+    uint8_t addressing[] = {0x84 | reg << 3, 0x24};
+    Assembler_emitBytes(assembler, prefix, prefixCount);
+    Assembler_emitBytes(assembler, addressing, sizeof(addressing));
+    Assembler_emitInt32(assembler, (int32_t)(slot * sizeof(Operand)));
+}
+
+/* movsd xmm<reg>, [rsp + 8 * slot] */
+static void Assembler_loadSlot(Assembler *assembler, uint8_t reg,
+        size_t slot) {
+    static const uint8_t MOVSD_LOAD[] = {0xF2, 0x0F, 0x10};
+    Assembler_emitStackAccess(assembler, MOVSD_LOAD, sizeof(MOVSD_LOAD),
+            reg, slot);
+}
+
+/* movsd [rsp + 8 * slot], xmm0 */
+static void Assembler_storeSlot(Assembler *assembler, size_t slot) {
+    static const uint8_t MOVSD_STORE[] = {0xF2, 0x0F, 0x11};
+    Assembler_emitStackAccess(assembler, MOVSD_STORE,
+            sizeof(MOVSD_STORE), 0, slot);
+}
+
+/* mov rax, imm64 */
+static void Assembler_loadRax(Assembler *assembler, int64_t value) {
+    static const uint8_t MOV_RAX[] = {0x48, 0xB8};
+    Assembler_emitBytes(assembler, MOV_RAX, sizeof(MOV_RAX));
+    Assembler_emitInt64(assembler, value);
+}
+
+/**
+ * Emit arithmetic on xmm0 with the slot above it, keeping the result
+ * in the lower slot.
+ * @param opcode The opcode of the SSE2 scalar double instruction.
+ */
+static void Assembler_emitArithmetic(Assembler *assembler,
+        uint8_t opcode, size_t slot) {
+    uint8_t arithmetic[] = {0xF2, 0x0F, opcode};
+    Assembler_loadSlot(assembler, 0, slot);
+    Assembler_emitStackAccess(assembler, arithmetic, sizeof(arithmetic),
+            0, slot + 1);
+    Assembler_storeSlot(assembler, slot);
+}
+
+/**
+ * Emit a call to a C function of one or two doubles on the slots
+ * starting at slot, keeping the result in slot.
+ * @param failedSlot The slot of the failure flag, passed by its address
+ *        after the doubles, or JIT_NO_SLOT if the function cannot fail.
+ */
+static void Assembler_emitCall(Assembler *assembler, void *function,
+        size_t operandCount, size_t slot, size_t failedSlot) {
+    /* lea rdi, [rsp + 8 * failedSlot] */
+    static const uint8_t LEA_RDI[] = {0x48, 0x8D};
+    static const uint8_t CALL_RAX[] = {0xFF, 0xD0};
+    Assembler_loadSlot(assembler, 0, slot);
+    if (operandCount == 2) {
+        Assembler_loadSlot(assembler, 1, slot + 1);
+    }
+    if (failedSlot != JIT_NO_SLOT) {
+        Assembler_emitStackAccess(assembler, LEA_RDI, sizeof(LEA_RDI), 7,
+                failedSlot);
+    }
+    Assembler_loadRax(assembler, (int64_t)(intptr_t)function);
+    Assembler_emitBytes(assembler, CALL_RAX, sizeof(CALL_RAX));
+    Assembler_storeSlot(assembler, slot);
+}
+
+/**
+ * Emit a call to a registered function, which takes a pointer to its
+ * operands on the slots starting at slot, keeping the result in slot.
+ */
+static void Assembler_emitUserCall(Assembler *assembler,
+        UserFunction function, size_t slot) {
+    /* lea rdi, [rsp + 8 * slot] */
+    static const uint8_t LEA_RDI[] = {0x48, 0x8D};
+    static const uint8_t CALL_RAX[] = {0xFF, 0xD0};
+    Assembler_emitStackAccess(assembler, LEA_RDI, sizeof(LEA_RDI), 7,
+            slot);
+    Assembler_loadRax(assembler, (int64_t)(intptr_t)function);
+    Assembler_emitBytes(assembler, CALL_RAX, sizeof(CALL_RAX));
+    Assembler_storeSlot(assembler, slot);
+}
+
+static double NativeExpression_evaluateOperator(Operator operator,
+        double operand1, double operand2) {
+    Operand operands[2] = {operand1, operand2}, value;
+    Operator_evaluate(operator, operands, &value);
+    return value;
+}
+
+static double NativeExpression_min(double operand1, double operand2) {
+    return NativeExpression_evaluateOperator(OPERATOR_MIN, operand1,
+            operand2);
+}
+
+static double NativeExpression_max(double operand1, double operand2) {
+    return NativeExpression_evaluateOperator(OPERATOR_MAX, operand1,
+            operand2);
+}
+
+static bool NativeExpression_canFail(Operator operator) {
+    switch (operator) {
+    case OPERATOR_FACTORIAL:
+    case OPERATOR_LOG:
+    case OPERATOR_LN:
+    case OPERATOR_SQRT:
+    case OPERATOR_ASIN:
+    case OPERATOR_ACOS:
+        return true;
+    default:
+        return false;
+    }
+}
+
+static void *NativeExpression_getOperatorFunction(Operator operator) {
+    switch (operator) {
+    case OPERATOR_POWER:
+    case OPERATOR_POW:
+        return (void *)pow;
+    case OPERATOR_FACTORIAL:
+        return (void *)NativeExpression_factorial;
+    case OPERATOR_SIN:
+        return (void *)sin;
+    case OPERATOR_COS:
+        return (void *)cos;
+    case OPERATOR_TAN:
+        return (void *)tan;
+    case OPERATOR_LOG:
+        return (void *)NativeExpression_log;
+    case OPERATOR_EXP:
+        return (void *)exp;
+    case OPERATOR_LN:
+        return (void *)NativeExpression_ln;
+    case OPERATOR_SQRT:
+        return (void *)NativeExpression_sqrt;
+    case OPERATOR_ABS:
+        return (void *)fabs;
+    case OPERATOR_ASIN:
+        return (void *)NativeExpression_asin;
+    case OPERATOR_ACOS:
+        return (void *)NativeExpression_acos;
+    case OPERATOR_ATAN:
+        return (void *)atan;
+    case OPERATOR_ATAN2:
+        return (void *)atan2;
+    case OPERATOR_SINH:
+        return (void *)sinh;
+    case OPERATOR_COSH:
+        return (void *)cosh;
+    case OPERATOR_TANH:
+        return (void *)tanh;
+    case OPERATOR_FLOOR:
+        return (void *)floor;
+    case OPERATOR_CEIL:
+        return (void *)ceil;
+    case OPERATOR_MIN:
+        return (void *)NativeExpression_min;
+    case OPERATOR_MAX:
+        return (void *)NativeExpression_max;
+    default:
+        return null;
+    }
+}
+
+/**
+ * Get the slot of the failure flag of a program, after its operand
+ * stack and temporaries, or JIT_NO_SLOT if none of its operators can
+ * fail.
+ */
+static size_t NativeExpression_getFailedSlot(CompiledExpression *program) {
+
+    Instruction *instruction = program->instructions,
+            *end = instruction + program->instructionCount;
+
+    for (; instruction != end; ++instruction) {
+        if (instruction->type == INSTRUCTION_OPERATOR
+                && NativeExpression_canFail(instruction->operator)) {
+            return program->stackDepth + program->temporaryCount;
+        }
+    }
+    return JIT_NO_SLOT;
+}
+
+/**
+ * Get the size of the stack frame of the native code of a program,
+ * keeping rsp aligned to 16 bytes at calls after pushing rbx.
+ */
+static size_t NativeExpression_getFrameSize(CompiledExpression *program,
+        size_t failedSlot) {
+    return ((program->stackDepth + program->temporaryCount
+            + (failedSlot != JIT_NO_SLOT)) * sizeof(Operand) + 15)
+            & ~(size_t)15;
+}
+
+/**
+ * Translate a program into machine code.
+ * @note The operand stack lives in the stack frame, at offsets known
+ *       at compile time, so that no register has to survive a call
+ *       except rbx, which holds the variable values. The failure flag
+ *       follows the temporaries, if any operator can fail.
+ * @return Whether the program could be translated.
+ */
+static bool NativeExpression_assemble(CompiledExpression *program,
+        Assembler *assembler) {
+
+    /* push rbx; mov rbx, rdi; sub rsp, imm32 */
+    static const uint8_t PROLOGUE[] = {0x53, 0x48, 0x89, 0xFB, 0x48,
+            0x81, 0xEC};
+    /* add rsp, imm32 */
+    static const uint8_t EPILOGUE_ADD_RSP[] = {0x48, 0x81, 0xC4};
+    /* pop rbx; ret */
+    static const uint8_t EPILOGUE_RETURN[] = {0x5B, 0xC3};
+    /* movsd xmm0, [rbx + imm32] */
+    static const uint8_t LOAD_VARIABLE[] = {0xF2, 0x0F, 0x10, 0x83};
+    /* mov [rsp + imm32], rax; xor [rsp + imm32], rax */
+    static const uint8_t MOV_STORE_RAX[] = {0x48, 0x89};
+    static const uint8_t XOR_STORE_RAX[] = {0x48, 0x31};
+    /* mov qword [rsp + imm32], imm32; cmp qword [rsp + imm32], imm8 */
+    static const uint8_t MOV_STORE_IMMEDIATE[] = {0x48, 0xC7};
+    static const uint8_t CMP_IMMEDIATE[] = {0x48, 0x83};
+    static const uint8_t IMMEDIATE_ZERO[] = {0x00};
+    /* je over the next two instructions; movq xmm0, rax */
+    static const uint8_t JE_OVER_NAN[] = {0x74, 0x0F};
+    static const uint8_t MOVQ_XMM0_RAX[] = {0x66, 0x48, 0x0F, 0x6E, 0xC0};
+
+    Instruction *instruction = program->instructions,
+            *end = instruction + program->instructionCount;
+    size_t depth = 0, failedSlot = NativeExpression_getFailedSlot(program),
+            slot;
+    int32_t frameSize = (int32_t)NativeExpression_getFrameSize(program,
+            failedSlot);
+    Operator operator;
+    int64_t bits;
+    double nan = NAN;
+
+    Assembler_emitBytes(assembler, PROLOGUE, sizeof(PROLOGUE));
+    Assembler_emitInt32(assembler, frameSize);
+    if (failedSlot != JIT_NO_SLOT) {
+        Assembler_emitStackAccess(assembler, MOV_STORE_IMMEDIATE,
+                sizeof(MOV_STORE_IMMEDIATE), 0, failedSlot);
+        Assembler_emitInt32(assembler, 0);
+    }
+
+    for (; instruction != end; ++instruction) {
+        switch (instruction->type) {
+        case INSTRUCTION_CONSTANT:
+            memcpy(&bits, &instruction->argument.constant,
+                    sizeof(bits));
+            Assembler_loadRax(assembler, bits);
+            Assembler_emitStackAccess(assembler, MOV_STORE_RAX,
+                    sizeof(MOV_STORE_RAX), 0, depth++);
+            break;
+        case INSTRUCTION_VARIABLE:
+            Assembler_emitBytes(assembler, LOAD_VARIABLE,
+                    sizeof(LOAD_VARIABLE));
+            Assembler_emitInt32(assembler, (int32_t)(
+                    instruction->argument.variable * sizeof(Operand)));
+            Assembler_storeSlot(assembler, depth++);
+            break;
+        case INSTRUCTION_OPERATOR:
+            operator = instruction->operator;
+            depth -= Operator_getOperandCount(operator);
+            slot = depth++;
+            switch (operator) {
+            case OPERATOR_ADDITION:
+                Assembler_emitArithmetic(assembler, 0x58, slot);
+                break;
+            case OPERATOR_SUBTRACTION:
+                Assembler_emitArithmetic(assembler, 0x5C, slot);
+                break;
+            case OPERATOR_MULPLICATION:
+                Assembler_emitArithmetic(assembler, 0x59, slot);
+                break;
+            case OPERATOR_DIVISION:
+                Assembler_emitArithmetic(assembler, 0x5E, slot);
+                break;
+            case OPERATOR_NEGATIVE:
+                /* Flip the sign bit in place. */
+                Assembler_loadRax(assembler, INT64_MIN);
+                Assembler_emitStackAccess(assembler, XOR_STORE_RAX,
+                        sizeof(XOR_STORE_RAX), 0, slot);
+                break;
+            default:
+                if (operator >= OPERATOR_FIRST_USER_FUNCTION) {
+                    Assembler_emitUserCall(assembler,
+                            FunctionRegistry_getFunction(operator),
+                            slot);
+                    break;
+                }
+                if (NativeExpression_getOperatorFunction(operator)
+                        == null) {
+                    return false;
+                }
+                Assembler_emitCall(assembler,
+                        NativeExpression_getOperatorFunction(operator),
+                        Operator_getOperandCount(operator), slot,
+                        NativeExpression_canFail(operator) ? failedSlot
+                                : JIT_NO_SLOT);
+            }
+            break;
+        case INSTRUCTION_STORE:
+            /* Temporaries follow the operand stack in the frame. */
+            Assembler_loadSlot(assembler, 0, depth - 1);
+            Assembler_storeSlot(assembler, program->stackDepth
+                    + instruction->argument.temporary);
+            break;
+        case INSTRUCTION_LOAD:
+            Assembler_loadSlot(assembler, 0, program->stackDepth
+                    + instruction->argument.temporary);
+            Assembler_storeSlot(assembler, depth++);
+            break;
+        }
+    }
+
+    Assembler_loadSlot(assembler, 0, 0);
+    if (failedSlot != JIT_NO_SLOT) {
+        Assembler_emitStackAccess(assembler, CMP_IMMEDIATE,
+                sizeof(CMP_IMMEDIATE), 7, failedSlot);
+        Assembler_emitBytes(assembler, IMMEDIATE_ZERO,
+                sizeof(IMMEDIATE_ZERO));
+        Assembler_emitBytes(assembler, JE_OVER_NAN, sizeof(JE_OVER_NAN));
+        memcpy(&bits, &nan, sizeof(bits));
+        Assembler_loadRax(assembler, bits);
+        Assembler_emitBytes(assembler, MOVQ_XMM0_RAX,
+                sizeof(MOVQ_XMM0_RAX));
+    }
+    Assembler_emitBytes(assembler, EPILOGUE_ADD_RSP,
+            sizeof(EPILOGUE_ADD_RSP));
+    Assembler_emitInt32(assembler, frameSize);
+    Assembler_emitBytes(assembler, EPILOGUE_RETURN,
+            sizeof(EPILOGUE_RETURN));
+
+    return true;
+}
+
+/**
+ * Generate native code for a program into its own executable mapping,
+ * which is never writable and executable at the same time.
+ * @note A program whose operand stack would not fit in
+ *       JIT_MAXIMUM_FRAME_SIZE gets no native code.
+ * @note Each mapping takes at least a page and counts against the
+ *       limit on mappings of a process, vm.max_map_count on Linux
+ *       (65530 by default); past it, mmap fails and the program is
+ *       interpreted instead.
+ */
+static void NativeExpression_generate(NativeExpression *native) {
+
+    CompiledExpression *program = native->program;
+    size_t codeSize = program->instructionCount
+            * JIT_MAXIMUM_INSTRUCTION_SIZE + JIT_FRAME_CODE_SIZE;
+    Assembler assembler;
+    void *code;
+
+    if (NativeExpression_getFrameSize(program,
+            NativeExpression_getFailedSlot(program))
+            > JIT_MAXIMUM_FRAME_SIZE) {
+        return;
+    }
+
+    code = mmap(null, codeSize, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (code == MAP_FAILED) {
+        return;
+    }
+
+    assembler.code = code;
+    assembler.size = 0;
+    if (!NativeExpression_assemble(program, &assembler)
+            || mprotect(code, codeSize, PROT_READ | PROT_EXEC) != 0) {
+        munmap(code, codeSize);
+        return;
+    }
+
+    native->code = code;
+    native->codeSize = codeSize;
+    native->function = (NativeFunction)code;
+}
+
+#endif /* JIT_SUPPORTED */
+
+
+/**
+ * Compile a program further into native code.
+ * @note Where native code cannot be generated, as for a program
+ *       nested too deeply for the stack frame of native code, the
+ *       program is interpreted instead by
+ *       {@link NativeExpression_evaluate}, and
+ *       {@link NativeExpression_getFunction} returns null.
+ * @note Native code computes with doubles. Exact integer and rational
+ *       results only come from {@link evaluateCompiled}, so native code
+ *       can differ from it by far more than the last place:
+ *       2^62 + 1 - 2^62 is 1 there and 0 here.
+ * @note Each native expression holds its own mapping of executable
+ *       memory, so a process can only hold as many of them at once as
+ *       it may have mappings, about 65 thousand on a default Linux;
+ *       beyond that, programs are interpreted.
+ * @param program The program returned by {@link compileExpression},
+ *        which must outlive the native expression.
+ * @param native The native expression, to be deleted with
+ *        {@link NativeExpression_delete}.
+ */
+EvaluationResult compileNative(CompiledExpression *program,
+        NativeExpression **native) {
+
+    NativeExpression *theNative = Memory_allocateType(NativeExpression);
+
+    theNative->program = program;
+#ifdef JIT_SUPPORTED
+    NativeExpression_generate(theNative);
+#endif
+
+    *native = theNative;
+    return EVALUATION_SUCCESS;
+}
+
+void NativeExpression_delete(NativeExpression *native) {
+#ifdef JIT_SUPPORTED
+    if (native->code != null) {
+        munmap(native->code, native->codeSize);
+    }
+#endif
+    Memory_free(native);
+}
+
+/**
+ * Get the native function of a native expression, which takes the
+ * values of the variables indexed by their slots.
+ * @note A failing evaluation returns NaN.
+ * @return The native function, or null if the expression is
+ *         interpreted on this platform.
+ */
+NativeFunction NativeExpression_getFunction(NativeExpression *native) {
+    return native->function;
+}
+
+/**
+ * Evaluate a native expression, running its native function if there
+ * is one or interpreting its program otherwise.
+ * @note A failing evaluation returns NaN on both paths.
+ */
+Operand NativeExpression_evaluate(NativeExpression *native,
+        const Operand *variableValues) {
+
+    Operand value;
+
+    if (native->function != null) {
+        return native->function(variableValues);
+    }
+    return evaluateCompiled(native->program, (Operand *)variableValues,
+            &value) == EVALUATION_SUCCESS ? value : NAN;
+}
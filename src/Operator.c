@@ -0,0 +1,723 @@
+/**
+ * @file Operator.c
+ * @author: Zhang Hai
+ */
+
+/*
+ * Copyright (C) 2014 Zhang Hai
+ *
+ * This file is part of calc.
+ *
+ * calc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * calc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with calc.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Operator.h"
+
+#include <math.h>
+
+#include "FunctionRegistry.h"
+#include "Statistics.h"
+
+
+static int OPERATOR_PRECEDENCE[] = {
+    1,
+    1,
+    2,
+    2,
+    3,
+    4,
+    5,
+    6,
+    6,
+    6,
+    6,
+    6,
+    6,
+    6,
+    6,
+    6,
+    6,
+    6,
+    6,
+    6,
+    6,
+    6,
+    6,
+    6,
+    6,
+    6,
+    6,
+    6,
+    0,
+    0
+};
+
+static string OPERATOR_STRINGS[] = {
+    "+",
+    "-",
+    "*",
+    "/",
+    "-",
+    "^",
+    "!",
+    "(",
+    "sin",
+    "cos",
+    "tan",
+    "pow",
+    "log",
+    "exp",
+    "ln",
+    "sqrt",
+    "abs",
+    "asin",
+    "acos",
+    "atan",
+    "atan2",
+    "sinh",
+    "cosh",
+    "tanh",
+    "floor",
+    "ceil",
+    "min",
+    "max",
+    ",",
+    ")"
+};
+
+/**
+ * Number of operands each operator takes from the operand stack when
+ * evaluated.
+ */
+static size_t OPERATOR_OPERAND_COUNTS[] = {
+    2,
+    2,
+    2,
+    2,
+    1,
+    2,
+    1,
+    0,
+    1,
+    1,
+    1,
+    2,
+    2,
+    1,
+    1,
+    1,
+    1,
+    1,
+    1,
+    1,
+    2,
+    1,
+    1,
+    1,
+    1,
+    1,
+    2,
+    2,
+    0,
+    0
+};
+
+
+/* Largest n for which n! is finite as a double. */
+#define FACTORIAL_TABLE_MAXIMUM 170
+
+/* Exact n! for n from 0 to FACTORIAL_TABLE_MAXIMUM, correctly rounded. */
+static const double FACTORIAL_TABLE[FACTORIAL_TABLE_MAXIMUM + 1] = {
+    1.0, 1.0, 2.0,
+    6.0, 24.0, 120.0,
+    720.0, 5040.0, 40320.0,
+    362880.0, 3628800.0, 39916800.0,
+    479001600.0, 6227020800.0, 87178291200.0,
+    1307674368000.0, 20922789888000.0, 355687428096000.0,
+    6402373705728000.0, 1.21645100408832e+17, 2.43290200817664e+18,
+    5.109094217170944e+19, 1.1240007277776077e+21, 2.585201673888498e+22,
+    6.204484017332394e+23, 1.5511210043330986e+25, 4.0329146112660565e+26,
+    1.0888869450418352e+28, 3.0488834461171387e+29, 8.841761993739702e+30,
+    2.6525285981219107e+32, 8.222838654177922e+33, 2.631308369336935e+35,
+    8.683317618811886e+36, 2.9523279903960416e+38, 1.0333147966386145e+40,
+    3.7199332678990125e+41, 1.3763753091226346e+43, 5.230226174666011e+44,
+    2.0397882081197444e+46, 8.159152832478977e+47, 3.345252661316381e+49,
+    1.40500611775288e+51, 6.041526306337383e+52, 2.658271574788449e+54,
+    1.1962222086548019e+56, 5.502622159812089e+57, 2.5862324151116818e+59,
+    1.2413915592536073e+61, 6.082818640342675e+62, 3.0414093201713376e+64,
+    1.5511187532873822e+66, 8.065817517094388e+67, 4.2748832840600255e+69,
+    2.308436973392414e+71, 1.2696403353658276e+73, 7.109985878048635e+74,
+    4.0526919504877214e+76, 2.3505613312828785e+78, 1.3868311854568984e+80,
+    8.32098711274139e+81, 5.075802138772248e+83, 3.146997326038794e+85,
+    1.98260831540444e+87, 1.2688693218588417e+89, 8.247650592082472e+90,
+    5.443449390774431e+92, 3.647111091818868e+94, 2.4800355424368305e+96,
+    1.711224524281413e+98, 1.1978571669969892e+100, 8.504785885678623e+101,
+    6.1234458376886085e+103, 4.4701154615126844e+105, 3.307885441519386e+107,
+    2.48091408113954e+109, 1.8854947016660504e+111, 1.4518309202828587e+113,
+    1.1324281178206297e+115, 8.946182130782976e+116, 7.156945704626381e+118,
+    5.797126020747368e+120, 4.753643337012842e+122, 3.945523969720659e+124,
+    3.314240134565353e+126, 2.81710411438055e+128, 2.4227095383672734e+130,
+    2.107757298379528e+132, 1.8548264225739844e+134, 1.650795516090846e+136,
+    1.4857159644817615e+138, 1.352001527678403e+140, 1.2438414054641308e+142,
+    1.1567725070816416e+144, 1.087366156656743e+146, 1.032997848823906e+148,
+    9.916779348709496e+149, 9.619275968248212e+151, 9.426890448883248e+153,
+    9.332621544394415e+155, 9.332621544394415e+157, 9.42594775983836e+159,
+    9.614466715035127e+161, 9.90290071648618e+163, 1.0299016745145628e+166,
+    1.081396758240291e+168, 1.1462805637347084e+170, 1.226520203196138e+172,
+    1.324641819451829e+174, 1.4438595832024937e+176, 1.588245541522743e+178,
+    1.7629525510902446e+180, 1.974506857221074e+182, 2.2311927486598138e+184,
+    2.5435597334721877e+186, 2.925093693493016e+188, 3.393108684451898e+190,
+    3.969937160808721e+192, 4.684525849754291e+194, 5.574585761207606e+196,
+    6.689502913449127e+198, 8.094298525273444e+200, 9.875044200833601e+202,
+    1.214630436702533e+205, 1.506141741511141e+207, 1.882677176888926e+209,
+    2.372173242880047e+211, 3.0126600184576594e+213, 3.856204823625804e+215,
+    4.974504222477287e+217, 6.466855489220474e+219, 8.47158069087882e+221,
+    1.1182486511960043e+224, 1.4872707060906857e+226, 1.9929427461615188e+228,
+    2.6904727073180504e+230, 3.659042881952549e+232, 5.012888748274992e+234,
+    6.917786472619489e+236, 9.615723196941089e+238, 1.3462012475717526e+241,
+    1.898143759076171e+243, 2.695364137888163e+245, 3.854370717180073e+247,
+    5.5502938327393044e+249, 8.047926057471992e+251, 1.1749972043909107e+254,
+    1.727245890454639e+256, 2.5563239178728654e+258, 3.80892263763057e+260,
+    5.713383956445855e+262, 8.62720977423324e+264, 1.3113358856834524e+267,
+    2.0063439050956823e+269, 3.0897696138473508e+271, 4.789142901463394e+273,
+    7.471062926282894e+275, 1.1729568794264145e+278, 1.853271869493735e+280,
+    2.9467022724950384e+282, 4.7147236359920616e+284, 7.590705053947219e+286,
+    1.2296942187394494e+289, 2.0044015765453026e+291, 3.287218585534296e+293,
+    5.423910666131589e+295, 9.003691705778438e+297, 1.503616514864999e+300,
+    2.5260757449731984e+302, 4.269068009004705e+304, 7.257415615307999e+306
+};
+
+/*
+ * Lanczos approximation of the gamma function with g = 7 and nine
+ * coefficients, which is accurate to about 15 significant digits.
+ */
+static const double LANCZOS_G = 7;
+
+#define LANCZOS_COEFFICIENT_COUNT 9
+
+static const double LANCZOS_COEFFICIENTS[LANCZOS_COEFFICIENT_COUNT] = {
+    0.99999999999980993,
+    676.5203681218851,
+    -1259.1392167224028,
+    771.32342877765313,
+    -176.61502916214059,
+    12.507343278686905,
+    -0.13857109526572012,
+    9.9843695780195716e-6,
+    1.5056327351493116e-7
+};
+
+/*
+ * Operand above which the factorial overflows a double, as 171.62! is
+ * about the largest double; the halves of the Lanczos power overflow
+ * themselves not far above it.
+ */
+static const double FACTORIAL_OVERFLOW_MINIMUM = 172;
+
+/* Number of lanes of the batch factorial that share a series buffer. */
+#define FACTORIAL_BATCH_SIZE 64
+
+/* Smallest operand for the asymptotic series of digamma. */
+#define DIGAMMA_ASYMPTOTIC_MINIMUM 6
+
+static const double SQRT_2_PI = 2.50662827463100050242;
+
+
+/**
+ * Get the series of the Lanczos approximation of (operand + 1)!.
+ * @note This is a rational function without branches, so that the
+ *       batch variant is vectorized.
+ */
+static double lanczosSeries(double operand) {
+    double sum = LANCZOS_COEFFICIENTS[0];
+    size_t i;
+    for (i = 1; i < LANCZOS_COEFFICIENT_COUNT; ++i) {
+        sum += LANCZOS_COEFFICIENTS[i] / (operand + i);
+    }
+    return sum;
+}
+
+/**
+ * Get operand! from the Lanczos series of operand, for operand at least
+ * -0.5.
+ * @note The power is split in halves so that it does not overflow
+ *       before the exponential brings it back into range.
+ */
+static double lanczosFactorial(double operand, double series) {
+    double t = operand + LANCZOS_G + 0.5,
+            power = pow(t, (operand + 0.5) / 2);
+    return SQRT_2_PI * power * (power * exp(-t)) * series;
+}
+
+/**
+ * Check whether the factorial of an operand is defined, which is
+ * everywhere except at the negative integers.
+ */
+static bool isFactorialDefined(double operand) {
+    return !(operand < 0 && operand == floor(operand));
+}
+
+/**
+ * Get the factorial of an operand, which is Gamma(operand + 1).
+ * @note Integers up to FACTORIAL_TABLE_MAXIMUM are looked up, and
+ *       larger ones overflow to infinity as repeated multiplication
+ *       would, as do other operands above FACTORIAL_OVERFLOW_MINIMUM.
+ */
+static double factorial(double operand) {
+    if (operand >= 0 && operand == floor(operand)) {
+        return operand <= FACTORIAL_TABLE_MAXIMUM
+                ? FACTORIAL_TABLE[(size_t)operand] : INFINITY;
+    } else if (operand < -0.5) {
+        /* Reflection formula, x! (-x - 1)! = pi / sin(pi (x + 1)). */
+        return M_PI / (sin(M_PI * (operand + 1)) * factorial(-operand - 1));
+    } else if (operand > FACTORIAL_OVERFLOW_MINIMUM) {
+        return INFINITY;
+    } else {
+        return lanczosFactorial(operand, lanczosSeries(operand));
+    }
+}
+
+/**
+ * Get the digamma function of an operand, the derivative of the
+ * logarithm of Gamma(operand).
+ * @note The operand is shifted above DIGAMMA_ASYMPTOTIC_MINIMUM with
+ *       the recurrence psi(x + 1) = psi(x) + 1 / x, where the
+ *       asymptotic series is accurate to double precision.
+ */
+static double digamma(double operand) {
+
+    double result = 0, inverseSquare;
+
+    if (operand <= 0 && operand == floor(operand)) {
+        return NAN;
+    } else if (operand < 0) {
+        /* Reflection formula, psi(1 - x) - psi(x) = pi cot(pi x). */
+        return digamma(1 - operand) - M_PI / tan(M_PI * operand);
+    }
+
+    for (; operand < DIGAMMA_ASYMPTOTIC_MINIMUM; operand += 1) {
+        result -= 1 / operand;
+    }
+    inverseSquare = 1 / (operand * operand);
+    return result + log(operand) - 0.5 / operand
+            - inverseSquare * (1.0 / 12 - inverseSquare * (1.0 / 120
+                    - inverseSquare * (1.0 / 252 - inverseSquare
+                            * (1.0 / 240 - inverseSquare / 132))));
+}
+
+static bool Operator_isUserFunction(Operator operator) {
+    return operator >= OPERATOR_FIRST_USER_FUNCTION;
+}
+
+int Operator_getPrecedence(Operator operator) {
+    /* A registered function binds like any other function. */
+    return OPERATOR_PRECEDENCE[Operator_isUserFunction(operator)
+            ? OPERATOR_SIN : operator];
+}
+
+string Operator_getString(Operator operator) {
+    return Operator_isUserFunction(operator)
+            ? FunctionRegistry_getName(operator)
+            : OPERATOR_STRINGS[operator];
+}
+
+size_t Operator_getOperandCount(Operator operator) {
+    return Operator_isUserFunction(operator)
+            ? FunctionRegistry_getOperandCount(operator)
+            : OPERATOR_OPERAND_COUNTS[operator];
+}
+
+bool Operator_isFunction(Operator operator) {
+    return (operator >= OPERATOR_SIN && operator <= OPERATOR_MAX)
+            || Operator_isUserFunction(operator);
+}
+
+int Operator_comparePrecedence(Operator operator1,
+        Operator operator2) {
+    if (Operator_getPrecedence(operator1)
+                    == OPERATOR_PRECEDENCE[OPERATOR_PARENTHESIS_LEFT]
+            || operator1 == OPERATOR_COMMA) {
+        /* Magic left parenthesis & comma! */
+        return -1;
+    } else if (operator1 == OPERATOR_PARENTHESIS_RIGHT) {
+        /* Magic right parenthesis */
+        return 1;
+    } else {
+        return Operator_getPrecedence(operator1)
+                - Operator_getPrecedence(operator2);
+    }
+}
+
+static inline EvaluationResult Operator_apply(Operator operator,
+        Operand *operands, Operand *value) {
+
+    switch (operator) {
+    case OPERATOR_ADDITION:
+        *value = operands[0] + operands[1];
+        break;
+    case OPERATOR_SUBTRACTION:
+        *value = operands[0] - operands[1];
+        break;
+    case OPERATOR_MULPLICATION:
+        *value = operands[0] * operands[1];
+        break;
+    case OPERATOR_DIVISION:
+        *value = operands[0] / operands[1];
+        break;
+    case OPERATOR_NEGATIVE:
+        *value = -operands[0];
+        break;
+    case OPERATOR_POWER:
+    case OPERATOR_POW:
+        *value = pow(operands[0], operands[1]);
+        break;
+    case OPERATOR_FACTORIAL:
+        if (!isFactorialDefined(operands[0])) {
+            return EVALUATION_ERROR_INVALID_OPERATION;
+        }
+        *value = factorial(operands[0]);
+        break;
+    case OPERATOR_SIN:
+        *value = sin(operands[0]);
+        break;
+    case OPERATOR_COS:
+        *value = cos(operands[0]);
+        break;
+    case OPERATOR_TAN:
+        *value = tan(operands[0]);
+        break;
+    case OPERATOR_LOG:
+        if (operands[0] <= 0 || operands[0] == 1 || operands[1] <= 0) {
+            return EVALUATION_ERROR_INVALID_OPERATION;
+        }
+        *value = log(operands[1]) / log(operands[0]);
+        break;
+    case OPERATOR_EXP:
+        *value = exp(operands[0]);
+        break;
+    case OPERATOR_LN:
+        if (operands[0] <= 0) {
+            return EVALUATION_ERROR_INVALID_OPERATION;
+        }
+        *value = log(operands[0]);
+        break;
+    case OPERATOR_SQRT:
+        if (operands[0] < 0) {
+            return EVALUATION_ERROR_INVALID_OPERATION;
+        }
+        *value = sqrt(operands[0]);
+        break;
+    case OPERATOR_ABS:
+        *value = fabs(operands[0]);
+        break;
+    case OPERATOR_ASIN:
+        if (operands[0] < -1 || operands[0] > 1) {
+            return EVALUATION_ERROR_INVALID_OPERATION;
+        }
+        *value = asin(operands[0]);
+        break;
+    case OPERATOR_ACOS:
+        if (operands[0] < -1 || operands[0] > 1) {
+            return EVALUATION_ERROR_INVALID_OPERATION;
+        }
+        *value = acos(operands[0]);
+        break;
+    case OPERATOR_ATAN:
+        *value = atan(operands[0]);
+        break;
+    case OPERATOR_ATAN2:
+        *value = atan2(operands[0], operands[1]);
+        break;
+    case OPERATOR_SINH:
+        *value = sinh(operands[0]);
+        break;
+    case OPERATOR_COSH:
+        *value = cosh(operands[0]);
+        break;
+    case OPERATOR_TANH:
+        *value = tanh(operands[0]);
+        break;
+    case OPERATOR_FLOOR:
+        *value = floor(operands[0]);
+        break;
+    case OPERATOR_CEIL:
+        *value = ceil(operands[0]);
+        break;
+    case OPERATOR_MIN:
+    case OPERATOR_MAX:
+        /* NaN spreads as through any other operator, unlike fmin. */
+        if (isnan(operands[0]) || isnan(operands[1])) {
+            *value = NAN;
+        } else {
+            *value = operator == OPERATOR_MIN
+                    ? fmin(operands[0], operands[1])
+                    : fmax(operands[0], operands[1]);
+        }
+        break;
+    default:
+        if (!Operator_isUserFunction(operator)) {
+            return EVALUATION_ERROR_INTERNAL_FAILURE;
+        }
+        *value = FunctionRegistry_getFunction(operator)(operands);
+    }
+
+    return EVALUATION_SUCCESS;
+}
+
+/**
+ * Evaluate an operator.
+ * @param operands The operands of the operator, in the order they
+ *        appear in the expression.
+ * @param value The result of the evaluation.
+ */
+EvaluationResult Operator_evaluate(Operator operator,
+        Operand *operands, Operand *value) {
+
+    EvaluationResult result;
+    STATISTICS_DECLARE_TIME(start);
+
+    STATISTICS_START(start);
+    result = Operator_apply(operator, operands, value);
+    STATISTICS_ADD_OPERATOR(operator, 1, start);
+
+    return result;
+}
+
+/**
+ * Get the partial derivatives of an operator with respect to its
+ * operands.
+ * @note A partial derivative that does not exist, like that of a
+ *       negative base with respect to its exponent, is NaN.
+ * @param operands The operands of the operator.
+ * @param value The value of the operator, from
+ *        {@link Operator_evaluate}.
+ * @param partials The partial derivative with respect to each operand.
+ */
+void Operator_differentiate(Operator operator, Operand *operands,
+        Operand value, Operand *partials) {
+
+    Operand base, exponent;
+    size_t i;
+
+    switch (operator) {
+    case OPERATOR_ADDITION:
+        partials[0] = 1;
+        partials[1] = 1;
+        break;
+    case OPERATOR_SUBTRACTION:
+        partials[0] = 1;
+        partials[1] = -1;
+        break;
+    case OPERATOR_MULPLICATION:
+        partials[0] = operands[1];
+        partials[1] = operands[0];
+        break;
+    case OPERATOR_DIVISION:
+        partials[0] = 1 / operands[1];
+        partials[1] = -value / operands[1];
+        break;
+    case OPERATOR_NEGATIVE:
+        partials[0] = -1;
+        break;
+    case OPERATOR_POWER:
+    case OPERATOR_POW:
+        base = operands[0];
+        exponent = operands[1];
+        partials[0] = exponent == 0 ? 0
+                : exponent * pow(base, exponent - 1);
+        if (base > 0) {
+            partials[1] = value * log(base);
+        } else if (base == 0 && exponent > 0) {
+            partials[1] = 0;
+        } else {
+            partials[1] = NAN;
+        }
+        break;
+    case OPERATOR_FACTORIAL:
+        /* d/dx Gamma(x + 1) = Gamma(x + 1) psi(x + 1). */
+        partials[0] = value * digamma(operands[0] + 1);
+        break;
+    case OPERATOR_SIN:
+        partials[0] = cos(operands[0]);
+        break;
+    case OPERATOR_COS:
+        partials[0] = -sin(operands[0]);
+        break;
+    case OPERATOR_TAN:
+        partials[0] = 1 + value * value;
+        break;
+    case OPERATOR_LOG:
+        /* log(b, x) = ln(x) / ln(b). */
+        partials[0] = -value / (operands[0] * log(operands[0]));
+        partials[1] = 1 / (operands[1] * log(operands[0]));
+        break;
+    case OPERATOR_EXP:
+        partials[0] = value;
+        break;
+    case OPERATOR_LN:
+        partials[0] = 1 / operands[0];
+        break;
+    case OPERATOR_SQRT:
+        partials[0] = 0.5 / value;
+        break;
+    case OPERATOR_ABS:
+        partials[0] = operands[0] > 0 ? 1 : operands[0] < 0 ? -1 : NAN;
+        break;
+    case OPERATOR_ASIN:
+        partials[0] = 1 / sqrt(1 - operands[0] * operands[0]);
+        break;
+    case OPERATOR_ACOS:
+        partials[0] = -1 / sqrt(1 - operands[0] * operands[0]);
+        break;
+    case OPERATOR_ATAN:
+        partials[0] = 1 / (1 + operands[0] * operands[0]);
+        break;
+    case OPERATOR_ATAN2:
+        /* atan2(y, x) is the angle of (x, y). */
+        base = operands[0] * operands[0] + operands[1] * operands[1];
+        partials[0] = operands[1] / base;
+        partials[1] = -operands[0] / base;
+        break;
+    case OPERATOR_SINH:
+        partials[0] = cosh(operands[0]);
+        break;
+    case OPERATOR_COSH:
+        partials[0] = sinh(operands[0]);
+        break;
+    case OPERATOR_TANH:
+        partials[0] = 1 - value * value;
+        break;
+    case OPERATOR_FLOOR:
+    case OPERATOR_CEIL:
+        /* Steps, which are flat except at the integers. */
+        partials[0] = operands[0] == value ? NAN : 0;
+        break;
+    case OPERATOR_MIN:
+    case OPERATOR_MAX:
+        /* The operand that is picked, if they differ. */
+        partials[0] = operands[0] == operands[1] ? NAN
+                : operands[0] == value;
+        partials[1] = operands[0] == operands[1] ? NAN
+                : operands[1] == value;
+        break;
+    default:
+        /* A registered function has no known derivative. */
+        for (i = 0; i < Operator_getOperandCount(operator); ++i) {
+            partials[i] = NAN;
+        }
+        break;
+    }
+}
+
+/**
+ * Check whether an operator can give an exact rational result.
+ */
+bool Operator_isRational(Operator operator) {
+    switch (operator) {
+    case OPERATOR_ADDITION:
+    case OPERATOR_SUBTRACTION:
+    case OPERATOR_MULPLICATION:
+    case OPERATOR_DIVISION:
+    case OPERATOR_NEGATIVE:
+    case OPERATOR_POWER:
+    case OPERATOR_FACTORIAL:
+    case OPERATOR_POW:
+    case OPERATOR_ABS:
+    case OPERATOR_FLOOR:
+    case OPERATOR_CEIL:
+    case OPERATOR_MIN:
+    case OPERATOR_MAX:
+        return true;
+    default:
+        return false;
+    }
+}
+
+/**
+ * Evaluate an operator exactly.
+ * @return Whether the result is exact; if not, the operator should be
+ *         evaluated with {@link Operator_evaluate}, which also reports
+ *         any error.
+ * @see Operator_evaluate
+ */
+bool Operator_evaluateRational(Operator operator, Rational *operands,
+        Rational *value) {
+    switch (operator) {
+    case OPERATOR_ADDITION:
+        return Rational_add(&operands[0], &operands[1], value);
+    case OPERATOR_SUBTRACTION:
+        return Rational_subtract(&operands[0], &operands[1], value);
+    case OPERATOR_MULPLICATION:
+        return Rational_multiply(&operands[0], &operands[1], value);
+    case OPERATOR_DIVISION:
+        return Rational_divide(&operands[0], &operands[1], value);
+    case OPERATOR_NEGATIVE:
+        return Rational_negate(&operands[0], value);
+    case OPERATOR_POWER:
+    case OPERATOR_POW:
+        return Rational_pow(&operands[0], &operands[1], value);
+    case OPERATOR_FACTORIAL:
+        return Rational_factorial(&operands[0], value);
+    case OPERATOR_ABS:
+        return Rational_abs(&operands[0], value);
+    case OPERATOR_FLOOR:
+        return Rational_floor(&operands[0], value);
+    case OPERATOR_CEIL:
+        return Rational_ceil(&operands[0], value);
+    case OPERATOR_MIN:
+        *value = operands[Rational_compare(&operands[0], &operands[1])
+                > 0];
+        return true;
+    case OPERATOR_MAX:
+        *value = operands[Rational_compare(&operands[0], &operands[1])
+                < 0];
+        return true;
+    default:
+        return false;
+    }
+}
+
+/**
+ * Evaluate the factorial of many operands in place, as
+ * {@link Operator_evaluate} would for each of them.
+ * @note The Lanczos series of a whole batch is computed before any of
+ *       the lookups and calls, so that it is vectorized.
+ * @param results The result of each operand, set only where the
+ *        factorial is undefined.
+ */
+void Operator_evaluateFactorials(Operand *operands, size_t count,
+        EvaluationResult *results) {
+
+    double series[FACTORIAL_BATCH_SIZE], operand;
+    size_t start, batchCount, i;
+
+    for (start = 0; start < count; start += FACTORIAL_BATCH_SIZE) {
+        batchCount = MIN(FACTORIAL_BATCH_SIZE, count - start);
+        for (i = 0; i < batchCount; ++i) {
+            series[i] = lanczosSeries(operands[start + i]);
+        }
+        for (i = 0; i < batchCount; ++i) {
+            operand = operands[start + i];
+            if (!isFactorialDefined(operand)) {
+                results[start + i] = EVALUATION_ERROR_INVALID_OPERATION;
+            } else if (operand >= -0.5 && operand != floor(operand)
+                    && operand <= FACTORIAL_OVERFLOW_MINIMUM) {
+                operands[start + i] = lanczosFactorial(operand,
+                        series[i]);
+            } else {
+                operands[start + i] = factorial(operand);
+            }
+        }
+    }
+}
@@ -0,0 +1,112 @@
+/**
+ * @file Operator.h
+ * @author: Zhang Hai
+ */
+
+/*
+ * Copyright (C) 2014 Zhang Hai
+ *
+ * This file is part of calc.
+ *
+ * calc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * calc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with calc.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _OPERATOR_H_
+#define _OPERATOR_H_
+
+
+#include "zhclib/Common.h"
+
+#include "Evaluator.h"
+#include "Rational.h"
+
+
+/**
+ * Evaluate the stack reversely, so the operator stack should be kept
+ * in strict (for operators may not be commutative) ascending
+ * precedence order.
+ */
+
+typedef enum {
+    OPERATOR_ADDITION,
+    OPERATOR_SUBTRACTION,
+    OPERATOR_MULPLICATION,
+    OPERATOR_DIVISION,
+    OPERATOR_NEGATIVE,
+    OPERATOR_POWER,
+    OPERATOR_FACTORIAL,
+    OPERATOR_PARENTHESIS_LEFT,
+    OPERATOR_SIN,
+    OPERATOR_COS,
+    OPERATOR_TAN,
+    OPERATOR_POW,
+    OPERATOR_LOG,
+    OPERATOR_EXP,
+    OPERATOR_LN,
+    OPERATOR_SQRT,
+    OPERATOR_ABS,
+    OPERATOR_ASIN,
+    OPERATOR_ACOS,
+    OPERATOR_ATAN,
+    OPERATOR_ATAN2,
+    OPERATOR_SINH,
+    OPERATOR_COSH,
+    OPERATOR_TANH,
+    OPERATOR_FLOOR,
+    OPERATOR_CEIL,
+    OPERATOR_MIN,
+    OPERATOR_MAX,
+    OPERATOR_COMMA,
+    OPERATOR_PARENTHESIS_RIGHT
+} Operator;
+
+#define OPERATOR_COUNT (OPERATOR_PARENTHESIS_RIGHT + 1)
+
+/*
+ * Operators from OPERATOR_COUNT on are the functions registered with
+ * registerFunction, in the order they were registered.
+ */
+#define OPERATOR_FIRST_USER_FUNCTION OPERATOR_COUNT
+
+/* Most operands an operator, including a registered function, takes. */
+#define OPERATOR_MAXIMUM_OPERAND_COUNT 4
+
+
+int Operator_getPrecedence(Operator operator);
+
+string Operator_getString(Operator operator);
+
+size_t Operator_getOperandCount(Operator operator);
+
+bool Operator_isFunction(Operator operator);
+
+int Operator_comparePrecedence(Operator operator1,
+        Operator operator2);
+
+EvaluationResult Operator_evaluate(Operator operator,
+        Operand *operands, Operand *value);
+
+void Operator_differentiate(Operator operator, Operand *operands,
+        Operand value, Operand *partials);
+
+bool Operator_isRational(Operator operator);
+
+bool Operator_evaluateRational(Operator operator, Rational *operands,
+        Rational *value);
+
+void Operator_evaluateFactorials(Operand *operands, size_t count,
+        EvaluationResult *results);
+
+
+#endif /* _OPERATOR_H_ */
@@ -0,0 +1,305 @@
+/**
+ * @file Rational.c
+ * @author: Zhang Hai
+ */
+
+/*
+ * Copyright (C) 2014 Zhang Hai
+ *
+ * This file is part of calc.
+ *
+ * calc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * calc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with calc.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Rational.h"
+
+
+/* 20! is the largest factorial below 2^63. */
+static const int64_t FACTORIAL_MAXIMUM = 20;
+
+
+static uint64_t Rational_getMagnitude(int64_t value) {
+    return value < 0 ? -(uint64_t)value : (uint64_t)value;
+}
+
+static uint64_t Rational_gcd(uint64_t value1, uint64_t value2) {
+    uint64_t remainder;
+    while (value2 != 0) {
+        remainder = value1 % value2;
+        value1 = value2;
+        value2 = remainder;
+    }
+    return value1;
+}
+
+/**
+ * Make a rational number in lowest terms from a fraction.
+ * @note The denominator must not be zero.
+ */
+static bool Rational_reduce(int64_t numerator, int64_t denominator,
+        Rational *value) {
+
+    uint64_t divisor;
+
+    if (denominator < 0) {
+        if (numerator == INT64_MIN || denominator == INT64_MIN) {
+            return false;
+        }
+        numerator = -numerator;
+        denominator = -denominator;
+    }
+
+    if (denominator != 1) {
+        divisor = Rational_gcd(Rational_getMagnitude(numerator),
+                denominator);
+        numerator /= (int64_t)divisor;
+        denominator /= (int64_t)divisor;
+    }
+
+    value->numerator = numerator;
+    value->denominator = denominator;
+    return true;
+}
+
+/**
+ * Raise an integer to a power by squaring.
+ */
+static bool Rational_powInteger(int64_t base, uint64_t exponent,
+        int64_t *value) {
+
+    int64_t result = 1;
+
+    while (true) {
+        if ((exponent & 1)
+                && __builtin_mul_overflow(result, base, &result)) {
+            return false;
+        }
+        exponent >>= 1;
+        if (exponent == 0) {
+            break;
+        }
+        if (__builtin_mul_overflow(base, base, &base)) {
+            return false;
+        }
+    }
+
+    *value = result;
+    return true;
+}
+
+Operand Rational_toOperand(Rational *number) {
+    return number->denominator == 1 ? (Operand)number->numerator
+            : (Operand)number->numerator / (Operand)number->denominator;
+}
+
+bool Rational_add(Rational *number1, Rational *number2,
+        Rational *value) {
+
+    int64_t scale1, scale2, numerator1, numerator2, denominator;
+    uint64_t divisor;
+
+    if (number1->denominator == 1 && number2->denominator == 1) {
+        value->denominator = 1;
+        return !__builtin_add_overflow(number1->numerator,
+                number2->numerator, &value->numerator);
+    }
+
+    /* Scale to the least common denominator. */
+    divisor = Rational_gcd(number1->denominator, number2->denominator);
+    scale1 = number2->denominator / (int64_t)divisor;
+    scale2 = number1->denominator / (int64_t)divisor;
+    if (__builtin_mul_overflow(number1->numerator, scale1, &numerator1)
+            || __builtin_mul_overflow(number2->numerator, scale2,
+                    &numerator2)
+            || __builtin_add_overflow(numerator1, numerator2,
+                    &numerator1)
+            || __builtin_mul_overflow(number1->denominator, scale1,
+                    &denominator)) {
+        return false;
+    }
+    return Rational_reduce(numerator1, denominator, value);
+}
+
+bool Rational_subtract(Rational *number1, Rational *number2,
+        Rational *value) {
+
+    Rational negative;
+
+    return Rational_negate(number2, &negative)
+            && Rational_add(number1, &negative, value);
+}
+
+bool Rational_multiply(Rational *number1, Rational *number2,
+        Rational *value) {
+
+    int64_t numerator1 = number1->numerator,
+            numerator2 = number2->numerator,
+            denominator1 = number1->denominator,
+            denominator2 = number2->denominator;
+    uint64_t divisor;
+
+    if (denominator1 == 1 && denominator2 == 1) {
+        value->denominator = 1;
+        return !__builtin_mul_overflow(numerator1, numerator2,
+                &value->numerator);
+    }
+
+    /* Cancel across the fractions first, keeping the product small. */
+    if (denominator2 != 1) {
+        divisor = Rational_gcd(Rational_getMagnitude(numerator1),
+                denominator2);
+        numerator1 /= (int64_t)divisor;
+        denominator2 /= (int64_t)divisor;
+    }
+    if (denominator1 != 1) {
+        divisor = Rational_gcd(Rational_getMagnitude(numerator2),
+                denominator1);
+        numerator2 /= (int64_t)divisor;
+        denominator1 /= (int64_t)divisor;
+    }
+
+    return !__builtin_mul_overflow(numerator1, numerator2,
+                    &value->numerator)
+            && !__builtin_mul_overflow(denominator1, denominator2,
+                    &value->denominator);
+}
+
+/**
+ * Divide rational numbers.
+ * @return Whether the quotient is exact, which it is not for a divisor
+ *         of zero.
+ */
+bool Rational_divide(Rational *number1, Rational *number2,
+        Rational *value) {
+
+    Rational reciprocal;
+
+    /* Integers that divide evenly stay integers. */
+    if (number1->denominator == 1 && number2->denominator == 1
+            && number2->numerator != 0 && number2->numerator != -1
+            && number1->numerator % number2->numerator == 0) {
+        value->numerator = number1->numerator / number2->numerator;
+        value->denominator = 1;
+        return true;
+    }
+
+    if (number2->numerator == 0
+            || !Rational_reduce(number2->denominator, number2->numerator,
+                    &reciprocal)) {
+        return false;
+    }
+    return Rational_multiply(number1, &reciprocal, value);
+}
+
+bool Rational_negate(Rational *number, Rational *value) {
+    if (number->numerator == INT64_MIN) {
+        return false;
+    }
+    value->numerator = -number->numerator;
+    value->denominator = number->denominator;
+    return true;
+}
+
+bool Rational_abs(Rational *number, Rational *value) {
+    if (number->numerator < 0) {
+        return Rational_negate(number, value);
+    }
+    *value = *number;
+    return true;
+}
+
+/**
+ * Get the largest integer not greater than a rational number.
+ * @note The denominator is positive, so this never overflows.
+ */
+bool Rational_floor(Rational *number, Rational *value) {
+    value->numerator = number->numerator / number->denominator
+            - (number->numerator % number->denominator < 0);
+    value->denominator = 1;
+    return true;
+}
+
+/**
+ * Get the smallest integer not less than a rational number.
+ */
+bool Rational_ceil(Rational *number, Rational *value) {
+    value->numerator = number->numerator / number->denominator
+            + (number->numerator % number->denominator > 0);
+    value->denominator = 1;
+    return true;
+}
+
+/**
+ * Compare rational numbers by cross-multiplying in 128 bits, which
+ * cannot overflow.
+ */
+int Rational_compare(Rational *number1, Rational *number2) {
+    __int128 product1 = (__int128)number1->numerator
+            * number2->denominator,
+            product2 = (__int128)number2->numerator
+                    * number1->denominator;
+    return (product1 > product2) - (product1 < product2);
+}
+
+/**
+ * Raise a rational number to an integer power.
+ * @return Whether the power is exact, which it is not for exponents
+ *         that are not integers or powers of zero that are undefined.
+ */
+bool Rational_pow(Rational *base, Rational *exponent, Rational *value) {
+
+    uint64_t magnitude = Rational_getMagnitude(exponent->numerator);
+    int64_t numerator, denominator;
+
+    if (exponent->denominator != 1) {
+        return false;
+    }
+    if (base->numerator == 0) {
+        if (exponent->numerator < 0) {
+            return false;
+        }
+        value->numerator = exponent->numerator == 0;
+        value->denominator = 1;
+        return true;
+    }
+
+    if (!Rational_powInteger(base->numerator, magnitude, &numerator)
+            || !Rational_powInteger(base->denominator, magnitude,
+                    &denominator)) {
+        return false;
+    }
+    if (exponent->numerator < 0) {
+        return Rational_reduce(denominator, numerator, value);
+    }
+    value->numerator = numerator;
+    value->denominator = denominator;
+    return true;
+}
+
+bool Rational_factorial(Rational *number, Rational *value) {
+
+    int64_t product = 1, i;
+
+    if (number->denominator != 1 || number->numerator < 0
+            || number->numerator > FACTORIAL_MAXIMUM) {
+        return false;
+    }
+
+    for (i = 2; i <= number->numerator; ++i) {
+        product *= i;
+    }
+    value->numerator = product;
+    value->denominator = 1;
+    return true;
+}
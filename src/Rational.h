@@ -0,0 +1,97 @@
+/**
+ * @file Rational.h
+ * @author: Zhang Hai
+ */
+
+/*
+ * Copyright (C) 2014 Zhang Hai
+ *
+ * This file is part of calc.
+ *
+ * calc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * calc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with calc.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _RATIONAL_H_
+#define _RATIONAL_H_
+
+
+#include "zhclib/Common.h"
+
+#include <stdint.h>
+
+#include "Evaluator.h"
+
+
+/* Integers up to 2^53 convert to and from doubles exactly. */
+#define RATIONAL_EXACT_INTEGER_MAXIMUM 9007199254740992.0
+
+
+/**
+ * An exact rational number, in lowest terms with a positive
+ * denominator.
+ * @note Operations fail instead of overflowing, so that the caller can
+ *       fall back to doubles.
+ */
+typedef struct {
+    int64_t numerator;
+    int64_t denominator;
+} Rational;
+
+
+/**
+ * Get the exact rational value of an operand.
+ * @note Inline, since it runs for every variable of an exact program.
+ * @return Whether the operand is an integer small enough to be exact.
+ */
+static inline bool Rational_fromOperand(Operand operand,
+        Rational *value) {
+    if (!(operand >= -RATIONAL_EXACT_INTEGER_MAXIMUM
+                && operand <= RATIONAL_EXACT_INTEGER_MAXIMUM)
+            || operand != (Operand)(int64_t)operand) {
+        return false;
+    }
+    value->numerator = (int64_t)operand;
+    value->denominator = 1;
+    return true;
+}
+
+Operand Rational_toOperand(Rational *number);
+
+bool Rational_add(Rational *number1, Rational *number2, Rational *value);
+
+bool Rational_subtract(Rational *number1, Rational *number2,
+        Rational *value);
+
+bool Rational_multiply(Rational *number1, Rational *number2,
+        Rational *value);
+
+bool Rational_divide(Rational *number1, Rational *number2,
+        Rational *value);
+
+bool Rational_negate(Rational *number, Rational *value);
+
+bool Rational_abs(Rational *number, Rational *value);
+
+bool Rational_floor(Rational *number, Rational *value);
+
+bool Rational_ceil(Rational *number, Rational *value);
+
+int Rational_compare(Rational *number1, Rational *number2);
+
+bool Rational_pow(Rational *base, Rational *exponent, Rational *value);
+
+bool Rational_factorial(Rational *number, Rational *value);
+
+
+#endif /* _RATIONAL_H_ */
@@ -0,0 +1,168 @@
+/**
+ * @file Statistics.c
+ * @author: Zhang Hai
+ */
+
+/*
+ * Copyright (C) 2014 Zhang Hai
+ *
+ * This file is part of calc.
+ *
+ * calc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * calc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with calc.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Statistics.h"
+
+#include <pthread.h>
+#include <string.h>
+
+
+/**
+ * Counters of one thread, which only it writes, so that counting needs
+ * no lock. They outlive the thread, so that its counts are kept.
+ */
+typedef struct tagStatisticsBlock {
+    Statistics statistics;
+    struct tagStatisticsBlock *next;
+} StatisticsBlock;
+
+
+static string PHASE_NAMES[] = {
+    "lex",
+    "parse",
+    "evaluate"
+};
+
+static __thread StatisticsBlock *threadBlock = null;
+
+static StatisticsBlock *blocks = null;
+
+/* Guards blocks. */
+static pthread_mutex_t blocksMutex = PTHREAD_MUTEX_INITIALIZER;
+
+
+static StatisticsBlock *Statistics_getThreadBlock() {
+    if (threadBlock == null) {
+        threadBlock = Memory_allocateType(StatisticsBlock);
+        pthread_mutex_lock(&blocksMutex);
+        threadBlock->next = blocks;
+        blocks = threadBlock;
+        pthread_mutex_unlock(&blocksMutex);
+    }
+    return threadBlock;
+}
+
+/**
+ * Add to a counter of the calling thread.
+ * @note The stores are atomic only so that other threads reading the
+ *       counters never see a torn value; they need no ordering.
+ */
+static void Statistics_add(StatisticsCounter *counter, size_t count,
+        uint64_t time) {
+    __atomic_store_n(&counter->count, counter->count + count,
+            __ATOMIC_RELAXED);
+    __atomic_store_n(&counter->time, counter->time + time,
+            __ATOMIC_RELAXED);
+}
+
+/**
+ * Get whether the evaluator is built to collect statistics, with
+ * EVALUATOR_STATISTICS defined.
+ */
+bool Statistics_isEnabled() {
+#ifdef EVALUATOR_STATISTICS
+    return true;
+#else
+    return false;
+#endif
+}
+
+/**
+ * Get a monotonic time in nanoseconds.
+ */
+uint64_t Statistics_getTime() {
+
+    struct timespec time;
+
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (uint64_t)time.tv_sec * 1000000000 + time.tv_nsec;
+}
+
+/**
+ * Count executions of an operator.
+ * @param count The number of values it was applied to, which is more
+ *        than one for a block of rows.
+ * @param time The time they took, in nanoseconds.
+ */
+void Statistics_addOperator(Operator operator, size_t count,
+        uint64_t time) {
+    Statistics_add(&Statistics_getThreadBlock()->statistics.operators[
+            MIN(operator, STATISTICS_OPERATOR_SLOT_COUNT - 1)], count, time);
+}
+
+/**
+ * Count a pass through a phase of the evaluator.
+ * @param time The time it took, in nanoseconds.
+ */
+void Statistics_addPhase(StatisticsPhase phase, uint64_t time) {
+    Statistics_add(&Statistics_getThreadBlock()->statistics.phases[phase],
+            1, time);
+}
+
+/**
+ * Get the statistics of all the threads so far.
+ * @note Phases nest: parsing includes lexing, and evaluating while
+ *       parsing counts as parsing. Operators count wherever they run,
+ *       except in native code, which is not instrumented.
+ */
+void Statistics_get(Statistics *statistics) {
+
+    StatisticsBlock *block;
+    StatisticsCounter *counters, *sums = (StatisticsCounter *)statistics;
+    size_t counterCount = sizeof(Statistics) / sizeof(StatisticsCounter),
+            i;
+
+    memset(statistics, 0, sizeof(Statistics));
+
+    pthread_mutex_lock(&blocksMutex);
+    for (block = blocks; block != null; block = block->next) {
+        counters = (StatisticsCounter *)&block->statistics;
+        for (i = 0; i < counterCount; ++i) {
+            sums[i].count += __atomic_load_n(&counters[i].count,
+                    __ATOMIC_RELAXED);
+            sums[i].time += __atomic_load_n(&counters[i].time,
+                    __ATOMIC_RELAXED);
+        }
+    }
+    pthread_mutex_unlock(&blocksMutex);
+}
+
+/**
+ * Reset the statistics of all the threads.
+ * @note No evaluation should be running, or its counts may be kept.
+ */
+void Statistics_reset() {
+
+    StatisticsBlock *block;
+
+    pthread_mutex_lock(&blocksMutex);
+    for (block = blocks; block != null; block = block->next) {
+        memset(&block->statistics, 0, sizeof(Statistics));
+    }
+    pthread_mutex_unlock(&blocksMutex);
+}
+
+string Statistics_getPhaseName(StatisticsPhase phase) {
+    return PHASE_NAMES[phase];
+}
@@ -0,0 +1,106 @@
+/**
+ * @file Statistics.h
+ * @author: Zhang Hai
+ */
+
+/*
+ * Copyright (C) 2014 Zhang Hai
+ *
+ * This file is part of calc.
+ *
+ * calc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * calc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with calc.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _STATISTICS_H_
+#define _STATISTICS_H_
+
+
+#include "zhclib/Common.h"
+
+#include <stdint.h>
+
+#include "Operator.h"
+
+
+/*
+ * Execution counters and timings of the evaluator, collected only when
+ * it is built with EVALUATOR_STATISTICS defined. Otherwise the hooks
+ * below expand to nothing, and the counters stay zero.
+ */
+
+typedef enum {
+    STATISTICS_PHASE_LEX,
+    STATISTICS_PHASE_PARSE,
+    STATISTICS_PHASE_EVALUATE
+} StatisticsPhase;
+
+#define STATISTICS_PHASE_COUNT (STATISTICS_PHASE_EVALUATE + 1)
+
+/* Registered functions are counted together, in the last slot. */
+#define STATISTICS_OPERATOR_SLOT_COUNT (OPERATOR_COUNT + 1)
+
+typedef struct {
+    uint64_t count;
+    /* Nanoseconds, including the cost of measuring them. */
+    uint64_t time;
+} StatisticsCounter;
+
+typedef struct {
+    StatisticsCounter operators[STATISTICS_OPERATOR_SLOT_COUNT];
+    StatisticsCounter phases[STATISTICS_PHASE_COUNT];
+} Statistics;
+
+
+#ifdef EVALUATOR_STATISTICS
+
+#define STATISTICS_DECLARE_TIME(time) uint64_t time
+
+#define STATISTICS_START(time) ((time) = Statistics_getTime())
+
+#define STATISTICS_ADD_OPERATOR(operator, count, time) \
+    Statistics_addOperator(operator, count, Statistics_getTime() - (time))
+
+#define STATISTICS_ADD_PHASE(phase, time) \
+    Statistics_addPhase(phase, Statistics_getTime() - (time))
+
+#else
+
+#define STATISTICS_DECLARE_TIME(time)
+
+#define STATISTICS_START(time) ((void)0)
+
+#define STATISTICS_ADD_OPERATOR(operator, count, time) ((void)0)
+
+#define STATISTICS_ADD_PHASE(phase, time) ((void)0)
+
+#endif
+
+
+bool Statistics_isEnabled();
+
+uint64_t Statistics_getTime();
+
+void Statistics_addOperator(Operator operator, size_t count,
+        uint64_t time);
+
+void Statistics_addPhase(StatisticsPhase phase, uint64_t time);
+
+void Statistics_get(Statistics *statistics);
+
+void Statistics_reset();
+
+string Statistics_getPhaseName(StatisticsPhase phase);
+
+
+#endif /* _STATISTICS_H_ */
@@ -0,0 +1,100 @@
+/**
+ * @file ArrayStack.h
+ * @author: Zhang Hai
+ */
+
+/*
+ * Copyright (C) 2014 Zhang Hai
+ *
+ * This file is part of zhclib.
+ *
+ * zhclib is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * zhclib is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with zhclib.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _ARRAY_STACK_H_
+#define _ARRAY_STACK_H_
+
+
+#include "primitives.h"
+#include "Memory.h"
+
+
+#define ARRAY_STACK_INITIAL_ALLOCATION_SIZE 16
+
+
+/**
+ * Define a stack that stores values of a type inline in a contiguous
+ * array, named TYPE##Stack.
+ * @note A zero-initialized stack is a valid empty stack, and clearing
+ *       a stack keeps its memory, so that a stack reused across calls
+ *       stops allocating once it has grown large enough.
+ */
+#define ARRAY_STACK_DEFINE(TYPE) \
+    typedef struct { \
+        TYPE *array; \
+        size_t size; \
+        size_t allocatedSize; \
+    } TYPE##Stack; \
+    \
+    static inline void TYPE##Stack_finalize(TYPE##Stack *stack) { \
+        Memory_free(stack->array); \
+        stack->array = null; \
+        stack->size = 0; \
+        stack->allocatedSize = 0; \
+    } \
+    \
+    static inline void TYPE##Stack_reserve(TYPE##Stack *stack, \
+            size_t size) { \
+        size_t allocatedSize = stack->allocatedSize; \
+        if (size <= allocatedSize) { \
+            return; \
+        } \
+        if (allocatedSize == 0) { \
+            allocatedSize = ARRAY_STACK_INITIAL_ALLOCATION_SIZE; \
+        } \
+        while (allocatedSize < size) { \
+            allocatedSize *= 2; \
+        } \
+        stack->array = Memory_reallocate(stack->array, \
+                allocatedSize * sizeof(TYPE)); \
+        stack->allocatedSize = allocatedSize; \
+    } \
+    \
+    static inline void TYPE##Stack_clear(TYPE##Stack *stack) { \
+        stack->size = 0; \
+    } \
+    \
+    static inline bool TYPE##Stack_isEmpty(TYPE##Stack *stack) { \
+        return stack->size == 0; \
+    } \
+    \
+    static inline void TYPE##Stack_push(TYPE##Stack *stack, \
+            TYPE data) { \
+        if (stack->size == stack->allocatedSize) { \
+            TYPE##Stack_reserve(stack, stack->size + 1); \
+        } \
+        stack->array[stack->size++] = data; \
+    } \
+    \
+    static inline TYPE TYPE##Stack_pop(TYPE##Stack *stack) { \
+        return stack->array[--stack->size]; \
+    } \
+    \
+    static inline TYPE *TYPE##Stack_peek(TYPE##Stack *stack) { \
+        return stack->size == 0 ? null \
+                : &stack->array[stack->size - 1]; \
+    }
+
+
+#endif /* _ARRAY_STACK_H_ */
@@ -0,0 +1,1961 @@
+/**
+ * @file BigFloat.c
+ * @author: Zhang Hai
+ */
+
+/*
+ * Copyright (C) 2014 Zhang Hai
+ *
+ * This file is part of zhclib.
+ *
+ * zhclib is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * zhclib is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with zhclib.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "BigFloat.h"
+
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/* Below this many limbs, schoolbook multiplication is faster. */
+#define KARATSUBA_THRESHOLD 32
+
+/* From this many limbs on, multiply with a number-theoretic transform. */
+#define NTT_THRESHOLD 512
+
+/* The transform works on digits of a smaller base than the limbs. */
+#define NTT_DIGIT_BASE 10000
+
+/* Largest integer whose factorial is computed as a product. */
+#define FACTORIAL_MAXIMUM 1000000
+
+/* Largest operand whose factorial is computed with the gamma series. */
+#define GAMMA_MAXIMUM 10000
+
+/* Largest argument of the exponential function. */
+#define EXP_ARGUMENT_MAXIMUM 1e15
+
+/*
+ * Goldilocks prime 2^64 - 2^32 + 1, which has roots of unity of every
+ * power of two up to 2^32 and allows a fast reduction.
+ */
+static const uint64_t NTT_MODULUS = 0xFFFFFFFF00000001ull;
+
+static const uint64_t NTT_GENERATOR = 7;
+
+/* 2^64 modulo NTT_MODULUS. */
+static const uint64_t NTT_EPSILON = 0xFFFFFFFFull;
+
+
+/* Constants cached at the highest precision requested so far. */
+
+static pthread_mutex_t BigFloat_cacheMutex = PTHREAD_MUTEX_INITIALIZER;
+
+static BigFloat BigFloat_e;
+
+static size_t BigFloat_ePrecision = 0;
+
+static BigFloat BigFloat_pi;
+
+static size_t BigFloat_piPrecision = 0;
+
+
+/*
+ * Limb arrays
+ */
+
+/**
+ * Add a limb array to another in place.
+ * @note The destination must be long enough to hold the carry.
+ */
+static void BigFloat_addLimbsTo(uint32_t *limbs, size_t length,
+        const uint32_t *addend, size_t addendLength) {
+
+    uint32_t carry = 0, sum;
+    size_t i;
+
+    for (i = 0; i < addendLength; ++i) {
+        sum = limbs[i] + addend[i] + carry;
+        carry = sum >= BIG_FLOAT_BASE;
+        limbs[i] = carry ? sum - BIG_FLOAT_BASE : sum;
+    }
+    for (; carry && i < length; ++i) {
+        sum = limbs[i] + 1;
+        carry = sum == BIG_FLOAT_BASE;
+        limbs[i] = carry ? 0 : sum;
+    }
+}
+
+/**
+ * Subtract a limb array from a not smaller one in place.
+ */
+static void BigFloat_subtractLimbsFrom(uint32_t *limbs, size_t length,
+        const uint32_t *subtrahend, size_t subtrahendLength) {
+
+    int32_t difference, borrow = 0;
+    size_t i;
+
+    for (i = 0; i < subtrahendLength; ++i) {
+        difference = (int32_t)limbs[i] - (int32_t)subtrahend[i] - borrow;
+        borrow = difference < 0;
+        limbs[i] = borrow ? difference + (int32_t)BIG_FLOAT_BASE
+                : difference;
+    }
+    for (; borrow && i < length; ++i) {
+        if (limbs[i] == 0) {
+            limbs[i] = BIG_FLOAT_BASE - 1;
+        } else {
+            --limbs[i];
+            borrow = 0;
+        }
+    }
+}
+
+static size_t BigFloat_trimLimbs(const uint32_t *limbs, size_t length) {
+    while (length > 1 && limbs[length - 1] == 0) {
+        --length;
+    }
+    return length;
+}
+
+static void BigFloat_multiplySchoolbook(uint32_t *product,
+        const uint32_t *limbs1, size_t length1, const uint32_t *limbs2,
+        size_t length2) {
+
+    uint64_t carry, current;
+    size_t i, j;
+
+    memset(product, 0, (length1 + length2) * sizeof(uint32_t));
+    for (i = 0; i < length1; ++i) {
+        if (limbs1[i] == 0) {
+            continue;
+        }
+        carry = 0;
+        for (j = 0; j < length2; ++j) {
+            current = (uint64_t)limbs1[i] * limbs2[j] + product[i + j]
+                    + carry;
+            product[i + j] = current % BIG_FLOAT_BASE;
+            carry = current / BIG_FLOAT_BASE;
+        }
+        product[i + length2] = carry;
+    }
+}
+
+static uint64_t BigFloat_reduceModulo(unsigned __int128 value) {
+
+    uint64_t low = (uint64_t)value, high = (uint64_t)(value >> 64),
+            highHigh = high >> 32, highLow = high & NTT_EPSILON, t0, t1,
+            result;
+
+    /* 2^96 is -1 and 2^64 is 2^32 - 1 modulo the prime. */
+    t0 = low - highHigh;
+    if (low < highHigh) {
+        t0 -= NTT_EPSILON;
+    }
+    t1 = highLow * NTT_EPSILON;
+    result = t0 + t1;
+    if (result < t1) {
+        result += NTT_EPSILON;
+    }
+    return result >= NTT_MODULUS ? result - NTT_MODULUS : result;
+}
+
+static uint64_t BigFloat_multiplyModulo(uint64_t value1, uint64_t value2) {
+    return BigFloat_reduceModulo((unsigned __int128)value1 * value2);
+}
+
+static uint64_t BigFloat_powerModulo(uint64_t base, uint64_t exponent) {
+    uint64_t result = 1;
+    while (exponent != 0) {
+        if (exponent & 1) {
+            result = BigFloat_multiplyModulo(result, base);
+        }
+        base = BigFloat_multiplyModulo(base, base);
+        exponent >>= 1;
+    }
+    return result;
+}
+
+/**
+ * Transform values in place with an iterative radix-2 number-theoretic
+ * transform.
+ * @param count The number of values, a power of two.
+ */
+static void BigFloat_transform(uint64_t *values, size_t count,
+        bool inverse) {
+
+    uint64_t *twiddles = Memory_allocate(count / 2 * sizeof(uint64_t)),
+            root, inverseCount, value1, value2, swap;
+    size_t i, j, bit, length, half;
+
+    for (i = 1, j = 0; i < count; ++i) {
+        for (bit = count >> 1; j & bit; bit >>= 1) {
+            j ^= bit;
+        }
+        j ^= bit;
+        if (i < j) {
+            swap = values[i];
+            values[i] = values[j];
+            values[j] = swap;
+        }
+    }
+
+    for (length = 2; length <= count; length <<= 1) {
+        half = length / 2;
+        root = BigFloat_powerModulo(NTT_GENERATOR,
+                (NTT_MODULUS - 1) / length);
+        if (inverse) {
+            root = BigFloat_powerModulo(root, NTT_MODULUS - 2);
+        }
+        twiddles[0] = 1;
+        for (j = 1; j < half; ++j) {
+            twiddles[j] = BigFloat_multiplyModulo(twiddles[j - 1], root);
+        }
+        for (i = 0; i < count; i += length) {
+            for (j = 0; j < half; ++j) {
+                value1 = values[i + j];
+                value2 = BigFloat_multiplyModulo(values[i + j + half],
+                        twiddles[j]);
+                values[i + j] = value1 + value2 - (value1 + value2 < value1
+                        || value1 + value2 >= NTT_MODULUS ? NTT_MODULUS
+                        : 0);
+                values[i + j + half] = value1 >= value2 ? value1 - value2
+                        : value1 + NTT_MODULUS - value2;
+            }
+        }
+    }
+
+    if (inverse) {
+        inverseCount = BigFloat_powerModulo(count, NTT_MODULUS - 2);
+        for (i = 0; i < count; ++i) {
+            values[i] = BigFloat_multiplyModulo(values[i], inverseCount);
+        }
+    }
+
+    Memory_free(twiddles);
+}
+
+/**
+ * Multiply limb arrays as a convolution of their digits, computed with
+ * number-theoretic transforms in O(n log n).
+ * @note Each digit of the convolution is less than the length times
+ *       NTT_DIGIT_BASE squared, far below the prime.
+ */
+static void BigFloat_multiplyNtt(uint32_t *product, const uint32_t *limbs1,
+        size_t length1, const uint32_t *limbs2, size_t length2) {
+
+    size_t digitCount = 2 * (length1 + length2), count = 1, i;
+    uint64_t *values1, *values2, carry = 0, low, high;
+
+    while (count < digitCount) {
+        count <<= 1;
+    }
+    values1 = Memory_allocate(count * sizeof(uint64_t));
+    values2 = Memory_allocate(count * sizeof(uint64_t));
+    for (i = 0; i < length1; ++i) {
+        values1[2 * i] = limbs1[i] % NTT_DIGIT_BASE;
+        values1[2 * i + 1] = limbs1[i] / NTT_DIGIT_BASE;
+    }
+    for (i = 0; i < length2; ++i) {
+        values2[2 * i] = limbs2[i] % NTT_DIGIT_BASE;
+        values2[2 * i + 1] = limbs2[i] / NTT_DIGIT_BASE;
+    }
+
+    BigFloat_transform(values1, count, false);
+    BigFloat_transform(values2, count, false);
+    for (i = 0; i < count; ++i) {
+        values1[i] = BigFloat_multiplyModulo(values1[i], values2[i]);
+    }
+    BigFloat_transform(values1, count, true);
+
+    for (i = 0; i < length1 + length2; ++i) {
+        low = values1[2 * i] + carry;
+        carry = low / NTT_DIGIT_BASE;
+        high = values1[2 * i + 1] + carry;
+        carry = high / NTT_DIGIT_BASE;
+        product[i] = (high % NTT_DIGIT_BASE) * NTT_DIGIT_BASE
+                + low % NTT_DIGIT_BASE;
+    }
+
+    Memory_free(values2);
+    Memory_free(values1);
+}
+
+static void BigFloat_multiplyLimbs(uint32_t *product,
+        const uint32_t *limbs1, size_t length1, const uint32_t *limbs2,
+        size_t length2);
+
+/**
+ * Multiply limb arrays of similar lengths with Karatsuba's method,
+ * which needs three half-size products instead of four.
+ */
+static void BigFloat_multiplyKaratsuba(uint32_t *product,
+        const uint32_t *limbs1, size_t length1, const uint32_t *limbs2,
+        size_t length2) {
+
+    size_t half = length1 / 2, high1Length = length1 - half,
+            high2Length = length2 - half, sum1Length = high1Length + 1,
+            sum2Length = MAX(half, high2Length) + 1, middleLength;
+    uint32_t *sum1 = Memory_allocate(sum1Length * sizeof(uint32_t)),
+            *sum2 = Memory_allocate(sum2Length * sizeof(uint32_t)),
+            *middle;
+
+    /* The low and high products fill the product without overlapping. */
+    BigFloat_multiplyLimbs(product, limbs1, half, limbs2, half);
+    BigFloat_multiplyLimbs(product + 2 * half, limbs1 + half, high1Length,
+            limbs2 + half, high2Length);
+
+    memcpy(sum1, limbs1 + half, high1Length * sizeof(uint32_t));
+    BigFloat_addLimbsTo(sum1, sum1Length, limbs1, half);
+    if (high2Length >= half) {
+        memcpy(sum2, limbs2 + half, high2Length * sizeof(uint32_t));
+        BigFloat_addLimbsTo(sum2, sum2Length, limbs2, half);
+    } else {
+        memcpy(sum2, limbs2, half * sizeof(uint32_t));
+        BigFloat_addLimbsTo(sum2, sum2Length, limbs2 + half, high2Length);
+    }
+    sum1Length = BigFloat_trimLimbs(sum1, sum1Length);
+    sum2Length = BigFloat_trimLimbs(sum2, sum2Length);
+
+    middleLength = sum1Length + sum2Length;
+    middle = Memory_allocate(middleLength * sizeof(uint32_t));
+    BigFloat_multiplyLimbs(middle, sum1, sum1Length, sum2, sum2Length);
+    /* The low and high products may have zero limbs on top. */
+    BigFloat_subtractLimbsFrom(middle, middleLength, product,
+            BigFloat_trimLimbs(product, 2 * half));
+    BigFloat_subtractLimbsFrom(middle, middleLength, product + 2 * half,
+            BigFloat_trimLimbs(product + 2 * half,
+                    length1 + length2 - 2 * half));
+    middleLength = BigFloat_trimLimbs(middle, middleLength);
+    BigFloat_addLimbsTo(product + half, length1 + length2 - half, middle,
+            middleLength);
+
+    Memory_free(middle);
+    Memory_free(sum2);
+    Memory_free(sum1);
+}
+
+/**
+ * Multiply limb arrays, choosing the algorithm by their lengths.
+ * @param product The product, with length1 + length2 limbs.
+ */
+static void BigFloat_multiplyLimbs(uint32_t *product,
+        const uint32_t *limbs1, size_t length1, const uint32_t *limbs2,
+        size_t length2) {
+
+    const uint32_t *swapLimbs;
+    uint32_t *slice;
+    size_t swapLength, start, sliceLength;
+
+    if (length1 < length2) {
+        SWAP(limbs1, limbs2, swapLimbs);
+        SWAP(length1, length2, swapLength);
+    }
+
+    if (length2 < KARATSUBA_THRESHOLD) {
+        BigFloat_multiplySchoolbook(product, limbs1, length1, limbs2,
+                length2);
+    } else if (length2 >= NTT_THRESHOLD) {
+        BigFloat_multiplyNtt(product, limbs1, length1, limbs2, length2);
+    } else if (2 * length2 <= length1) {
+        /* Unbalanced, so multiply slices of the longer one. */
+        memset(product, 0, (length1 + length2) * sizeof(uint32_t));
+        slice = Memory_allocate(2 * length2 * sizeof(uint32_t));
+        for (start = 0; start < length1; start += length2) {
+            sliceLength = MIN(length2, length1 - start);
+            BigFloat_multiplyLimbs(slice, limbs1 + start, sliceLength,
+                    limbs2, length2);
+            BigFloat_addLimbsTo(product + start, length1 + length2 - start,
+                    slice, sliceLength + length2);
+        }
+        Memory_free(slice);
+    } else {
+        BigFloat_multiplyKaratsuba(product, limbs1, length1, limbs2,
+                length2);
+    }
+}
+
+
+/*
+ * Numbers
+ */
+
+static void BigFloat_reserve(BigFloat *number, size_t length) {
+    if (length > number->allocatedLength) {
+        number->allocatedLength = MAX(length, 2 * number->allocatedLength);
+        number->limbs = Memory_reallocate(number->limbs,
+                number->allocatedLength * sizeof(uint32_t));
+    }
+}
+
+static void BigFloat_swap(BigFloat *number1, BigFloat *number2) {
+    BigFloat swap;
+    SWAP(*number1, *number2, swap);
+}
+
+static void BigFloat_setZero(BigFloat *number) {
+    number->sign = 0;
+    number->exponent = 0;
+    number->length = 0;
+}
+
+/**
+ * Strip zero limbs and round to the nearest number with at most
+ * precision limbs.
+ */
+static void BigFloat_normalize(BigFloat *number, size_t precision) {
+
+    uint32_t *limbs = number->limbs;
+    size_t length = number->length, dropCount, zeroCount = 0, i;
+    bool roundUp;
+
+    while (length > 0 && limbs[length - 1] == 0) {
+        --length;
+    }
+
+    if (length > precision) {
+        dropCount = length - precision;
+        roundUp = limbs[dropCount - 1] >= BIG_FLOAT_BASE / 2;
+        memmove(limbs, limbs + dropCount, precision * sizeof(uint32_t));
+        length = precision;
+        number->exponent += dropCount;
+        if (roundUp) {
+            for (i = 0; i < length && ++limbs[i] == BIG_FLOAT_BASE; ++i) {
+                limbs[i] = 0;
+            }
+            if (i == length) {
+                /* There is room, since at least one limb was dropped. */
+                limbs[length++] = 1;
+            }
+        }
+    }
+
+    while (zeroCount < length && limbs[zeroCount] == 0) {
+        ++zeroCount;
+    }
+    if (zeroCount > 0) {
+        memmove(limbs, limbs + zeroCount,
+                (length - zeroCount) * sizeof(uint32_t));
+        length -= zeroCount;
+        number->exponent += zeroCount;
+    }
+
+    number->length = length;
+    if (length == 0) {
+        BigFloat_setZero(number);
+    }
+}
+
+/**
+ * Get the exponent just above the most significant limb.
+ */
+static long BigFloat_getTop(BigFloat *number) {
+    return number->exponent + (long)number->length;
+}
+
+/**
+ * Check whether a term no longer changes a sum at a precision.
+ */
+static bool BigFloat_isNegligible(BigFloat *term, BigFloat *sum,
+        size_t precision) {
+    return term->sign == 0 || BigFloat_getTop(term)
+            < BigFloat_getTop(sum) - (long)precision - 1;
+}
+
+/**
+ * Get the precision a term needs to keep a sum exact at a precision,
+ * which shrinks as the terms of a series get smaller.
+ */
+static size_t BigFloat_getTermPrecision(BigFloat *term, BigFloat *sum,
+        size_t precision) {
+    long drop = BigFloat_getTop(sum) - BigFloat_getTop(term);
+    return drop <= 0 ? precision : drop >= (long)precision ? 2
+            : precision - drop + 2;
+}
+
+static int BigFloat_compareMagnitudes(BigFloat *number1,
+        BigFloat *number2) {
+
+    long i, j;
+
+    if (number1->length == 0 || number2->length == 0) {
+        return (number1->length != 0) - (number2->length != 0);
+    }
+    if (BigFloat_getTop(number1) != BigFloat_getTop(number2)) {
+        return BigFloat_getTop(number1) > BigFloat_getTop(number2)
+                ? 1 : -1;
+    }
+
+    for (i = number1->length - 1, j = number2->length - 1;
+            i >= 0 && j >= 0; --i, --j) {
+        if (number1->limbs[i] != number2->limbs[j]) {
+            return number1->limbs[i] > number2->limbs[j] ? 1 : -1;
+        }
+    }
+    /* Normalized numbers have no zero limb at the bottom. */
+    return (i >= 0) - (j >= 0);
+}
+
+/**
+ * Add or subtract magnitudes, where the first is not smaller when
+ * subtracting.
+ * @note Limbs far below the precision are dropped before the
+ *       operation, so that adding numbers of very different magnitudes
+ *       stays cheap.
+ */
+static void BigFloat_addMagnitudes(BigFloat *result, BigFloat *number1,
+        BigFloat *number2, bool subtract, int sign, size_t precision) {
+
+    long top = MAX(BigFloat_getTop(number1), BigFloat_getTop(number2)),
+            low = MIN(number1->exponent, number2->exponent), position;
+    size_t length, i, skip;
+    BigFloat sum;
+
+    if (precision != BIG_FLOAT_EXACT && top - low > (long)precision + 2) {
+        low = top - (long)precision - 2;
+    }
+    length = top - low + 1;
+
+    BigFloat_initialize(&sum);
+    BigFloat_reserve(&sum, length);
+    memset(sum.limbs, 0, length * sizeof(uint32_t));
+    for (i = 0; i < number1->length; ++i) {
+        position = number1->exponent + (long)i - low;
+        if (position >= 0) {
+            sum.limbs[position] = number1->limbs[i];
+        }
+    }
+    skip = number2->exponent < low ? low - number2->exponent : 0;
+    if (skip < number2->length) {
+        position = number2->exponent + (long)skip - low;
+        if (subtract) {
+            BigFloat_subtractLimbsFrom(sum.limbs + position,
+                    length - position, number2->limbs + skip,
+                    number2->length - skip);
+        } else {
+            BigFloat_addLimbsTo(sum.limbs + position, length - position,
+                    number2->limbs + skip, number2->length - skip);
+        }
+    }
+    sum.length = length;
+    sum.exponent = low;
+    sum.sign = sign;
+    BigFloat_normalize(&sum, precision);
+
+    BigFloat_swap(result, &sum);
+    BigFloat_finalize(&sum);
+}
+
+static void BigFloat_addSigned(BigFloat *result, BigFloat *number1,
+        BigFloat *number2, int sign2, size_t precision) {
+
+    int sign1 = number1->sign, comparison;
+
+    if (sign2 == 0) {
+        BigFloat_round(result, number1, precision);
+    } else if (sign1 == 0) {
+        BigFloat_round(result, number2, precision);
+        result->sign = sign2;
+    } else if (sign1 == sign2) {
+        BigFloat_addMagnitudes(result, number1, number2, false, sign1,
+                precision);
+    } else {
+        comparison = BigFloat_compareMagnitudes(number1, number2);
+        if (comparison == 0) {
+            BigFloat_setZero(result);
+        } else if (comparison > 0) {
+            BigFloat_addMagnitudes(result, number1, number2, true, sign1,
+                    precision);
+        } else {
+            BigFloat_addMagnitudes(result, number2, number1, true, sign2,
+                    precision);
+        }
+    }
+}
+
+/**
+ * Get the value of an integer that fits in a long.
+ * @return Whether the number is such an integer.
+ */
+static bool BigFloat_getLong(BigFloat *number, long *value) {
+
+    unsigned long magnitude = 0;
+    size_t i;
+
+    /* Anything below BIG_FLOAT_BASE ^ 2 fits. */
+    if (!BigFloat_isInteger(number) || BigFloat_getTop(number) > 2) {
+        return false;
+    }
+    for (i = number->length; i-- > 0;) {
+        magnitude = magnitude * BIG_FLOAT_BASE + number->limbs[i];
+    }
+    for (i = 0; i < (size_t)number->exponent; ++i) {
+        magnitude *= BIG_FLOAT_BASE;
+    }
+    *value = number->sign * (long)magnitude;
+    return true;
+}
+
+/**
+ * Round a number to the nearest integer, with halves away from zero.
+ */
+static void BigFloat_roundToInteger(BigFloat *result, BigFloat *number) {
+
+    size_t fractionLength;
+    bool roundUp;
+    BigFloat integer;
+
+    if (number->exponent >= 0) {
+        BigFloat_set(result, number);
+        return;
+    }
+
+    fractionLength = -number->exponent;
+    BigFloat_initialize(&integer);
+    if (fractionLength >= number->length) {
+        roundUp = fractionLength == number->length
+                && number->limbs[number->length - 1]
+                        >= BIG_FLOAT_BASE / 2;
+        BigFloat_setInteger(&integer, roundUp ? number->sign : 0);
+    } else {
+        roundUp = number->limbs[fractionLength - 1] >= BIG_FLOAT_BASE / 2;
+        BigFloat_reserve(&integer, number->length - fractionLength + 1);
+        memcpy(integer.limbs, number->limbs + fractionLength,
+                (number->length - fractionLength) * sizeof(uint32_t));
+        integer.limbs[number->length - fractionLength] = 0;
+        if (roundUp) {
+            BigFloat_addLimbsTo(integer.limbs,
+                    number->length - fractionLength + 1,
+                    (uint32_t[]) {1}, 1);
+        }
+        integer.length = number->length - fractionLength + 1;
+        integer.sign = number->sign;
+        BigFloat_normalize(&integer, BIG_FLOAT_EXACT);
+    }
+
+    BigFloat_swap(result, &integer);
+    BigFloat_finalize(&integer);
+}
+
+/**
+ * Get the precision in limbs for a number of significant decimal
+ * digits, including a guard limb.
+ */
+size_t BigFloat_getPrecisionForDigits(size_t digits) {
+    return (digits + BIG_FLOAT_BASE_DIGITS - 1) / BIG_FLOAT_BASE_DIGITS
+            + 1;
+}
+
+/**
+ * Initialize a {@link BigFloat} to zero.
+ * @note A zero-initialized BigFloat is already a valid zero.
+ */
+void BigFloat_initialize(BigFloat *number) {
+    memset(number, 0, sizeof(BigFloat));
+}
+
+void BigFloat_finalize(BigFloat *number) {
+    Memory_free(number->limbs);
+    BigFloat_initialize(number);
+}
+
+BigFloat *BigFloat_new() {
+    return Memory_allocateType(BigFloat);
+}
+
+void BigFloat_delete(BigFloat *number) {
+    BigFloat_finalize(number);
+    Memory_free(number);
+}
+
+void BigFloat_set(BigFloat *result, BigFloat *number) {
+    if (result == number) {
+        return;
+    }
+    BigFloat_reserve(result, number->length);
+    memcpy(result->limbs, number->limbs,
+            number->length * sizeof(uint32_t));
+    result->sign = number->sign;
+    result->exponent = number->exponent;
+    result->length = number->length;
+}
+
+void BigFloat_round(BigFloat *result, BigFloat *number,
+        size_t precision) {
+    BigFloat_set(result, number);
+    BigFloat_normalize(result, precision);
+}
+
+void BigFloat_setInteger(BigFloat *result, long value) {
+
+    unsigned long magnitude = value < 0 ? -(unsigned long)value
+            : (unsigned long)value;
+
+    BigFloat_reserve(result, 3);
+    result->length = 0;
+    while (magnitude != 0) {
+        result->limbs[result->length++] = magnitude % BIG_FLOAT_BASE;
+        magnitude /= BIG_FLOAT_BASE;
+    }
+    result->sign = (value > 0) - (value < 0);
+    result->exponent = 0;
+    BigFloat_normalize(result, BIG_FLOAT_EXACT);
+}
+
+/**
+ * Set a {@link BigFloat} to the value of a double.
+ * @return Whether the double is finite.
+ */
+bool BigFloat_setDouble(BigFloat *result, double value,
+        size_t precision) {
+
+    int binaryExponent, chunk;
+    double mantissa;
+
+    if (!isfinite(value)) {
+        return false;
+    }
+
+    mantissa = frexp(fabs(value), &binaryExponent);
+    BigFloat_setInteger(result, (long)ldexp(mantissa, 53));
+    for (binaryExponent -= 53; binaryExponent > 0;
+            binaryExponent -= chunk) {
+        chunk = MIN(binaryExponent, 30);
+        BigFloat_multiplySmall(result, result, 1u << chunk, precision);
+    }
+    for (; binaryExponent < 0; binaryExponent += chunk) {
+        chunk = MIN(-binaryExponent, 30);
+        BigFloat_divideSmall(result, result, 1u << chunk, precision);
+    }
+    if (value < 0) {
+        result->sign = -result->sign;
+    }
+    return true;
+}
+
+/**
+ * Parse an unsigned decimal number, with an optional fraction and
+ * exponent.
+ * @note Digits far beyond the precision are ignored.
+ * @return Whether the whole text is such a number.
+ */
+bool BigFloat_parse(BigFloat *result, const char *text, size_t length,
+        size_t precision) {
+
+    string digits = string_allocate(length);
+    size_t position = 0, digitCount = 0, maximumDigitCount, totalCount,
+            padding;
+    long exponent = 0, explicitExponent = 0, digitPosition, end;
+    bool hasDigit = false, hasPoint = false, negativeExponent = false,
+            hasExponentDigit = false;
+    uint32_t limb;
+    char c;
+
+    for (; position < length; ++position) {
+        c = text[position];
+        if (c >= '0' && c <= '9') {
+            hasDigit = true;
+            if (digitCount > 0 || c != '0') {
+                digits[digitCount++] = c;
+            }
+            if (hasPoint) {
+                --exponent;
+            }
+        } else if (c == '.' && !hasPoint) {
+            hasPoint = true;
+        } else {
+            break;
+        }
+    }
+    if (hasDigit && position < length
+            && (text[position] == 'e' || text[position] == 'E')) {
+        ++position;
+        if (position < length
+                && (text[position] == '+' || text[position] == '-')) {
+            negativeExponent = text[position] == '-';
+            ++position;
+        }
+        for (; position < length && text[position] >= '0'
+                && text[position] <= '9'; ++position) {
+            hasExponentDigit = true;
+            if (explicitExponent < 1000000000000000L) {
+                explicitExponent = explicitExponent * 10
+                        + (text[position] - '0');
+            }
+        }
+        hasDigit = hasExponentDigit;
+    }
+    if (!hasDigit || position != length) {
+        Memory_free(digits);
+        return false;
+    }
+
+    if (digitCount == 0) {
+        Memory_free(digits);
+        BigFloat_setZero(result);
+        return true;
+    }
+
+    exponent += negativeExponent ? -explicitExponent : explicitExponent;
+    if (precision != BIG_FLOAT_EXACT) {
+        maximumDigitCount = (precision + 2) * BIG_FLOAT_BASE_DIGITS;
+        if (digitCount > maximumDigitCount) {
+            exponent += digitCount - maximumDigitCount;
+            digitCount = maximumDigitCount;
+        }
+    }
+    /* Pad with zeros on the right to align to a limb. */
+    padding = ((exponent % BIG_FLOAT_BASE_DIGITS) + BIG_FLOAT_BASE_DIGITS)
+            % BIG_FLOAT_BASE_DIGITS;
+    exponent -= padding;
+    totalCount = digitCount + padding;
+
+    BigFloat_reserve(result, (totalCount + BIG_FLOAT_BASE_DIGITS - 1)
+            / BIG_FLOAT_BASE_DIGITS);
+    result->length = 0;
+    for (end = totalCount; end > 0; end -= BIG_FLOAT_BASE_DIGITS) {
+        limb = 0;
+        for (digitPosition = end - BIG_FLOAT_BASE_DIGITS;
+                digitPosition < end; ++digitPosition) {
+            limb *= 10;
+            if (digitPosition >= 0 && digitPosition < (long)digitCount) {
+                limb += digits[digitPosition] - '0';
+            }
+        }
+        result->limbs[result->length++] = limb;
+    }
+    result->exponent = exponent / BIG_FLOAT_BASE_DIGITS;
+    result->sign = 1;
+    BigFloat_normalize(result, precision);
+
+    Memory_free(digits);
+    return true;
+}
+
+/**
+ * Format a number with at most a number of significant digits, like
+ * the %g conversion of printf.
+ * @return The formatted string, to be freed by the caller.
+ */
+string BigFloat_toString(BigFloat *number, size_t digits) {
+
+    string allDigits, mantissa, text;
+    size_t allCount, leadingCount = 0, mantissaCount, i;
+    long pointPosition, exponent;
+    bool carried;
+
+    if (number->sign == 0) {
+        return string_clone("0");
+    }
+    if (digits == 0) {
+        digits = 1;
+    }
+
+    /* Keep a zero in front for the carry of rounding. */
+    allCount = number->length * BIG_FLOAT_BASE_DIGITS + 1;
+    allDigits = string_allocate(allCount);
+    for (i = 0; i < number->length; ++i) {
+        sprintf(allDigits + 1 + i * BIG_FLOAT_BASE_DIGITS, "%08u",
+                number->limbs[number->length - 1 - i]);
+    }
+    while (allDigits[leadingCount + 1] == '0') {
+        ++leadingCount;
+    }
+    mantissa = allDigits + leadingCount;
+    mantissa[0] = '0';
+    mantissaCount = allCount - leadingCount;
+    pointPosition = BigFloat_getTop(number) * BIG_FLOAT_BASE_DIGITS
+            - (long)leadingCount + 1;
+
+    if (mantissaCount > digits + 1) {
+        carried = mantissa[digits + 1] >= '5';
+        mantissaCount = digits + 1;
+        for (i = digits; carried && i > 0; --i) {
+            carried = mantissa[i] == '9';
+            mantissa[i] = carried ? '0' : mantissa[i] + 1;
+        }
+        if (carried) {
+            mantissa[0] = '1';
+        }
+    }
+    if (mantissa[0] == '0') {
+        ++mantissa;
+        --mantissaCount;
+        --pointPosition;
+    }
+    while (mantissaCount > 1 && mantissa[mantissaCount - 1] == '0') {
+        --mantissaCount;
+    }
+    mantissa[mantissaCount] = '\0';
+
+    exponent = pointPosition - 1;
+    if (exponent < -5 || exponent >= (long)digits) {
+        text = string_format("%s%c%s%se%c%02ld",
+                number->sign < 0 ? "-" : "", mantissa[0],
+                mantissaCount > 1 ? "." : "", mantissa + 1,
+                exponent < 0 ? '-' : '+', labs(exponent));
+    } else if (pointPosition <= 0) {
+        text = string_format("%s0.%0*d%s", number->sign < 0 ? "-" : "",
+                (int)-pointPosition, 0, mantissa);
+        /* %0*d prints one zero for a width of zero. */
+        if (pointPosition == 0) {
+            memmove(text + (number->sign < 0) + 2,
+                    text + (number->sign < 0) + 3,
+                    string_length(text + (number->sign < 0) + 3) + 1);
+        }
+    } else if (pointPosition >= (long)mantissaCount) {
+        text = string_format("%s%s%0*d", number->sign < 0 ? "-" : "",
+                mantissa, (int)(pointPosition - mantissaCount), 0);
+        if (pointPosition == (long)mantissaCount) {
+            text[string_length(text) - 1] = '\0';
+        }
+    } else {
+        text = string_format("%s%.*s.%s", number->sign < 0 ? "-" : "",
+                (int)pointPosition, mantissa, mantissa + pointPosition);
+    }
+
+    Memory_free(allDigits);
+    return text;
+}
+
+/**
+ * Get the double nearest to a number, from its three most
+ * significant limbs.
+ */
+double BigFloat_toDouble(BigFloat *number) {
+
+    char text[64];
+    size_t count = MIN(number->length, 3), position = 0, i;
+
+    if (number->sign == 0) {
+        return 0;
+    }
+
+    /* Let the C library round the decimal correctly. */
+    if (number->sign < 0) {
+        text[position++] = '-';
+    }
+    for (i = 0; i < count; ++i) {
+        position += sprintf(text + position, i == 0 ? "%u" : "%08u",
+                number->limbs[number->length - 1 - i]);
+    }
+    sprintf(text + position, "e%ld", (BigFloat_getTop(number)
+            - (long)count) * BIG_FLOAT_BASE_DIGITS);
+    return strtod(text, null);
+}
+
+bool BigFloat_isZero(BigFloat *number) {
+    return number->sign == 0;
+}
+
+bool BigFloat_isInteger(BigFloat *number) {
+    return number->sign == 0 || number->exponent >= 0;
+}
+
+int BigFloat_compare(BigFloat *number1, BigFloat *number2) {
+    if (number1->sign != number2->sign) {
+        return number1->sign > number2->sign ? 1 : -1;
+    }
+    return number1->sign * BigFloat_compareMagnitudes(number1, number2);
+}
+
+void BigFloat_negate(BigFloat *result, BigFloat *number) {
+    BigFloat_set(result, number);
+    result->sign = -result->sign;
+}
+
+/**
+ * Round a number to an integer, toward negative infinity if direction
+ * is -1 or toward positive infinity if it is 1.
+ */
+static void BigFloat_roundToIntegerToward(BigFloat *result,
+        BigFloat *number, int direction) {
+
+    BigFloat integer, step;
+
+    BigFloat_initialize(&integer);
+    BigFloat_initialize(&step);
+    BigFloat_roundToInteger(&integer, number);
+    if (BigFloat_compare(&integer, number) == -direction) {
+        BigFloat_setInteger(&step, direction);
+        BigFloat_add(&integer, &integer, &step, BIG_FLOAT_EXACT);
+    }
+    BigFloat_swap(result, &integer);
+    BigFloat_finalize(&step);
+    BigFloat_finalize(&integer);
+}
+
+/**
+ * Get the largest integer not greater than a number.
+ */
+void BigFloat_floor(BigFloat *result, BigFloat *number) {
+    BigFloat_roundToIntegerToward(result, number, -1);
+}
+
+/**
+ * Get the smallest integer not less than a number.
+ */
+void BigFloat_ceil(BigFloat *result, BigFloat *number) {
+    BigFloat_roundToIntegerToward(result, number, 1);
+}
+
+void BigFloat_add(BigFloat *result, BigFloat *number1,
+        BigFloat *number2, size_t precision) {
+    BigFloat_addSigned(result, number1, number2, number2->sign,
+            precision);
+}
+
+void BigFloat_subtract(BigFloat *result, BigFloat *number1,
+        BigFloat *number2, size_t precision) {
+    BigFloat_addSigned(result, number1, number2, -number2->sign,
+            precision);
+}
+
+/**
+ * Multiply numbers.
+ * @note Only the limbs that can affect the rounded product are
+ *       multiplied, with Karatsuba's method or a number-theoretic
+ *       transform when they are long.
+ */
+void BigFloat_multiply(BigFloat *result, BigFloat *number1,
+        BigFloat *number2, size_t precision) {
+
+    size_t skip1 = 0, skip2 = 0, length1, length2;
+    BigFloat product;
+
+    if (number1->sign == 0 || number2->sign == 0) {
+        BigFloat_setZero(result);
+        return;
+    }
+
+    if (precision != BIG_FLOAT_EXACT) {
+        if (number1->length > precision + 1) {
+            skip1 = number1->length - precision - 1;
+        }
+        if (number2->length > precision + 1) {
+            skip2 = number2->length - precision - 1;
+        }
+    }
+    length1 = number1->length - skip1;
+    length2 = number2->length - skip2;
+
+    BigFloat_initialize(&product);
+    BigFloat_reserve(&product, length1 + length2);
+    BigFloat_multiplyLimbs(product.limbs, number1->limbs + skip1, length1,
+            number2->limbs + skip2, length2);
+    product.length = length1 + length2;
+    product.exponent = number1->exponent + number2->exponent + skip1
+            + skip2;
+    product.sign = number1->sign * number2->sign;
+    BigFloat_normalize(&product, precision);
+
+    BigFloat_swap(result, &product);
+    BigFloat_finalize(&product);
+}
+
+void BigFloat_multiplySmall(BigFloat *result, BigFloat *number,
+        uint32_t multiplier, size_t precision) {
+
+    uint64_t carry = 0, current;
+    size_t i;
+    BigFloat product;
+
+    if (number->sign == 0 || multiplier == 0) {
+        BigFloat_setZero(result);
+        return;
+    }
+
+    BigFloat_initialize(&product);
+    BigFloat_reserve(&product, number->length + 2);
+    for (i = 0; i < number->length; ++i) {
+        current = (uint64_t)number->limbs[i] * multiplier + carry;
+        product.limbs[i] = current % BIG_FLOAT_BASE;
+        carry = current / BIG_FLOAT_BASE;
+    }
+    for (; carry != 0; ++i) {
+        product.limbs[i] = carry % BIG_FLOAT_BASE;
+        carry /= BIG_FLOAT_BASE;
+    }
+    product.length = i;
+    product.exponent = number->exponent;
+    product.sign = number->sign;
+    BigFloat_normalize(&product, precision);
+
+    BigFloat_swap(result, &product);
+    BigFloat_finalize(&product);
+}
+
+/**
+ * Divide a number by an integer below BIG_FLOAT_BASE ^ 2 with long
+ * division.
+ */
+static void BigFloat_divideLong(BigFloat *result, BigFloat *number,
+        uint64_t divisor, size_t precision) {
+
+    uint64_t remainder = 0, current;
+    unsigned __int128 wideCurrent;
+    long index = (long)number->length - 1;
+    size_t count = 0, i;
+    uint32_t swap;
+    BigFloat quotient;
+
+    /* Quotient limbs are produced from the most significant one. */
+    BigFloat_initialize(&quotient);
+    while ((index >= 0 || remainder != 0) && (precision == BIG_FLOAT_EXACT
+            || count < precision + 3)) {
+        BigFloat_reserve(&quotient, count + 1);
+        if (divisor <= UINT32_MAX) {
+            current = remainder * BIG_FLOAT_BASE
+                    + (index >= 0 ? number->limbs[index] : 0);
+            quotient.limbs[count++] = current / divisor;
+            remainder = current % divisor;
+        } else {
+            wideCurrent = (unsigned __int128)remainder * BIG_FLOAT_BASE
+                    + (index >= 0 ? number->limbs[index] : 0);
+            quotient.limbs[count++] = wideCurrent / divisor;
+            remainder = wideCurrent % divisor;
+        }
+        --index;
+    }
+    for (i = 0; i < count / 2; ++i) {
+        SWAP(quotient.limbs[i], quotient.limbs[count - 1 - i], swap);
+    }
+    quotient.length = count;
+    quotient.exponent = BigFloat_getTop(number) - (long)count;
+    quotient.sign = number->sign;
+    BigFloat_normalize(&quotient, precision);
+
+    BigFloat_swap(result, &quotient);
+    BigFloat_finalize(&quotient);
+}
+
+/**
+ * Get the reciprocal of a number with Newton's iteration
+ * y = y + y (1 - x y), doubling the precision each step.
+ */
+static void BigFloat_reciprocal(BigFloat *result, BigFloat *number,
+        size_t precision) {
+
+    size_t count = MIN(number->length, 3), currentPrecision = 2, i;
+    double top = 0;
+    bool isFinal = false;
+    BigFloat reciprocal, error, one;
+
+    BigFloat_initialize(&reciprocal);
+    BigFloat_initialize(&error);
+    BigFloat_initialize(&one);
+    BigFloat_setInteger(&one, 1);
+
+    for (i = 0; i < count; ++i) {
+        top = top * BIG_FLOAT_BASE + number->limbs[number->length - 1 - i];
+    }
+    BigFloat_setDouble(&reciprocal, 1 / top, 3);
+    reciprocal.exponent -= BigFloat_getTop(number) - (long)count;
+    reciprocal.sign = number->sign;
+
+    while (true) {
+        currentPrecision = MIN(2 * currentPrecision, precision);
+        BigFloat_multiply(&error, number, &reciprocal,
+                currentPrecision + 1);
+        BigFloat_subtract(&error, &one, &error, currentPrecision + 1);
+        BigFloat_multiply(&error, &reciprocal, &error,
+                currentPrecision + 1);
+        BigFloat_add(&reciprocal, &reciprocal, &error, currentPrecision);
+        /* One more step at full precision to settle the last limb. */
+        if (currentPrecision == precision) {
+            if (isFinal) {
+                break;
+            }
+            isFinal = true;
+        }
+    }
+
+    BigFloat_swap(result, &reciprocal);
+    BigFloat_finalize(&one);
+    BigFloat_finalize(&error);
+    BigFloat_finalize(&reciprocal);
+}
+
+/**
+ * Divide numbers.
+ * @note The precision must not be BIG_FLOAT_EXACT.
+ * @return Whether the divisor is not zero.
+ */
+bool BigFloat_divide(BigFloat *result, BigFloat *number1,
+        BigFloat *number2, size_t precision) {
+
+    uint64_t divisor;
+    int sign;
+    long exponent;
+    BigFloat reciprocal;
+
+    if (number2->sign == 0) {
+        return false;
+    }
+    if (number1->sign == 0) {
+        BigFloat_setZero(result);
+        return true;
+    }
+
+    /* Divisors of up to two limbs, like most literals, divide directly. */
+    if (number2->length <= 2) {
+        divisor = number2->limbs[0];
+        if (number2->length == 2) {
+            divisor += (uint64_t)number2->limbs[1] * BIG_FLOAT_BASE;
+        }
+        sign = number2->sign;
+        exponent = number2->exponent;
+        BigFloat_divideLong(result, number1, divisor, precision);
+        result->sign *= sign;
+        result->exponent -= result->sign != 0 ? exponent : 0;
+        return true;
+    }
+
+    BigFloat_initialize(&reciprocal);
+    BigFloat_reciprocal(&reciprocal, number2, precision + 1);
+    BigFloat_multiply(result, number1, &reciprocal, precision);
+    BigFloat_finalize(&reciprocal);
+    return true;
+}
+
+/**
+ * Divide a number by a small integer with long division.
+ * @note The precision must not be BIG_FLOAT_EXACT unless the division
+ *       terminates.
+ */
+void BigFloat_divideSmall(BigFloat *result, BigFloat *number,
+        uint32_t divisor, size_t precision) {
+    if (number->sign == 0) {
+        BigFloat_setZero(result);
+        return;
+    }
+    BigFloat_divideLong(result, number, divisor, precision);
+}
+
+static void BigFloat_powerInteger(BigFloat *result, BigFloat *base,
+        unsigned long exponent, size_t precision) {
+
+    BigFloat power, product;
+
+    BigFloat_initialize(&power);
+    BigFloat_initialize(&product);
+    BigFloat_set(&power, base);
+    BigFloat_setInteger(&product, 1);
+    while (exponent != 0) {
+        if (exponent & 1) {
+            BigFloat_multiply(&product, &product, &power, precision);
+        }
+        exponent >>= 1;
+        if (exponent != 0) {
+            BigFloat_multiply(&power, &power, &power, precision);
+        }
+    }
+
+    BigFloat_swap(result, &product);
+    BigFloat_finalize(&product);
+    BigFloat_finalize(&power);
+}
+
+
+/*
+ * Constants
+ */
+
+/* e = sum(1 / k!) */
+static void BigFloat_computeE(BigFloat *result, size_t precision) {
+
+    uint32_t k;
+    BigFloat term;
+
+    BigFloat_initialize(&term);
+    BigFloat_setInteger(&term, 1);
+    BigFloat_setInteger(result, 1);
+    for (k = 1; !BigFloat_isNegligible(&term, result, precision); ++k) {
+        BigFloat_divideSmall(&term, &term, k, precision);
+        BigFloat_add(result, result, &term, precision);
+    }
+    BigFloat_finalize(&term);
+}
+
+/* arctan(1 / x) = sum((-1)^k / ((2k + 1) x^(2k + 1))) */
+static void BigFloat_computeArctangentOfInverse(BigFloat *result,
+        uint32_t x, size_t precision) {
+
+    uint32_t k;
+    BigFloat power, term;
+
+    BigFloat_initialize(&power);
+    BigFloat_initialize(&term);
+    BigFloat_setInteger(&power, 1);
+    BigFloat_divideSmall(&power, &power, x, precision);
+    BigFloat_set(result, &power);
+    for (k = 1; ; ++k) {
+        BigFloat_divideSmall(&power, &power, x * x, precision);
+        BigFloat_divideSmall(&term, &power, 2 * k + 1, precision);
+        if (BigFloat_isNegligible(&term, result, precision)) {
+            break;
+        }
+        if (k % 2 == 1) {
+            BigFloat_subtract(result, result, &term, precision);
+        } else {
+            BigFloat_add(result, result, &term, precision);
+        }
+    }
+    BigFloat_finalize(&term);
+    BigFloat_finalize(&power);
+}
+
+/* Machin's formula, pi = 16 arctan(1 / 5) - 4 arctan(1 / 239). */
+static void BigFloat_computePi(BigFloat *result, size_t precision) {
+
+    BigFloat arctangent;
+
+    BigFloat_initialize(&arctangent);
+    BigFloat_computeArctangentOfInverse(result, 5, precision);
+    BigFloat_multiplySmall(result, result, 4, precision);
+    BigFloat_computeArctangentOfInverse(&arctangent, 239, precision);
+    BigFloat_subtract(result, result, &arctangent, precision);
+    BigFloat_multiplySmall(result, result, 4, precision);
+    BigFloat_finalize(&arctangent);
+}
+
+/**
+ * Get a constant from its cache, computing it first if it is not
+ * cached at the precision.
+ */
+static void BigFloat_getCachedConstant(BigFloat *result,
+        size_t precision, BigFloat *cache, size_t *cachePrecision,
+        void (*compute)(BigFloat *result, size_t precision)) {
+    pthread_mutex_lock(&BigFloat_cacheMutex);
+    if (*cachePrecision < precision) {
+        compute(cache, precision + 2);
+        *cachePrecision = precision;
+    }
+    BigFloat_round(result, cache, precision);
+    pthread_mutex_unlock(&BigFloat_cacheMutex);
+}
+
+/**
+ * Get e at a precision.
+ * @note The value is cached, so that later requests at the same or a
+ *       lower precision only round it.
+ */
+void BigFloat_getE(BigFloat *result, size_t precision) {
+    BigFloat_getCachedConstant(result, precision, &BigFloat_e,
+            &BigFloat_ePrecision, BigFloat_computeE);
+}
+
+/**
+ * Get pi at a precision.
+ * @note The value is cached, so that later requests at the same or a
+ *       lower precision only round it.
+ */
+void BigFloat_getPi(BigFloat *result, size_t precision) {
+    BigFloat_getCachedConstant(result, precision, &BigFloat_pi,
+            &BigFloat_piPrecision, BigFloat_computePi);
+}
+
+
+/*
+ * Functions
+ */
+
+/**
+ * Get the number of times to scale an argument down before summing a
+ * series, which balances the terms of the series against the steps
+ * to scale the sum back.
+ */
+static size_t BigFloat_getReductionCount(size_t precision) {
+    return (size_t)sqrt(precision * BIG_FLOAT_BASE_DIGITS * 3.33) / 2
+            + 1;
+}
+
+/**
+ * Get the exponential of a number.
+ * @note The argument is split into an integer, whose power of e is
+ *       taken by squaring, and a fraction, which is halved before the
+ *       Taylor series and squared back after.
+ * @return Whether the argument is in range.
+ */
+bool BigFloat_exp(BigFloat *result, BigFloat *number, size_t precision) {
+
+    double estimate = BigFloat_toDouble(number);
+    long integerPart;
+    size_t halvingCount = BigFloat_getReductionCount(precision),
+            workingPrecision = precision + 3 + halvingCount / 26,
+            termPrecision, i;
+    uint32_t k, chunk;
+    BigFloat fraction, term, sum, power;
+
+    if (number->sign == 0) {
+        BigFloat_setInteger(result, 1);
+        return true;
+    }
+    if (fabs(estimate) > EXP_ARGUMENT_MAXIMUM) {
+        return false;
+    }
+
+    BigFloat_initialize(&fraction);
+    BigFloat_initialize(&term);
+    BigFloat_initialize(&sum);
+    BigFloat_initialize(&power);
+
+    integerPart = (long)floor(estimate + 0.5);
+    BigFloat_setInteger(&power, integerPart);
+    BigFloat_subtract(&fraction, number, &power, workingPrecision);
+    for (i = halvingCount; i > 0; i -= chunk) {
+        chunk = MIN(i, 30);
+        BigFloat_divideSmall(&fraction, &fraction, 1u << chunk,
+                workingPrecision);
+    }
+
+    BigFloat_setInteger(&sum, 1);
+    BigFloat_setInteger(&term, 1);
+    for (k = 1; ; ++k) {
+        termPrecision = BigFloat_getTermPrecision(&term, &sum,
+                workingPrecision);
+        BigFloat_multiply(&term, &term, &fraction, termPrecision);
+        BigFloat_divideSmall(&term, &term, k, termPrecision);
+        if (BigFloat_isNegligible(&term, &sum, workingPrecision)) {
+            break;
+        }
+        BigFloat_add(&sum, &sum, &term, workingPrecision);
+    }
+    for (i = 0; i < halvingCount; ++i) {
+        BigFloat_multiply(&sum, &sum, &sum, workingPrecision);
+    }
+
+    if (integerPart != 0) {
+        BigFloat_getE(&power, workingPrecision);
+        BigFloat_powerInteger(&power, &power, labs(integerPart),
+                workingPrecision);
+        if (integerPart > 0) {
+            BigFloat_multiply(&sum, &sum, &power, workingPrecision);
+        } else {
+            BigFloat_divide(&sum, &sum, &power, workingPrecision);
+        }
+    }
+    BigFloat_round(result, &sum, precision);
+
+    BigFloat_finalize(&power);
+    BigFloat_finalize(&sum);
+    BigFloat_finalize(&term);
+    BigFloat_finalize(&fraction);
+    return true;
+}
+
+/**
+ * Get the natural logarithm of a number.
+ * @note Numbers far from 1 are scaled by a power of BIG_FLOAT_BASE
+ *       first; the rest use Halley's iteration
+ *       y = y + 2 (x - e^y) / (x + e^y), doubling the precision each
+ *       step.
+ * @return Whether the number is positive.
+ */
+bool BigFloat_log(BigFloat *result, BigFloat *number, size_t precision) {
+
+    long top = BigFloat_getTop(number);
+    size_t workingPrecision = precision + 2, currentPrecision = 2;
+    bool isFinal = false;
+    BigFloat logarithm, power, numerator, denominator;
+
+    if (number->sign <= 0) {
+        return false;
+    }
+
+    BigFloat_initialize(&logarithm);
+    BigFloat_initialize(&power);
+    BigFloat_initialize(&numerator);
+    BigFloat_initialize(&denominator);
+
+    if (top > 30 || top < -30) {
+        /* log(x) = log(x / BASE^top) + top log(BASE) */
+        BigFloat_set(&numerator, number);
+        numerator.exponent -= top;
+        BigFloat_log(&logarithm, &numerator, workingPrecision);
+        BigFloat_setInteger(&power, 10);
+        BigFloat_log(&power, &power, workingPrecision);
+        BigFloat_multiplySmall(&power, &power, BIG_FLOAT_BASE_DIGITS,
+                workingPrecision);
+        BigFloat_setInteger(&denominator, top);
+        BigFloat_multiply(&power, &power, &denominator, workingPrecision);
+        BigFloat_add(result, &logarithm, &power, precision);
+    } else {
+        BigFloat_setDouble(&logarithm, log(BigFloat_toDouble(number)), 3);
+        while (true) {
+            currentPrecision = MIN(2 * currentPrecision, workingPrecision);
+            BigFloat_exp(&power, &logarithm, currentPrecision + 1);
+            BigFloat_subtract(&numerator, number, &power,
+                    currentPrecision + 1);
+            BigFloat_add(&denominator, number, &power,
+                    currentPrecision + 1);
+            BigFloat_divide(&numerator, &numerator, &denominator,
+                    currentPrecision + 1);
+            BigFloat_multiplySmall(&numerator, &numerator, 2,
+                    currentPrecision + 1);
+            BigFloat_add(&logarithm, &logarithm, &numerator,
+                    currentPrecision);
+            if (currentPrecision == workingPrecision) {
+                if (isFinal) {
+                    break;
+                }
+                isFinal = true;
+            }
+        }
+        BigFloat_round(result, &logarithm, precision);
+    }
+
+    BigFloat_finalize(&denominator);
+    BigFloat_finalize(&numerator);
+    BigFloat_finalize(&power);
+    BigFloat_finalize(&logarithm);
+    return true;
+}
+
+/**
+ * Get the number of limbs above the point of a number, which a
+ * periodic function loses to argument reduction.
+ */
+static size_t BigFloat_getIntegerLength(BigFloat *number) {
+    return (size_t)MAX(BigFloat_getTop(number), 0);
+}
+
+/**
+ * Get the sine of a number.
+ * @note The argument is reduced modulo 2 pi and divided by a power of
+ *       3 before the Taylor series, and the triple-angle formula
+ *       sin(3x) = 3 sin(x) - 4 sin(x)^3 scales the sum back.
+ */
+void BigFloat_sin(BigFloat *result, BigFloat *number, size_t precision) {
+
+    size_t tripleCount = BigFloat_getReductionCount(precision),
+            workingPrecision = precision + 3 + tripleCount / 16
+                    + BigFloat_getIntegerLength(number), termPrecision,
+            i, chunk;
+    uint32_t k, power;
+    BigFloat reduced, period, square, term, cube;
+
+    if (number->sign == 0) {
+        BigFloat_setZero(result);
+        return;
+    }
+
+    BigFloat_initialize(&reduced);
+    BigFloat_initialize(&period);
+    BigFloat_initialize(&square);
+    BigFloat_initialize(&term);
+    BigFloat_initialize(&cube);
+
+    BigFloat_getPi(&period, workingPrecision);
+    BigFloat_multiplySmall(&period, &period, 2, workingPrecision);
+    BigFloat_divide(&reduced, number, &period, workingPrecision);
+    BigFloat_roundToInteger(&reduced, &reduced);
+    BigFloat_multiply(&reduced, &reduced, &period, workingPrecision);
+    BigFloat_subtract(&reduced, number, &reduced, workingPrecision);
+
+    for (i = tripleCount; i > 0; i -= chunk) {
+        /* 3^19 is the largest power of 3 below 2^32. */
+        chunk = MIN(i, 19);
+        for (power = 1, k = 0; k < chunk; ++k) {
+            power *= 3;
+        }
+        BigFloat_divideSmall(&reduced, &reduced, power, workingPrecision);
+    }
+
+    BigFloat_multiply(&square, &reduced, &reduced, workingPrecision);
+    BigFloat_set(&term, &reduced);
+    for (k = 1; ; ++k) {
+        termPrecision = BigFloat_getTermPrecision(&term, &reduced,
+                workingPrecision);
+        BigFloat_multiply(&term, &term, &square, termPrecision);
+        BigFloat_divideSmall(&term, &term, 2 * k, termPrecision);
+        BigFloat_divideSmall(&term, &term, 2 * k + 1, termPrecision);
+        term.sign = -term.sign;
+        if (BigFloat_isNegligible(&term, &reduced, workingPrecision)) {
+            break;
+        }
+        BigFloat_add(&reduced, &reduced, &term, workingPrecision);
+    }
+
+    for (i = 0; i < tripleCount; ++i) {
+        BigFloat_multiply(&cube, &reduced, &reduced, workingPrecision);
+        BigFloat_multiply(&cube, &cube, &reduced, workingPrecision);
+        BigFloat_multiplySmall(&cube, &cube, 4, workingPrecision);
+        BigFloat_multiplySmall(&reduced, &reduced, 3, workingPrecision);
+        BigFloat_subtract(&reduced, &reduced, &cube, workingPrecision);
+    }
+    BigFloat_round(result, &reduced, precision);
+
+    BigFloat_finalize(&cube);
+    BigFloat_finalize(&term);
+    BigFloat_finalize(&square);
+    BigFloat_finalize(&period);
+    BigFloat_finalize(&reduced);
+}
+
+/* cos(x) = sin(pi / 2 - x) */
+void BigFloat_cos(BigFloat *result, BigFloat *number, size_t precision) {
+
+    size_t workingPrecision = precision + 2
+            + BigFloat_getIntegerLength(number);
+    BigFloat shifted;
+
+    BigFloat_initialize(&shifted);
+    BigFloat_getPi(&shifted, workingPrecision);
+    BigFloat_divideSmall(&shifted, &shifted, 2, workingPrecision);
+    BigFloat_subtract(&shifted, &shifted, number, workingPrecision);
+    BigFloat_sin(result, &shifted, precision);
+    BigFloat_finalize(&shifted);
+}
+
+/**
+ * Get the tangent of a number.
+ * @return Whether the cosine of the number is not zero.
+ */
+bool BigFloat_tan(BigFloat *result, BigFloat *number, size_t precision) {
+
+    bool success;
+    BigFloat sine, cosine;
+
+    BigFloat_initialize(&sine);
+    BigFloat_initialize(&cosine);
+    BigFloat_sin(&sine, number, precision + 1);
+    BigFloat_cos(&cosine, number, precision + 1);
+    success = BigFloat_divide(result, &sine, &cosine, precision);
+    BigFloat_finalize(&cosine);
+    BigFloat_finalize(&sine);
+    return success;
+}
+
+/**
+ * Get the angle of the point (x, y) from the positive x axis, in
+ * (-pi, pi].
+ * @note The angle is refined from its double estimate with Newton's
+ *       iteration t = t + (y cos(t) - x sin(t)) / (x cos(t) + y sin(t)),
+ *       doubling the precision each step. Both coordinates are scaled
+ *       by the same power of BIG_FLOAT_BASE first, which keeps the
+ *       estimate in the range of a double.
+ */
+void BigFloat_atan2(BigFloat *result, BigFloat *y, BigFloat *x,
+        size_t precision) {
+
+    long top;
+    size_t workingPrecision = precision + 2, currentPrecision = 2;
+    bool isFinal = false;
+    BigFloat scaledY, scaledX, angle, sine, cosine, numerator,
+            denominator;
+
+    if (y->sign == 0) {
+        if (x->sign < 0) {
+            BigFloat_getPi(result, precision);
+        } else {
+            BigFloat_setZero(result);
+        }
+        return;
+    }
+
+    BigFloat_initialize(&scaledY);
+    BigFloat_initialize(&scaledX);
+    BigFloat_initialize(&angle);
+    BigFloat_initialize(&sine);
+    BigFloat_initialize(&cosine);
+    BigFloat_initialize(&numerator);
+    BigFloat_initialize(&denominator);
+
+    top = x->sign == 0 ? BigFloat_getTop(y)
+            : MAX(BigFloat_getTop(x), BigFloat_getTop(y));
+    BigFloat_set(&scaledY, y);
+    scaledY.exponent -= top;
+    BigFloat_set(&scaledX, x);
+    if (scaledX.sign != 0) {
+        scaledX.exponent -= top;
+    }
+    BigFloat_setDouble(&angle, atan2(BigFloat_toDouble(&scaledY),
+            BigFloat_toDouble(&scaledX)), 3);
+
+    while (true) {
+        currentPrecision = MIN(2 * currentPrecision, workingPrecision);
+        BigFloat_sin(&sine, &angle, currentPrecision + 1);
+        BigFloat_cos(&cosine, &angle, currentPrecision + 1);
+        BigFloat_multiply(&numerator, &scaledY, &cosine,
+                currentPrecision + 1);
+        BigFloat_multiply(&denominator, &scaledX, &sine,
+                currentPrecision + 1);
+        BigFloat_subtract(&numerator, &numerator, &denominator,
+                currentPrecision + 1);
+        BigFloat_multiply(&denominator, &scaledX, &cosine,
+                currentPrecision + 1);
+        BigFloat_multiply(&sine, &scaledY, &sine, currentPrecision + 1);
+        BigFloat_add(&denominator, &denominator, &sine,
+                currentPrecision + 1);
+        BigFloat_divide(&numerator, &numerator, &denominator,
+                currentPrecision + 1);
+        BigFloat_add(&angle, &angle, &numerator, currentPrecision);
+        if (currentPrecision == workingPrecision) {
+            if (isFinal) {
+                break;
+            }
+            isFinal = true;
+        }
+    }
+    BigFloat_round(result, &angle, precision);
+
+    BigFloat_finalize(&denominator);
+    BigFloat_finalize(&numerator);
+    BigFloat_finalize(&cosine);
+    BigFloat_finalize(&sine);
+    BigFloat_finalize(&angle);
+    BigFloat_finalize(&scaledX);
+    BigFloat_finalize(&scaledY);
+}
+
+/**
+ * Raise a number to a power.
+ * @note Integer powers are taken by squaring, and other powers as
+ *       exp(exponent log(base)).
+ * @return Whether the power is a finite real number.
+ */
+bool BigFloat_pow(BigFloat *result, BigFloat *base, BigFloat *exponent,
+        size_t precision) {
+
+    long integerExponent;
+    size_t workingPrecision;
+    bool success = true;
+    BigFloat power;
+
+    if (BigFloat_getLong(exponent, &integerExponent)) {
+        if (base->sign == 0) {
+            if (integerExponent < 0) {
+                return false;
+            }
+            BigFloat_setInteger(result, integerExponent == 0);
+            return true;
+        }
+        BigFloat_initialize(&power);
+        workingPrecision = precision + 3;
+        BigFloat_powerInteger(&power, base, labs(integerExponent),
+                workingPrecision);
+        if (integerExponent < 0) {
+            BigFloat_setInteger(result, 1);
+            BigFloat_divide(result, result, &power, precision);
+        } else {
+            BigFloat_round(result, &power, precision);
+        }
+        BigFloat_finalize(&power);
+        return true;
+    }
+
+    if (base->sign == 0) {
+        if (exponent->sign < 0) {
+            return false;
+        }
+        BigFloat_setZero(result);
+        return true;
+    } else if (base->sign < 0) {
+        return false;
+    }
+
+    /* The integer part of the logarithm costs precision in exp. */
+    workingPrecision = precision + 3 + BigFloat_getIntegerLength(exponent);
+    BigFloat_initialize(&power);
+    BigFloat_log(&power, base, workingPrecision);
+    BigFloat_multiply(&power, &power, exponent, workingPrecision);
+    success = BigFloat_exp(result, &power, precision);
+    BigFloat_finalize(&power);
+    return success;
+}
+
+/**
+ * Get the square root of a number.
+ * @note The number is scaled by an even power of BIG_FLOAT_BASE into
+ *       the range of a double for the estimate, and Newton's iteration
+ *       y = (y + x / y) / 2 refines it, doubling the precision each
+ *       step.
+ * @return Whether the number is not negative.
+ */
+bool BigFloat_sqrt(BigFloat *result, BigFloat *number, size_t precision) {
+
+    long shift;
+    size_t workingPrecision = precision + 2, currentPrecision = 2;
+    bool isFinal = false;
+    BigFloat scaled, root, quotient;
+
+    if (number->sign < 0) {
+        return false;
+    } else if (number->sign == 0) {
+        BigFloat_setZero(result);
+        return true;
+    }
+
+    BigFloat_initialize(&scaled);
+    BigFloat_initialize(&root);
+    BigFloat_initialize(&quotient);
+
+    /* Round the top down to an even exponent. */
+    shift = BigFloat_getTop(number) & ~1L;
+    BigFloat_set(&scaled, number);
+    scaled.exponent -= shift;
+    BigFloat_setDouble(&root, sqrt(BigFloat_toDouble(&scaled)), 3);
+
+    while (true) {
+        currentPrecision = MIN(2 * currentPrecision, workingPrecision);
+        BigFloat_divide(&quotient, &scaled, &root, currentPrecision + 1);
+        BigFloat_add(&root, &root, &quotient, currentPrecision + 1);
+        BigFloat_divideSmall(&root, &root, 2, currentPrecision);
+        if (currentPrecision == workingPrecision) {
+            if (isFinal) {
+                break;
+            }
+            isFinal = true;
+        }
+    }
+    root.exponent += shift / 2;
+    BigFloat_round(result, &root, precision);
+
+    BigFloat_finalize(&quotient);
+    BigFloat_finalize(&root);
+    BigFloat_finalize(&scaled);
+    return true;
+}
+
+/**
+ * Get Gamma(z) for z of at least 0.5 from Kummer's series of the lower
+ * incomplete gamma function,
+ * Gamma(z) ~ N^z e^-N sum(N^k / (z (z + 1) ... (z + k))),
+ * where N is large enough for the upper incomplete part to vanish.
+ * @note All the terms are positive, so the sum loses no precision.
+ */
+static void BigFloat_gammaSeries(BigFloat *result, BigFloat *z,
+        size_t precision) {
+
+    size_t workingPrecision = precision + 2, termPrecision;
+    uint32_t count = (uint32_t)(workingPrecision * BIG_FLOAT_BASE_DIGITS
+            * 2.303 + 2 * BigFloat_toDouble(z) + 10), k;
+    BigFloat denominator, term, sum, one, scale;
+
+    BigFloat_initialize(&denominator);
+    BigFloat_initialize(&term);
+    BigFloat_initialize(&sum);
+    BigFloat_initialize(&one);
+    BigFloat_initialize(&scale);
+
+    BigFloat_setInteger(&one, 1);
+    BigFloat_set(&denominator, z);
+    BigFloat_divide(&term, &one, z, workingPrecision);
+    BigFloat_set(&sum, &term);
+    for (k = 1; ; ++k) {
+        BigFloat_add(&denominator, &denominator, &one, workingPrecision);
+        termPrecision = BigFloat_getTermPrecision(&term, &sum,
+                workingPrecision);
+        BigFloat_multiplySmall(&term, &term, count, termPrecision);
+        BigFloat_divide(&term, &term, &denominator, termPrecision);
+        if (k > count && BigFloat_isNegligible(&term, &sum,
+                workingPrecision)) {
+            break;
+        }
+        BigFloat_add(&sum, &sum, &term, workingPrecision);
+    }
+
+    /* N^z e^-N = exp(z log(N) - N) */
+    BigFloat_setInteger(&scale, count);
+    BigFloat_log(&scale, &scale, workingPrecision + 1);
+    BigFloat_multiply(&scale, &scale, z, workingPrecision + 1);
+    BigFloat_setInteger(&term, count);
+    BigFloat_subtract(&scale, &scale, &term, workingPrecision + 1);
+    BigFloat_exp(&scale, &scale, workingPrecision);
+    BigFloat_multiply(result, &sum, &scale, precision);
+
+    BigFloat_finalize(&scale);
+    BigFloat_finalize(&one);
+    BigFloat_finalize(&sum);
+    BigFloat_finalize(&term);
+    BigFloat_finalize(&denominator);
+}
+
+/**
+ * Get Gamma(z) for z that is not a non-positive integer, reflecting
+ * Gamma(z) Gamma(1 - z) = pi / sin(pi z) for z below 0.5.
+ */
+static void BigFloat_gamma(BigFloat *result, BigFloat *z,
+        size_t precision) {
+
+    size_t workingPrecision = precision + 2
+            + BigFloat_getIntegerLength(z);
+    BigFloat pi, reflected, sine;
+
+    if (BigFloat_toDouble(z) >= 0.5) {
+        BigFloat_gammaSeries(result, z, precision);
+        return;
+    }
+
+    BigFloat_initialize(&pi);
+    BigFloat_initialize(&reflected);
+    BigFloat_initialize(&sine);
+    BigFloat_getPi(&pi, workingPrecision);
+    BigFloat_setInteger(&reflected, 1);
+    BigFloat_subtract(&reflected, &reflected, z, workingPrecision);
+    BigFloat_gammaSeries(&reflected, &reflected, workingPrecision);
+    BigFloat_multiply(&sine, &pi, z, workingPrecision);
+    BigFloat_sin(&sine, &sine, workingPrecision);
+    BigFloat_multiply(&sine, &sine, &reflected, workingPrecision);
+    BigFloat_divide(result, &pi, &sine, precision);
+    BigFloat_finalize(&sine);
+    BigFloat_finalize(&reflected);
+    BigFloat_finalize(&pi);
+}
+
+/**
+ * Get the factorial of a number, which is Gamma(number + 1).
+ * @note Integers are multiplied out, up to FACTORIAL_MAXIMUM; other
+ *       numbers go through the gamma function, up to GAMMA_MAXIMUM in
+ *       magnitude.
+ * @return Whether the factorial is defined and in range.
+ */
+bool BigFloat_factorial(BigFloat *result, BigFloat *number,
+        size_t precision) {
+
+    double estimate = BigFloat_toDouble(number);
+    size_t workingPrecision = precision + 2;
+    uint32_t k;
+    BigFloat product;
+
+    if (BigFloat_isInteger(number)) {
+        if (number->sign < 0 || estimate > FACTORIAL_MAXIMUM) {
+            return false;
+        }
+        BigFloat_initialize(&product);
+        BigFloat_setInteger(&product, 1);
+        for (k = 2; k <= (uint32_t)estimate; ++k) {
+            BigFloat_multiplySmall(&product, &product, k,
+                    workingPrecision);
+        }
+        BigFloat_round(result, &product, precision);
+        BigFloat_finalize(&product);
+        return true;
+    }
+
+    if (fabs(estimate) > GAMMA_MAXIMUM) {
+        return false;
+    }
+    BigFloat_initialize(&product);
+    BigFloat_setInteger(&product, 1);
+    BigFloat_add(&product, number, &product, workingPrecision);
+    BigFloat_gamma(result, &product, precision);
+    BigFloat_finalize(&product);
+    return true;
+}
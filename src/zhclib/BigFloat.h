@@ -0,0 +1,142 @@
+/**
+ * @file BigFloat.h
+ * @author: Zhang Hai
+ */
+
+/*
+ * Copyright (C) 2014 Zhang Hai
+ *
+ * This file is part of zhclib.
+ *
+ * zhclib is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * zhclib is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with zhclib.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _BIG_FLOAT_H_
+#define _BIG_FLOAT_H_
+
+
+#include "Common.h"
+
+#include <stdint.h>
+
+
+/* Each limb holds BIG_FLOAT_BASE_DIGITS decimal digits. */
+#define BIG_FLOAT_BASE 100000000u
+
+#define BIG_FLOAT_BASE_DIGITS 8
+
+/* Precision of operations whose result must not be rounded. */
+#define BIG_FLOAT_EXACT ((size_t)-1)
+
+
+/**
+ * An arbitrary-precision decimal floating-point number, whose value is
+ * sign * sum(limbs[i] * BIG_FLOAT_BASE ^ (exponent + i)).
+ * @note Precisions are given in limbs; a normalized number has no
+ *       zero limb at either end, and zero has no limbs.
+ */
+typedef struct {
+    int sign;
+    long exponent;
+    uint32_t *limbs;
+    size_t length;
+    size_t allocatedLength;
+} BigFloat;
+
+
+size_t BigFloat_getPrecisionForDigits(size_t digits);
+
+void BigFloat_initialize(BigFloat *number);
+
+void BigFloat_finalize(BigFloat *number);
+
+BigFloat *BigFloat_new();
+
+void BigFloat_delete(BigFloat *number);
+
+void BigFloat_set(BigFloat *result, BigFloat *number);
+
+void BigFloat_round(BigFloat *result, BigFloat *number,
+        size_t precision);
+
+void BigFloat_setInteger(BigFloat *result, long value);
+
+bool BigFloat_setDouble(BigFloat *result, double value,
+        size_t precision);
+
+bool BigFloat_parse(BigFloat *result, const char *text, size_t length,
+        size_t precision);
+
+string BigFloat_toString(BigFloat *number, size_t digits);
+
+double BigFloat_toDouble(BigFloat *number);
+
+bool BigFloat_isZero(BigFloat *number);
+
+bool BigFloat_isInteger(BigFloat *number);
+
+int BigFloat_compare(BigFloat *number1, BigFloat *number2);
+
+void BigFloat_negate(BigFloat *result, BigFloat *number);
+
+void BigFloat_floor(BigFloat *result, BigFloat *number);
+
+void BigFloat_ceil(BigFloat *result, BigFloat *number);
+
+void BigFloat_add(BigFloat *result, BigFloat *number1,
+        BigFloat *number2, size_t precision);
+
+void BigFloat_subtract(BigFloat *result, BigFloat *number1,
+        BigFloat *number2, size_t precision);
+
+void BigFloat_multiply(BigFloat *result, BigFloat *number1,
+        BigFloat *number2, size_t precision);
+
+void BigFloat_multiplySmall(BigFloat *result, BigFloat *number,
+        uint32_t multiplier, size_t precision);
+
+bool BigFloat_divide(BigFloat *result, BigFloat *number1,
+        BigFloat *number2, size_t precision);
+
+void BigFloat_divideSmall(BigFloat *result, BigFloat *number,
+        uint32_t divisor, size_t precision);
+
+void BigFloat_getE(BigFloat *result, size_t precision);
+
+void BigFloat_getPi(BigFloat *result, size_t precision);
+
+bool BigFloat_exp(BigFloat *result, BigFloat *number, size_t precision);
+
+bool BigFloat_log(BigFloat *result, BigFloat *number, size_t precision);
+
+void BigFloat_sin(BigFloat *result, BigFloat *number, size_t precision);
+
+void BigFloat_cos(BigFloat *result, BigFloat *number, size_t precision);
+
+bool BigFloat_tan(BigFloat *result, BigFloat *number, size_t precision);
+
+void BigFloat_atan2(BigFloat *result, BigFloat *y, BigFloat *x,
+        size_t precision);
+
+bool BigFloat_pow(BigFloat *result, BigFloat *base, BigFloat *exponent,
+        size_t precision);
+
+bool BigFloat_sqrt(BigFloat *result, BigFloat *number, size_t precision);
+
+bool BigFloat_factorial(BigFloat *result, BigFloat *number,
+        size_t precision);
+
+
+#endif /* _BIG_FLOAT_H_ */
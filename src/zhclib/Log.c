@@ -24,6 +24,7 @@
 
 #include "Log.h"
 
+#include <pthread.h>
 #include <stdarg.h>
 #include <stdio.h>
 
@@ -32,25 +33,33 @@
 
 static string LOG_FILE = "log.txt";
 
+static FILE *Log_file = null;
+
+static pthread_once_t Log_fileOnce = PTHREAD_ONCE_INIT;
+
+
+static void Log_openLogFile() {
+    Log_file = fopen(LOG_FILE, "a");
+    fprintf(Log_file, "\n========================================\n");
+    fprintf(Log_file, "LOG BEGIN AT %s\n", Time_currentAsString());
+    fprintf(Log_file, "========================================\n");
+}
 
 static FILE *Log_getLogFile() {
-    static FILE* file = null;
-    if (file == null) {
-        file = fopen(LOG_FILE, "a");
-        fprintf(file, "\n========================================\n");
-        fprintf(file, "LOG BEGIN AT %s\n", Time_currentAsString());
-        fprintf(file, "========================================\n");
-    }
-    return file;
+    pthread_once(&Log_fileOnce, Log_openLogFile);
+    return Log_file;
 }
 
 static void Log_log(string message, string format,
         va_list arguments) {
 #ifndef NDEBUG
     FILE *file = Log_getLogFile();
+    /* Keep the lines from different threads apart. */
+    flockfile(file);
     fprintf(file, "%f: %s ", Time_secondsSinceStart(), message);
     vfprintf(file, format, arguments);
     fprintf(file, "\n");
+    funlockfile(file);
 #endif
 }
 
@@ -34,6 +34,9 @@
 #include "Log.h"
 
 
+static __thread size_t Memory_allocationCount = 0;
+
+
 static void Memory_checkAllocation(void *address) {
     if (address == null) {
         Application_fatalError("Memory allocation failed.");
@@ -48,7 +51,10 @@ static void Memory_checkAllocation(void *address) {
 void *Memory_allocate(size_t size) {
     void *address = calloc(1, size);
     Memory_checkAllocation(address);
+    ++Memory_allocationCount;
+#ifdef __LOG_MEMORY_INFO__
     Log_info("Memory: %zu bytes allocated at 0x%p", size, address);
+#endif
     return address;
 }
 
@@ -61,11 +67,26 @@ void *Memory_allocate(size_t size) {
 void *Memory_reallocate(void *address, size_t size) {
     address = realloc(address, size);
     Memory_checkAllocation(address);
+    ++Memory_allocationCount;
+#ifdef __LOG_MEMORY_INFO__
     Log_info("Memory: %zu bytes reallocated at 0x%p", size, address);
+#endif
     return address;
 }
 
 void Memory_free(void *address) {
     free(address);
+#ifdef __LOG_MEMORY_INFO__
     Log_info("Memory: Memory freed at 0x%p", address);
+#endif
+}
+
+/**
+ * Get the number of allocations and reallocations made so far by the
+ * current thread.
+ * @note Take the difference of two calls to measure the allocations
+ *       made by a piece of code.
+ */
+size_t Memory_getAllocationCount() {
+    return Memory_allocationCount;
 }
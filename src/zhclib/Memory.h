@@ -37,5 +37,7 @@ void *Memory_reallocate(void *address, size_t size);
 
 void Memory_free(void *address);
 
+size_t Memory_getAllocationCount();
+
 
 #endif /* _MEMORY_H_ */
@@ -0,0 +1,116 @@
+/**
+ * @file OutputBuffer.c
+ * @author: Zhang Hai
+ */
+
+/*
+ * Copyright (C) 2014 Zhang Hai
+ *
+ * This file is part of zhclib.
+ *
+ * zhclib is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * zhclib is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with zhclib.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "OutputBuffer.h"
+
+#include <string.h>
+#include <unistd.h>
+
+#include "NumberFormatter.h"
+
+
+/**
+ * Create an {@link OutputBuffer}.
+ * @note Lines are flushed one by one when the file is a terminal.
+ * @param capacity The size of the blocks written to the file, which is
+ *        at least NUMBER_FORMATTER_MAXIMUM_LENGTH.
+ */
+OutputBuffer *OutputBuffer_new(FILE *file, size_t capacity) {
+
+    OutputBuffer *output = Memory_allocateType(OutputBuffer);
+
+    output->file = file;
+    output->capacity = MAX(capacity, NUMBER_FORMATTER_MAXIMUM_LENGTH);
+    output->buffer = Memory_allocate(output->capacity);
+    output->lineBuffered = isatty(fileno(file));
+
+    return output;
+}
+
+/**
+ * Flush and delete an {@link OutputBuffer}, leaving its file open.
+ */
+void OutputBuffer_delete(OutputBuffer *output) {
+    OutputBuffer_flush(output);
+    Memory_free(output->buffer);
+    Memory_free(output);
+}
+
+/**
+ * Write the buffered text to the file.
+ * @return Whether the text was written.
+ */
+bool OutputBuffer_flush(OutputBuffer *output) {
+
+    bool success = fwrite(output->buffer, 1, output->length, output->file)
+            == output->length && fflush(output->file) == 0;
+
+    output->length = 0;
+    return success;
+}
+
+void OutputBuffer_write(OutputBuffer *output, const char *text,
+        size_t length) {
+
+    size_t count;
+
+    while (length != 0) {
+        if (output->length == output->capacity) {
+            OutputBuffer_flush(output);
+        }
+        count = MIN(length, output->capacity - output->length);
+        memcpy(output->buffer + output->length, text, count);
+        output->length += count;
+        text += count;
+        length -= count;
+    }
+}
+
+/**
+ * Write the shortest text of a double that parses back to it.
+ * @see NumberFormatter_formatDouble
+ */
+void OutputBuffer_writeDouble(OutputBuffer *output, double value) {
+
+    if (output->capacity - output->length
+            < NUMBER_FORMATTER_MAXIMUM_LENGTH) {
+        OutputBuffer_flush(output);
+    }
+    output->length += NumberFormatter_formatDouble(value,
+            output->buffer + output->length);
+}
+
+/**
+ * End a line, flushing it if the buffer is line buffered.
+ */
+void OutputBuffer_endLine(OutputBuffer *output) {
+
+    if (output->length == output->capacity) {
+        OutputBuffer_flush(output);
+    }
+    output->buffer[output->length++] = '\n';
+    if (output->lineBuffered) {
+        OutputBuffer_flush(output);
+    }
+}
@@ -0,0 +1,60 @@
+/**
+ * @file OutputBuffer.h
+ * @author: Zhang Hai
+ */
+
+/*
+ * Copyright (C) 2014 Zhang Hai
+ *
+ * This file is part of zhclib.
+ *
+ * zhclib is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * zhclib is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with zhclib.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _OUTPUT_BUFFER_H_
+#define _OUTPUT_BUFFER_H_
+
+
+#include "Common.h"
+
+
+/**
+ * A buffer for writing many short pieces of text to a file, which
+ * reaches the file in large blocks.
+ */
+typedef struct {
+    FILE *file;
+    string buffer;
+    size_t length;
+    size_t capacity;
+    /* Whether each line is flushed, like for a terminal. */
+    bool lineBuffered;
+} OutputBuffer;
+
+
+OutputBuffer *OutputBuffer_new(FILE *file, size_t capacity);
+
+void OutputBuffer_delete(OutputBuffer *output);
+
+bool OutputBuffer_flush(OutputBuffer *output);
+
+void OutputBuffer_write(OutputBuffer *output, const char *text,
+        size_t length);
+
+void OutputBuffer_writeDouble(OutputBuffer *output, double value);
+
+void OutputBuffer_endLine(OutputBuffer *output);
+
+
+#endif /* _OUTPUT_BUFFER_H_ */
@@ -0,0 +1,281 @@
+/**
+ * @file ThreadPool.c
+ * @author: Zhang Hai
+ */
+
+/*
+ * Copyright (C) 2014 Zhang Hai
+ *
+ * This file is part of zhclib.
+ *
+ * zhclib is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * zhclib is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with zhclib.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ThreadPool.h"
+
+#include <unistd.h>
+
+
+/* Keep workers on separate cache lines. */
+#define CACHE_LINE_SIZE 64
+
+
+/**
+ * A worker owns the range of indices it has yet to process, which
+ * other workers steal half of when they run out of work.
+ */
+typedef struct tagThreadPoolWorker {
+    pthread_mutex_t mutex;
+    size_t start;
+    size_t end;
+    ThreadPool *pool;
+    size_t index;
+    pthread_t thread;
+    char padding[CACHE_LINE_SIZE];
+} ThreadPoolWorker;
+
+
+/**
+ * Take the next chunk from the range of a worker.
+ */
+static bool ThreadPool_takeChunk(ThreadPoolWorker *worker,
+        size_t grainSize, size_t *start, size_t *end) {
+
+    bool found = false;
+
+    pthread_mutex_lock(&worker->mutex);
+    if (worker->start < worker->end) {
+        *start = worker->start;
+        *end = worker->end - worker->start > grainSize
+                ? worker->start + grainSize : worker->end;
+        worker->start = *end;
+        found = true;
+    }
+    pthread_mutex_unlock(&worker->mutex);
+
+    return found;
+}
+
+/**
+ * Steal the upper half of the range of another worker.
+ * @note Only one lock is held at a time, so stealing cannot deadlock.
+ */
+static bool ThreadPool_steal(ThreadPool *pool, ThreadPoolWorker *thief) {
+
+    size_t i, middle, start = 0, end = 0;
+    ThreadPoolWorker *victim;
+
+    for (i = 1; i < pool->activeThreadCount && start == end; ++i) {
+        victim = &pool->workers[(thief->index + i)
+                % pool->activeThreadCount];
+        pthread_mutex_lock(&victim->mutex);
+        if (victim->start < victim->end) {
+            middle = victim->start
+                    + (victim->end - victim->start) / 2;
+            if (victim->end - victim->start <= pool->grainSize) {
+                middle = victim->start;
+            }
+            start = middle;
+            end = victim->end;
+            victim->end = middle;
+        }
+        pthread_mutex_unlock(&victim->mutex);
+    }
+
+    if (start == end) {
+        return false;
+    }
+
+    pthread_mutex_lock(&thief->mutex);
+    thief->start = start;
+    thief->end = end;
+    pthread_mutex_unlock(&thief->mutex);
+    return true;
+}
+
+static void ThreadPool_work(ThreadPoolWorker *worker) {
+
+    ThreadPool *pool = worker->pool;
+    size_t start, end;
+
+    do {
+        while (ThreadPool_takeChunk(worker, pool->grainSize, &start,
+                &end)) {
+            pool->task(pool->data, start, end);
+        }
+    } while (ThreadPool_steal(pool, worker));
+}
+
+static void *ThreadPool_runWorker(void *data) {
+
+    ThreadPoolWorker *worker = data;
+    ThreadPool *pool = worker->pool;
+    size_t generation = 0;
+
+    while (true) {
+
+        pthread_mutex_lock(&pool->mutex);
+        while (!pool->stopping && (pool->generation == generation
+                || worker->index >= pool->activeThreadCount)) {
+            generation = pool->generation;
+            pthread_cond_wait(&pool->startCondition, &pool->mutex);
+        }
+        if (pool->stopping) {
+            pthread_mutex_unlock(&pool->mutex);
+            break;
+        }
+        generation = pool->generation;
+        pthread_mutex_unlock(&pool->mutex);
+
+        ThreadPool_work(worker);
+
+        pthread_mutex_lock(&pool->mutex);
+        if (--pool->runningCount == 0) {
+            pthread_cond_signal(&pool->finishCondition);
+        }
+        pthread_mutex_unlock(&pool->mutex);
+    }
+
+    return null;
+}
+
+size_t ThreadPool_getProcessorCount() {
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (size_t)count : 1;
+}
+
+/**
+ * Create a {@link ThreadPool}.
+ * @param threadCount The number of threads to run tasks on, including
+ *        the thread calling {@link ThreadPool_run}, or 0 for the
+ *        number of processors.
+ */
+ThreadPool *ThreadPool_new(size_t threadCount) {
+
+    ThreadPool *pool = Memory_allocateType(ThreadPool);
+    ThreadPoolWorker *worker;
+    size_t i;
+
+    if (threadCount == 0) {
+        threadCount = ThreadPool_getProcessorCount();
+    }
+
+    pool->threadCount = threadCount;
+    pool->workers = Memory_allocate(
+            threadCount * sizeof(ThreadPoolWorker));
+    pthread_mutex_init(&pool->runMutex, null);
+    pthread_mutex_init(&pool->mutex, null);
+    pthread_cond_init(&pool->startCondition, null);
+    pthread_cond_init(&pool->finishCondition, null);
+
+    for (i = 0; i < threadCount; ++i) {
+        worker = &pool->workers[i];
+        pthread_mutex_init(&worker->mutex, null);
+        worker->pool = pool;
+        worker->index = i;
+        if (i != 0 && pthread_create(&worker->thread, null,
+                ThreadPool_runWorker, worker) != 0) {
+            Application_fatalError("Thread creation failed.");
+        }
+    }
+
+    return pool;
+}
+
+void ThreadPool_delete(ThreadPool *pool) {
+
+    size_t i;
+
+    pthread_mutex_lock(&pool->mutex);
+    pool->stopping = true;
+    pthread_cond_broadcast(&pool->startCondition);
+    pthread_mutex_unlock(&pool->mutex);
+
+    for (i = 0; i < pool->threadCount; ++i) {
+        if (i != 0) {
+            pthread_join(pool->workers[i].thread, null);
+        }
+        pthread_mutex_destroy(&pool->workers[i].mutex);
+    }
+
+    pthread_cond_destroy(&pool->finishCondition);
+    pthread_cond_destroy(&pool->startCondition);
+    pthread_mutex_destroy(&pool->mutex);
+    pthread_mutex_destroy(&pool->runMutex);
+    Memory_free(pool->workers);
+
+    Memory_free(pool);
+}
+
+/**
+ * Run a parallel loop on a {@link ThreadPool}, returning when all the
+ * indices have been processed.
+ * @note Each worker starts with an equal share of the indices and
+ *       processes them in chunks of grainSize, stealing half of the
+ *       remaining share of another worker when it runs out.
+ * @param threadCount The number of threads to use, at most the size of
+ *        the pool, or 0 for all of them.
+ * @param count The number of indices.
+ * @param grainSize The number of indices to process in one call to the
+ *        task.
+ */
+void ThreadPool_run(ThreadPool *pool, size_t threadCount, size_t count,
+        size_t grainSize, ThreadPool_Task task, void *data) {
+
+    size_t i;
+    ThreadPoolWorker *worker;
+
+    if (count == 0) {
+        return;
+    }
+    if (threadCount == 0 || threadCount > pool->threadCount) {
+        threadCount = pool->threadCount;
+    }
+    if (grainSize == 0) {
+        grainSize = 1;
+    }
+    /* No more threads than chunks. */
+    threadCount = MIN(threadCount, (count + grainSize - 1) / grainSize);
+
+    pthread_mutex_lock(&pool->runMutex);
+
+    for (i = 0; i < threadCount; ++i) {
+        worker = &pool->workers[i];
+        pthread_mutex_lock(&worker->mutex);
+        worker->start = count / threadCount * i;
+        worker->end = i == threadCount - 1 ? count
+                : count / threadCount * (i + 1);
+        pthread_mutex_unlock(&worker->mutex);
+    }
+
+    pthread_mutex_lock(&pool->mutex);
+    pool->task = task;
+    pool->data = data;
+    pool->grainSize = grainSize;
+    pool->activeThreadCount = threadCount;
+    pool->runningCount = threadCount - 1;
+    ++pool->generation;
+    pthread_cond_broadcast(&pool->startCondition);
+    pthread_mutex_unlock(&pool->mutex);
+
+    ThreadPool_work(&pool->workers[0]);
+
+    pthread_mutex_lock(&pool->mutex);
+    while (pool->runningCount != 0) {
+        pthread_cond_wait(&pool->finishCondition, &pool->mutex);
+    }
+    pthread_mutex_unlock(&pool->mutex);
+
+    pthread_mutex_unlock(&pool->runMutex);
+}
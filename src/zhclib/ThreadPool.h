@@ -0,0 +1,71 @@
+/**
+ * @file ThreadPool.h
+ * @author: Zhang Hai
+ */
+
+/*
+ * Copyright (C) 2014 Zhang Hai
+ *
+ * This file is part of zhclib.
+ *
+ * zhclib is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * zhclib is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with zhclib.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _THREAD_POOL_H_
+#define _THREAD_POOL_H_
+
+
+#include "Common.h"
+
+#include <pthread.h>
+
+
+/**
+ * A task that processes the indices from start (inclusive) to end
+ * (exclusive) of a parallel loop.
+ */
+typedef void (*ThreadPool_Task)(void *data, size_t start, size_t end);
+
+typedef struct tagThreadPoolWorker ThreadPoolWorker;
+
+typedef struct {
+    /* Worker 0 is the thread calling ThreadPool_run. */
+    ThreadPoolWorker *workers;
+    size_t threadCount;
+    /* Serializes calls to ThreadPool_run. */
+    pthread_mutex_t runMutex;
+    pthread_mutex_t mutex;
+    pthread_cond_t startCondition;
+    pthread_cond_t finishCondition;
+    size_t generation;
+    size_t runningCount;
+    bool stopping;
+    ThreadPool_Task task;
+    void *data;
+    size_t grainSize;
+    size_t activeThreadCount;
+} ThreadPool;
+
+
+size_t ThreadPool_getProcessorCount();
+
+ThreadPool *ThreadPool_new(size_t threadCount);
+
+void ThreadPool_delete(ThreadPool *pool);
+
+void ThreadPool_run(ThreadPool *pool, size_t threadCount, size_t count,
+        size_t grainSize, ThreadPool_Task task, void *data);
+
+
+#endif /* _THREAD_POOL_H_ */
@@ -27,8 +27,14 @@
 #include "string.h"
 
 
+/* Long enough for the 26 characters of ctime_r. */
+#define TIME_STRING_LENGTH 32
+
+
 static time_t Time_startTime = 0;
 
+static __thread char Time_string[TIME_STRING_LENGTH];
+
 
 time_t Time_current() {
     return time(null);
@@ -36,12 +42,13 @@ time_t Time_current() {
 
 /**
  * Get the current time as string.
- * @note The returned string is static and not thread-safe.
+ * @note The returned string is per thread and overwritten by the next
+ *       call on the same thread.
  * @return The current time as string.
  */
 string Time_currentAsString() {
     time_t current = Time_current();
-    string currentString = ctime(&current);
+    string currentString = ctime_r(&current, Time_string);
     currentString[string_length(currentString) - 1] = '\0';
     return currentString;
 }
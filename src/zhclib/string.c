@@ -387,6 +387,24 @@ bool string_isEmpty(string theString) {
     return string_length(theString) == 0;
 }
 
+/**
+ * Hash the first length characters of a string with FNV-1a.
+ * @note The string need not be null-terminated.
+ */
+size_t string_hashWithLength(string theString, size_t length) {
+    size_t hash = (size_t)14695981039346656037ULL;
+    string end = theString + length;
+    for (; theString != end; ++theString) {
+        hash ^= (unsigned char)*theString;
+        hash *= (size_t)1099511628211ULL;
+    }
+    return hash;
+}
+
+size_t string_hash(string theString) {
+    return string_hashWithLength(theString, string_length(theString));
+}
+
 string string_toUpperCase(string theString) {
     string upper = string_clone(theString);
     size_t i, length = string_length(upper);
@@ -153,6 +153,10 @@ size_t string_length(string theString);
 
 bool string_isEmpty(string theString);
 
+size_t string_hashWithLength(string theString, size_t length);
+
+size_t string_hash(string theString);
+
 string string_toUpperCase(string theString);
 
 string string_toLowerCase(string theString);
@@ -0,0 +1,88 @@
+/**
+ * @file EvaluatorAllocationTest.c
+ * @author: Zhang Hai
+ */
+
+/*
+ * Copyright (C) 2014 Zhang Hai
+ *
+ * This file is part of calc.
+ *
+ * calc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * calc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with calc.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/*
+ * Test that evaluating an expression again makes no allocations, once
+ * the reusable stacks of the evaluator have grown large enough.
+ *
+ * Build it with every source of src and src/zhclib except
+ * Calculator.c, with src on the include path, and link it with -lm
+ * -lpthread -lreadline; it exits with 1 if any case fails.
+ */
+
+#include "zhclib/Common.h"
+
+#include <stdio.h>
+
+#include "Evaluator.h"
+
+
+static const string EXPRESSIONS[] = {
+    "1 + 2 * 3",
+    "-(2 ^ 10) + sqrt(16) * sin(1) / ln(2)",
+    "max(1, 2) + min(3, 4) + log(2, 8) + 3!",
+    "((((((((((((((((((((1 + 2))))))))))))))))))))",
+    "1 + (2 + (3 + (4 + (5 + (6 + (7 + (8 + (9 + (10 + (11 + (12 + (13"
+            " + (14 + (15 + (16 + (17 + (18 + (19 + (20 + (21 + (22 + (23"
+            " + (24 + (25 + (26 + (27 + (28 + (29 + (30 + (31 + (32 + (33"
+            " + 34))))))))))))))))))))))))))))))))",
+    "0.5 * 3 + 1 / 3"
+};
+
+
+int main() {
+
+    size_t failureCount = 0, count = sizeof(EXPRESSIONS)
+            / sizeof(EXPRESSIONS[0]), allocationCount, i;
+    CompiledExpression *program;
+    Operand value, variable = 2;
+
+    for (i = 0; i < count; ++i) {
+        evaluateExpression(EXPRESSIONS[i], &value);
+        allocationCount = Memory_getAllocationCount();
+        evaluateExpression(EXPRESSIONS[i], &value);
+        allocationCount = Memory_getAllocationCount() - allocationCount;
+        if (allocationCount != 0) {
+            printf("FAIL %s: %zu allocations when evaluated again\n",
+                    EXPRESSIONS[i], allocationCount);
+            ++failureCount;
+        }
+
+        compileExpression(EXPRESSIONS[i], &program);
+        evaluateCompiled(program, &variable, &value);
+        allocationCount = Memory_getAllocationCount();
+        evaluateCompiled(program, &variable, &value);
+        allocationCount = Memory_getAllocationCount() - allocationCount;
+        if (allocationCount != 0) {
+            printf("FAIL %s: %zu allocations when its program is"
+                    " evaluated again\n", EXPRESSIONS[i], allocationCount);
+            ++failureCount;
+        }
+        CompiledExpression_delete(program);
+    }
+
+    printf("%zu of %zu cases failed\n", failureCount, 2 * count);
+    return failureCount == 0 ? 0 : 1;
+}
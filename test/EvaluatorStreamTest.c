@@ -0,0 +1,116 @@
+/**
+ * @file EvaluatorStreamTest.c
+ * @author: Zhang Hai
+ */
+
+/*
+ * Copyright (C) 2014 Zhang Hai
+ *
+ * This file is part of calc.
+ *
+ * calc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * calc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with calc.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+/*
+ * Test that evaluating a stream again with the same context makes no
+ * allocations, even when the stream is empty.
+ *
+ * Build it with every source of src and src/zhclib except
+ * Calculator.c, with src on the include path, and link it with -lm
+ * -lpthread -lreadline; it exits with 1 if any case fails.
+ */
+
+#include "zhclib/Common.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "Evaluator.h"
+
+
+/* Times each stream is evaluated. */
+#define REPETITION_COUNT 1000
+
+
+static const string TEXTS[] = {
+    "",
+    "1 + 2 * 3",
+    "1 + (2 + (3 + 4)) * 5"
+};
+
+
+/**
+ * Evaluate a stream with some text repeatedly, and check that it gives
+ * the result of evaluating the text directly, without allocating after
+ * the first time.
+ */
+static bool isStreamConforming(EvaluatorContext *context, string text) {
+
+    FILE *stream = tmpfile();
+    size_t length = strlen(text), allocationCount = 0, i;
+    Operand expectedValue = 0, value = 0;
+    EvaluationResult expectedResult, result;
+    bool conforming = true;
+
+    if (stream == null) {
+        printf("FAIL \"%s\": cannot create a stream\n", text);
+        return false;
+    }
+    fwrite(text, 1, length, stream);
+    expectedResult = EvaluatorContext_evaluate(context, text, length,
+            &expectedValue);
+
+    for (i = 0; i < REPETITION_COUNT && conforming; ++i) {
+        rewind(stream);
+        if (i == 1) {
+            allocationCount = Memory_getAllocationCount();
+        }
+        result = EvaluatorContext_evaluateStream(context, stream, &value);
+        if (result != expectedResult || (result == EVALUATION_SUCCESS
+                && value != expectedValue)) {
+            printf("FAIL \"%s\": result %d and value %.17g, expected %d"
+                    " and %.17g\n", text, result, value, expectedResult,
+                    expectedValue);
+            conforming = false;
+        }
+    }
+    allocationCount = Memory_getAllocationCount() - allocationCount;
+    if (conforming && allocationCount != 0) {
+        printf("FAIL \"%s\": %zu allocations when evaluated again\n",
+                text, allocationCount);
+        conforming = false;
+    }
+
+    fclose(stream);
+    return conforming;
+}
+
+
+int main() {
+
+    size_t failureCount = 0, count = sizeof(TEXTS) / sizeof(TEXTS[0]), i;
+    EvaluatorContext *context = EvaluatorContext_new();
+
+    for (i = 0; i < count; ++i) {
+        if (!isStreamConforming(context, TEXTS[i])) {
+            ++failureCount;
+        }
+    }
+    EvaluatorContext_delete(context);
+
+    printf("%zu of %zu cases failed\n", failureCount, count);
+    return failureCount == 0 ? 0 : 1;
+}
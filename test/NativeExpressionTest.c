@@ -0,0 +1,274 @@
+/**
+ * @file NativeExpressionTest.c
+ * @author: Zhang Hai
+ */
+
+/*
+ * Copyright (C) 2014 Zhang Hai
+ *
+ * This file is part of calc.
+ *
+ * calc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * calc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with calc.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/*
+ * Conformance test of native code against the interpreter: every
+ * operator, including where it fails, must give the same result
+ * through evaluateCompiled and NativeExpression_evaluate. Where the
+ * interpreter is exact with integers and rationals, its results and
+ * those of the double backends are pinned instead.
+ *
+ * Build it with every source of src and src/zhclib except
+ * Calculator.c, with src on the include path, and link it with -lm
+ * -lpthread -lreadline; it exits with 1 if any case fails.
+ */
+
+#include "zhclib/Common.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "Evaluator.h"
+
+
+/*
+ * Nesting of x + (x + (...)) far too deep for a native stack frame,
+ * which must be interpreted instead.
+ */
+static const size_t DEEP_NESTING = 100000;
+
+
+typedef struct {
+    string expression;
+    Operand variable;
+} NativeExpressionCase;
+
+/* Each expression has at most the variable x. */
+static const NativeExpressionCase CASES[] = {
+    {"1 + x", 2},
+    {"x - 3", 2},
+    {"x * 3.5", 2},
+    {"x / 4", 2},
+    {"x / 0", 2},
+    {"0 / x", 0},
+    {"-x", 2},
+    {"x ^ 3", 2},
+    {"x ^ 0.5", -2},
+    {"pow(x, -1)", 0},
+    {"x!", 5},
+    {"x!", 2.5},
+    {"x!", -2.5},
+    {"x!", -3},
+    {"x!", 200},
+    {"sin(x)", 1},
+    {"cos(x)", 1},
+    {"tan(x)", 1},
+    {"log(2, x)", 8},
+    {"log(x, 8)", 1},
+    {"log(x, 8)", -2},
+    {"log(2, x)", 0},
+    {"exp(x)", 1},
+    {"exp(x)", 1000},
+    {"ln(x)", 2},
+    {"ln(x)", 0},
+    {"sqrt(x)", 2},
+    {"sqrt(x)", -4},
+    {"abs(x)", -2},
+    {"asin(x)", 0.5},
+    {"asin(x)", 2},
+    {"acos(x)", 0.5},
+    {"acos(x)", -2},
+    {"atan(x)", 1},
+    {"atan2(x, 2)", -1},
+    {"sinh(x)", 1},
+    {"cosh(x)", 1},
+    {"tanh(x)", 1},
+    {"floor(x)", -2.5},
+    {"ceil(x)", -2.5},
+    {"min(x, 1)", 2},
+    {"max(x, 1)", 2},
+    {"min(x / x, 1)", 0},
+    {"max(1, x / x)", 0},
+    /* A failure must not be hidden by the operators after it. */
+    {"log(-1, 2) ^ 0", 0},
+    {"(-1)! ^ 0", 0},
+    {"sqrt(x) ^ 0", -4},
+    {"ln(x) * 0 + 1", -1},
+    {"asin(x) ^ 0 + acos(x) ^ 0", 2},
+    {"max(sqrt(x), 2)", -4},
+    {"min(sqrt(x), 2)", -4},
+    {"floor(ln(x)) ^ 0", 0},
+    /* A NaN that is not a failure behaves like any other value. */
+    {"(0 / 0) ^ 0", 0},
+    {"(x / x) * 2", 0},
+    /* Shared subexpressions and deep stacks. */
+    {"sqrt(x) + sqrt(x) * sqrt(x)", 4},
+    {"sqrt(x) + sqrt(x) * sqrt(x)", -4},
+    {"1 + (x + (x + (x + (x + (x + (x + (x + 1)))))))", 1},
+    {"atan2(log(x, 100), ln(x)!) - sqrt(abs(x)) ^ 2", 10}
+};
+
+
+typedef struct {
+    string expression;
+    Operand variable;
+    /* The exact value of evaluateCompiled. */
+    Operand exactValue;
+    /* The value of native code, columns and gradients. */
+    Operand doubleValue;
+} ExactCase;
+
+/*
+ * Only the interpreter is exact, and only while every value is an
+ * integer or a rational, variables included.
+ */
+static const ExactCase EXACT_CASES[] = {
+    {"2 ^ 62 + 1 - 2 ^ 62", 0, 1, 0},
+    {"(2 / 3) ^ -2", 0, 2.25, 2.2500000000000004},
+    {"x * 2 ^ 62 + 1 - x * 2 ^ 62", 1, 1, 0},
+    {"x * 2 ^ 62 + 1 - x * 2 ^ 62", 1.5, 0, 0}
+};
+
+
+static bool isConforming(EvaluationResult result, Operand value,
+        Operand nativeValue) {
+    if (result != EVALUATION_SUCCESS || isnan(value)) {
+        return isnan(nativeValue);
+    }
+    return value == nativeValue;
+}
+
+static bool isExactCaseConforming(const ExactCase *exactCase) {
+
+    CompiledExpression *program;
+    NativeExpression *native;
+    Operand variable = exactCase->variable, *columns[] = {&variable},
+            value = NAN, nativeValue, columnValue = NAN,
+            gradientValue = NAN, derivative;
+    EvaluationResult result;
+    bool conforming;
+
+    compileExpression(exactCase->expression, &program);
+    evaluateCompiled(program, &variable, &value);
+    compileNative(program, &native);
+    nativeValue = NativeExpression_evaluate(native, &variable);
+    evaluateColumns(program, columns, 1, &columnValue, &result);
+    evaluateGradient(program, &variable, &gradientValue, &derivative);
+
+    conforming = value == exactCase->exactValue
+            && nativeValue == exactCase->doubleValue
+            && columnValue == exactCase->doubleValue
+            && gradientValue == exactCase->doubleValue;
+    if (!conforming) {
+        printf("FAIL %s with x = %g: interpreted %.17g, native %.17g,"
+                " columns %.17g, gradient %.17g\n", exactCase->expression,
+                variable, value, nativeValue, columnValue, gradientValue);
+    }
+
+    NativeExpression_delete(native);
+    CompiledExpression_delete(program);
+
+    return conforming;
+}
+
+static bool isDeepNestingConforming() {
+
+    char *expression = Memory_allocate(4 * DEEP_NESTING + 2), *position;
+    CompiledExpression *program;
+    NativeExpression *native;
+    Operand variable = 1, value = 0, nativeValue;
+    EvaluationResult result;
+    bool conforming;
+    size_t i;
+
+    position = expression;
+    for (i = 0; i < DEEP_NESTING; ++i) {
+        memcpy(position, "x+(", 3);
+        position += 3;
+    }
+    *position++ = 'x';
+    memset(position, ')', DEEP_NESTING);
+
+    compileExpression(expression, &program);
+    result = evaluateCompiled(program, &variable, &value);
+    compileNative(program, &native);
+    nativeValue = NativeExpression_evaluate(native, &variable);
+    conforming = result == EVALUATION_SUCCESS
+            && value == DEEP_NESTING + 1 && nativeValue == value;
+    if (!conforming) {
+        printf("FAIL nesting of %zu: interpreted %d, %.17g; native"
+                " %.17g\n", DEEP_NESTING, result, value, nativeValue);
+    }
+
+    NativeExpression_delete(native);
+    CompiledExpression_delete(program);
+    Memory_free(expression);
+
+    return conforming;
+}
+
+int main() {
+
+    const NativeExpressionCase *testCase;
+    CompiledExpression *program;
+    NativeExpression *native;
+    Operand variable, value, nativeValue;
+    EvaluationResult result;
+    size_t failureCount = 0, nativeCount = 0, caseCount, i;
+
+    for (i = 0; i < sizeof(CASES) / sizeof(CASES[0]); ++i) {
+        testCase = &CASES[i];
+        if (compileExpression(testCase->expression, &program)
+                != EVALUATION_SUCCESS) {
+            printf("FAIL %s: does not compile\n", testCase->expression);
+            ++failureCount;
+            continue;
+        }
+        variable = testCase->variable;
+        value = 0;
+        result = evaluateCompiled(program, &variable, &value);
+        compileNative(program, &native);
+        if (NativeExpression_getFunction(native) != null) {
+            ++nativeCount;
+        }
+        nativeValue = NativeExpression_evaluate(native, &variable);
+        if (!isConforming(result, value, nativeValue)) {
+            printf("FAIL %s with x = %g: interpreted %d, %.17g;"
+                    " native %.17g\n", testCase->expression, variable,
+                    result, value, nativeValue);
+            ++failureCount;
+        }
+        NativeExpression_delete(native);
+        CompiledExpression_delete(program);
+    }
+    caseCount = i;
+
+    for (i = 0; i < sizeof(EXACT_CASES) / sizeof(EXACT_CASES[0]); ++i) {
+        if (!isExactCaseConforming(&EXACT_CASES[i])) {
+            ++failureCount;
+        }
+    }
+    caseCount += i;
+
+    if (!isDeepNestingConforming()) {
+        ++failureCount;
+    }
+    ++caseCount;
+
+    printf("%zu of %zu cases failed, %zu ran as native code\n",
+            failureCount, caseCount, nativeCount);
+    return failureCount == 0 ? 0 : 1;
+}